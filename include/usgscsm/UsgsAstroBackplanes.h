@@ -0,0 +1,103 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Geometric and photometric backplanes of an image region, for the
+//    frame and line scanner sensor models.
+//
+//    Each image line is handled in one pass: the rays of its pixels, from
+//    a single evaluation of the sensor position and attitude of the line
+//    for the line scanner, are intersected with the surface at a height,
+//    and the intersections give the geodetic coordinates, the ellipsoid
+//    normal, the emission, incidence and phase angles and the ground
+//    resolution of every pixel.  The lines are spread over threads.
+//
+//    The line scanner has no sun position, so the incidence and phase
+//    angles need one set with setSunPosition.  Without it they come from
+//    the illumination direction of the model where it has one, and are
+//    NaN otherwise, or at the pixels where the direction throws.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_BACKPLANES_H
+#define __USGS_ASTRO_BACKPLANES_H
+
+#include <RasterGM.h>
+
+class UsgsAstroBackplanes
+{
+public:
+
+   enum Plane
+   {
+      GROUND_X,      // intersection, ECEF meters
+      GROUND_Y,
+      GROUND_Z,
+      LATITUDE,      // geodetic, degrees
+      LONGITUDE,     // degrees in (-180, 180]
+      HEIGHT,        // meters above the ellipsoid
+      NORMAL_X,      // unit ellipsoid normal, ECEF
+      NORMAL_Y,
+      NORMAL_Z,
+      EMISSION,      // degrees between the normal and the sensor
+      INCIDENCE,     // degrees between the normal and the sun
+      PHASE,         // degrees between the sensor and the sun
+      RESOLUTION,    // meters per pixel across the line of sight
+      NUM_PLANES
+   };
+
+   // Prepares the backplanes of a model with the ellipsoid of its ground
+   // coordinates, at a height in meters above it.
+   UsgsAstroBackplanes(
+      const csm::RasterGM &model,
+      double               semiMajorAxis,
+      double               semiMinorAxis,
+      double               height);
+
+   ~UsgsAstroBackplanes() {}
+
+   // Sets the position of the sun in the body fixed frame, ECEF meters,
+   // for the incidence and phase angles.
+   void setSunPosition(const csm::EcefCoord &sunPosition);
+
+   // Computes the backplanes of numLines by numSamples pixels, pixel (r,
+   // c) at line firstLine + r * spacing and sample firstSample + c *
+   // spacing, on numThreads threads, all the available ones for zero.
+   // Plane p is written in row major pixel order to planes[p], which may
+   // be NULL for the planes not wanted.  The pixels whose ray misses the
+   // surface are NaN in every plane.  The spacing must be positive.
+   // Returns the number of pixels whose ray meets the surface.  Errors
+   // from the model other than a missing ray or illumination direction
+   // are rethrown here once every thread has finished.
+   int compute(
+      double         firstLine,
+      double         firstSample,
+      double         spacing,
+      int            numLines,
+      int            numSamples,
+      double *const  planes[NUM_PLANES],
+      int            numThreads = 0) const;
+
+private:
+
+   // Fills the pixels of lines first up to last and sets numValid to
+   // the number of them that meet the surface.
+   void computeLines(
+      int            first,
+      int            last,
+      double         firstLine,
+      double         firstSample,
+      double         spacing,
+      int            numSamples,
+      bool           illuminated,
+      double *const  planes[NUM_PLANES],
+      int           *numValid) const;
+
+   const csm::RasterGM *m_Model;
+   double               m_SemiMajorAxis;
+   double               m_SemiMinorAxis;
+   double               m_Height;
+   bool                 m_HasSunPosition;
+   csm::EcefCoord       m_SunPosition;
+};
+
+#endif
@@ -0,0 +1,186 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Lens distortion models shared by the frame and line scanner sensor
+//    models.
+//
+//    A distortion model maps undistorted focal plane coordinates to the
+//    distorted coordinates actually recorded by the detector (distort),
+//    back again (undistort), and provides the Jacobian of the forward
+//    mapping.  Models are created by name through a registry, so that a
+//    new instrument can add its own model without changing the projection
+//    code of the sensor models.  Instances are immutable once created and
+//    may be shared between models and threads.
+//
+//    All coordinates are focal plane millimeters.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_DISTORTION_H
+#define __USGS_ASTRO_DISTORTION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class UsgsAstroDistortion
+{
+public:
+
+   typedef std::shared_ptr<const UsgsAstroDistortion> (*Factory)(
+      const std::vector<double> &coefficients);
+
+   virtual ~UsgsAstroDistortion() {}
+
+   // Creates the model registered under a name from its coefficients.
+   // Throws csm::Error if no model is registered under the name.
+   static std::shared_ptr<const UsgsAstroDistortion> create(
+      const std::string         &name,
+      const std::vector<double> &coefficients);
+
+   // Registers a model factory under a name, replacing any factory
+   // already registered under it.  The built in models are registered as
+   // "NONE", "RADIAL", "TAYLOR" and "TRANSVERSE".
+   static void registerModel(const std::string &name, Factory factory);
+
+   // Returns true if a model is registered under a name.
+   static bool isRegistered(const std::string &name);
+
+   // Maps an undistorted focal plane coordinate to the distorted one.
+   virtual void distort(
+      double  ux,
+      double  uy,
+      double &dx,
+      double &dy) const = 0;
+
+   // Maps a distorted focal plane coordinate to the undistorted one.
+   virtual void undistort(
+      double  dx,
+      double  dy,
+      double &ux,
+      double &uy) const = 0;
+
+   // Jacobian of distort at an undistorted focal plane coordinate.
+   virtual void jacobian(
+      double  ux,
+      double  uy,
+      double &Jxx,
+      double &Jxy,
+      double &Jyx,
+      double &Jyy) const = 0;
+
+   // Array forms of distort and undistort.  The inputs and outputs are
+   // separate x and y arrays so that models whose mapping is a closed
+   // form can override them with loops the compiler vectorizes.
+   virtual void distort(
+      int           n,
+      const double *ux,
+      const double *uy,
+      double       *dx,
+      double       *dy) const;
+
+   virtual void undistort(
+      int           n,
+      const double *dx,
+      const double *dy,
+      double       *ux,
+      double       *uy) const;
+};
+
+
+// Identity mapping.
+class UsgsAstroNoDistortion : public UsgsAstroDistortion
+{
+public:
+
+   using UsgsAstroDistortion::distort;
+   using UsgsAstroDistortion::undistort;
+
+   virtual void distort(double ux, double uy, double &dx, double &dy) const;
+   virtual void undistort(double dx, double dy, double &ux, double &uy) const;
+   virtual void jacobian(double ux, double uy, double &Jxx, double &Jxy,
+                         double &Jyx, double &Jyy) const;
+};
+
+
+// Radial distortion removed by u = d * (1 - (k0 + k1 r^2 + k2 r^4)), where
+// r is the distorted radius.  Radii under 1.0e-3 mm are not corrected.
+// Coefficients are k0, k1, k2.
+class UsgsAstroRadialDistortion : public UsgsAstroDistortion
+{
+public:
+
+   UsgsAstroRadialDistortion(const std::vector<double> &coefficients);
+
+   using UsgsAstroDistortion::distort;
+   using UsgsAstroDistortion::undistort;
+
+   virtual void distort(double ux, double uy, double &dx, double &dy) const;
+   virtual void undistort(double dx, double dy, double &ux, double &uy) const;
+   virtual void jacobian(double ux, double uy, double &Jxx, double &Jxy,
+                         double &Jyx, double &Jyy) const;
+   virtual void undistort(int n, const double *dx, const double *dy,
+                          double *ux, double *uy) const;
+
+private:
+
+   double m_k0;
+   double m_k1;
+   double m_k2;
+};
+
+
+// Third order Taylor polynomial distortion in both focal plane
+// directions, d = sum(c[i] * f[i](u)) with the terms
+// 1, x, y, x^2, xy, y^2, x^3, x^2y, xy^2, y^3.
+// Coefficients are the ten x terms followed by the ten y terms.
+class UsgsAstroTaylorDistortion : public UsgsAstroDistortion
+{
+public:
+
+   UsgsAstroTaylorDistortion(const std::vector<double> &coefficients);
+
+   using UsgsAstroDistortion::distort;
+   using UsgsAstroDistortion::undistort;
+
+   virtual void distort(double ux, double uy, double &dx, double &dy) const;
+   virtual void undistort(double dx, double dy, double &ux, double &uy) const;
+   virtual void jacobian(double ux, double uy, double &Jxx, double &Jxy,
+                         double &Jyx, double &Jyy) const;
+   virtual void distort(int n, const double *ux, const double *uy,
+                        double *dx, double *dy) const;
+
+private:
+
+   double m_odtX[10];
+   double m_odtY[10];
+};
+
+
+// Distortion across the detector only, removed by u = d / (1 + k d^2) in
+// the focal plane y direction, as for the LRO NAC (IK codes -85600 and
+// -85610).  The single coefficient is k.
+class UsgsAstroTransverseDistortion : public UsgsAstroDistortion
+{
+public:
+
+   UsgsAstroTransverseDistortion(const std::vector<double> &coefficients);
+
+   using UsgsAstroDistortion::distort;
+   using UsgsAstroDistortion::undistort;
+
+   virtual void distort(double ux, double uy, double &dx, double &dy) const;
+   virtual void undistort(double dx, double dy, double &ux, double &uy) const;
+   virtual void jacobian(double ux, double uy, double &Jxx, double &Jxy,
+                         double &Jyx, double &Jyy) const;
+   virtual void distort(int n, const double *ux, const double *uy,
+                        double *dx, double *dy) const;
+   virtual void undistort(int n, const double *dx, const double *dy,
+                          double *ux, double *uy) const;
+
+private:
+
+   double m_k;
+};
+
+#endif
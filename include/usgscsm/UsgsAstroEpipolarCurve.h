@@ -0,0 +1,97 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Epipolar curve of an image point in a second image, for the frame and
+//    line scanner sensor models.
+//
+//    The ray of the point in its own image is intersected with the surface
+//    at heights over a range, and the ground points are projected into the
+//    second image.  The curve is the polyline through the projections,
+//    starting from a few heights and bisecting only the height intervals
+//    whose projection at the middle height is farther than a tolerance, in
+//    pixels, from the linear interpolation between the projections at
+//    their ends.  The heights are visited in order along the curve, so
+//    that a line scanner can start the search for each projection from the
+//    viewing time found for the one before.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_EPIPOLAR_CURVE_H
+#define __USGS_ASTRO_EPIPOLAR_CURVE_H
+
+#include <csm.h>
+
+#include <functional>
+#include <vector>
+
+class UsgsAstroEpipolarCurve
+{
+public:
+
+   struct Vertex
+   {
+      double          height;   // meters above the ellipsoid
+      csm::ImageCoord imagePt;  // in the second image
+      bool            valid;    // false where the ray misses the surface
+                                // or the second image does not view it
+   };
+
+   // Projects a ground point into the second image, returning false if it
+   // is not viewed.
+   typedef std::function<bool(const csm::EcefCoord &, csm::ImageCoord &)>
+      Projector;
+
+   // Builds the curve of a ray, with the ellipsoid of the second image,
+   // between two heights in meters above it.  The tolerance is the largest
+   // distance in pixels by which the curve may depart from the polyline.
+   UsgsAstroEpipolarCurve(
+      const csm::EcefLocus &ray,
+      double                semiMajorAxis,
+      double                semiMinorAxis,
+      double                minHeight,
+      double                maxHeight,
+      double                tolerance,
+      const Projector      &project);
+
+   ~UsgsAstroEpipolarCurve() {}
+
+   // Returns the vertices in increasing height.
+   const std::vector<Vertex> &getVertices() const { return m_Vertices; }
+
+   // Interpolates the image point at a height linearly between the
+   // vertices about it.  Returns false outside the height range and where
+   // either vertex is not valid.
+   bool interpolate(double height, csm::ImageCoord &imagePt) const;
+
+   // Returns the largest distance, in pixels, between the projection at
+   // the middle height of an interval and the interpolation there, over
+   // the intervals of the polyline.  For a curve of slowly changing
+   // curvature it bounds the departure of the curve from the polyline.
+   // It exceeds the tolerance where the bisection reached its depth limit
+   // first.  An interval whose middle height is not valid is split there
+   // instead, leaving intervals that are not interpolated.
+   double getErrorBound() const { return m_ErrorBound; }
+
+   // Returns the number of projections made.
+   int getNumProjections() const { return m_NumProjections; }
+
+private:
+
+   // Returns the vertex at a height.
+   Vertex evaluate(double height);
+
+   // Appends the vertices strictly between two vertices, bisecting until
+   // the curve is within tolerance of the polyline.
+   void refine(const Vertex &start, const Vertex &end, int depth);
+
+   const csm::EcefLocus *m_Ray;       // only while building
+   const Projector      *m_Project;   // only while building
+   double                m_SemiMajorAxis;
+   double                m_SemiMinorAxis;
+   double                m_Tolerance;
+   double                m_ErrorBound;
+   int                   m_NumProjections;
+   std::vector<Vertex>   m_Vertices;
+};
+
+#endif
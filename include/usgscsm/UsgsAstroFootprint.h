@@ -0,0 +1,111 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Ground footprint polygon of an image, for the frame and line scanner
+//    sensor models.
+//
+//    The border of the valid image range is walked with the ray
+//    intersections of the model, starting from a few points per edge and
+//    bisecting only the border
+//    segments whose ground midpoint is farther than a tolerance, across
+//    the local vertical, from the chord between the ground points of their
+//    ends.  Straight stretches of the footprint then cost a handful of
+//    rays, and rays are spent where the border bends, from distortion or
+//    attitude changes.
+//
+//    For a height range the border is intersected at both heights, and at
+//    each border point the ground point farther from the center of the
+//    footprint is kept, so that the polygon encloses the footprint at
+//    every height in the range.
+//
+//    Border points whose rays miss the surface, beyond the limb, are left
+//    out.  A border segment with one end on the surface and the other off
+//    it is bisected to the limb, so that the polygon joins the points at
+//    which the border crosses the limb.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_FOOTPRINT_H
+#define __USGS_ASTRO_FOOTPRINT_H
+
+#include <csm.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+class UsgsAstroFootprint
+{
+public:
+
+   // Intersects the ray of an image point with the surface at a height in
+   // meters above the ellipsoid, returning false if the ray misses it.
+   typedef std::function<bool(const csm::ImageCoord &, double,
+                              csm::EcefCoord &)>
+      Intersector;
+
+   // Walks the footprint of an image range between two heights, in
+   // meters above the ellipsoid, which may be equal.  The tolerance is the
+   // largest horizontal distance, in meters, by which the ground border
+   // may depart from the polygon between its vertices.  The semi-axes of
+   // the ellipsoid are used for the latitude and longitude of the vertices
+   // only.
+   UsgsAstroFootprint(
+      const std::pair<csm::ImageCoord, csm::ImageCoord> &imageRange,
+      double                                             semiMajorAxis,
+      double                                             semiMinorAxis,
+      double                                             minHeight,
+      double                                             maxHeight,
+      double                                             tolerance,
+      const Intersector                                 &intersect);
+
+   ~UsgsAstroFootprint() {}
+
+   // Returns the vertices in ECF meters, in the order of the image border
+   // from the first line and sample, with the first vertex repeated at the
+   // end to close the polygon.  Empty if every border ray misses the
+   // surface.
+   const std::vector<csm::EcefCoord> &getPolygon() const { return m_Polygon; }
+
+   // Returns the vertices as planetodetic latitude and east longitude
+   // pairs in degrees, longitudes in (-180, 180], closed as getPolygon.
+   std::vector<double> getLatLonPolygon() const;
+
+   // Returns the number of ray intersections made.
+   int getNumRays() const { return m_NumRays; }
+
+private:
+
+   // A point of the image border and its ground point.
+   struct BorderPoint
+   {
+      csm::ImageCoord imagePt;
+      csm::EcefCoord  ground;
+      bool            hit;      // false where the ray misses the surface
+   };
+
+   // Returns the border point of an image point, with the outer ground
+   // point of the two heights for a height range.  The ray hits the
+   // surface if it hits it at either height.
+   BorderPoint borderPoint(const csm::ImageCoord &imagePt);
+
+   // Appends the vertices strictly between two border points, bisecting
+   // until the ground border is within tolerance of the chords and, where
+   // the border crosses the limb, down to the depth limit.
+   void refine(
+      const BorderPoint &start,
+      const BorderPoint &end,
+      int                depth);
+
+   const Intersector          *m_Intersect;   // only while walking
+   double                      m_SemiMajorAxis;
+   double                      m_SemiMinorAxis;
+   double                      m_MinHeight;
+   double                      m_MaxHeight;
+   double                      m_Tolerance;
+   csm::EcefCoord              m_Center;
+   int                         m_NumRays;
+   std::vector<csm::EcefCoord> m_Polygon;
+};
+
+#endif
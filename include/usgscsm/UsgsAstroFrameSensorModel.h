@@ -4,10 +4,15 @@
 
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "RasterGM.h"
 #include "CorrelationModel.h"
+#include "UsgsAstroDistortion.h"
+#include "UsgsAstroFootprint.h"
+#include "UsgsAstroRpcModel.h"
+#include "UsgsAstroEpipolarCurve.h"
 
 class UsgsAstroFrameSensorModel : public csm::RasterGM {
   // UsgsAstroFramePlugin needs to access private members
@@ -33,6 +38,97 @@ class UsgsAstroFrameSensorModel : public csm::RasterGM {
        double*                    achieved_precision=NULL,
        csm::WarningList*          warnings=NULL) const;
 
+    /**
+     * Projects many ground points at once, as groundToImage without
+     * adjustments. The coordinates are separate arrays so that the
+     * collinearity equations are evaluated several points at a time, with
+     * AVX-512 or AVX2 chosen at run time where the processor has them, and
+     * the lens distortion is applied through the array form of the
+     * distortion model. The results agree with groundToImage to rounding.
+     *
+     * @param n Number of points.
+     * @param x Body-fixed x coordinates of the points.
+     * @param y Body-fixed y coordinates of the points.
+     * @param z Body-fixed z coordinates of the points.
+     * @param line Receives the image lines.
+     * @param sample Receives the image samples.
+     */
+    void groundToImage(int n, const double *x, const double *y,
+                       const double *z, double *line, double *sample) const;
+
+    /** Instruction sets the batch groundToImage can evaluate with. */
+    enum BatchKernel {
+      BATCH_KERNEL_AUTO,   // the widest the processor supports
+      BATCH_KERNEL_SCALAR,
+      BATCH_KERNEL_AVX2,
+      BATCH_KERNEL_AVX512
+    };
+
+    /**
+     * Selects the instruction set of the batch groundToImage, which is
+     * BATCH_KERNEL_AUTO by default. Meant for regression comparisons.
+     *
+     * @param kernel The instruction set.
+     *
+     * @return false, leaving the selection unchanged, if the compiler or the
+     *         processor does not support the instruction set.
+     */
+    bool setBatchKernel(BatchKernel kernel);
+
+    /**
+     * Returns false if a ground point is certainly not viewed by the image,
+     * that is if it is behind the camera or projects outside the valid
+     * image range. The projection is closed form, so the test is exact.
+     *
+     * @param groundPt The ground point in body-fixed meters.
+     */
+    bool isPossiblyVisible(const csm::EcefCoord &groundPt) const;
+
+    /**
+     * Returns the ground footprint polygon of the image between two heights,
+     * walking the image border adaptively so that the polygon departs from
+     * the ground border by at most a tolerance.
+     *
+     * @param minHeight Lowest height above the ellipsoid in meters.
+     * @param maxHeight Highest height above the ellipsoid in meters.
+     * @param tolerance Largest departure from the ground border in meters.
+     */
+    UsgsAstroFootprint computeFootprint(double minHeight, double maxHeight,
+                                        double tolerance) const;
+
+    /**
+     * Fits a rational polynomial approximation to the model over its valid
+     * image and height ranges.
+     *
+     * @param gridSize Image points sampled along each image axis.
+     * @param numHeights Heights sampled over the valid height range.
+     */
+    UsgsAstroRpcModel computeRpcModel(int gridSize = 15, int numHeights = 5) const;
+
+    /**
+     * Returns the ray of an image point, the sensor position and the unit look
+     * direction in body-fixed coordinates, as intersected by imageToGround.
+     *
+     * @param imagePt The image coordinate.
+     */
+    csm::EcefLocus imageToRay(const csm::ImageCoord &imagePt) const;
+
+    /**
+     * Returns the epipolar curve in this image of an image point of another
+     * model, the projections of the points of its ray between two heights,
+     * as a polyline within a tolerance of the curve.
+     *
+     * @param otherModel The model of the other image.
+     * @param otherPt The image coordinate in the other image.
+     * @param minHeight Lowest height above the ellipsoid in meters.
+     * @param maxHeight Highest height above the ellipsoid in meters.
+     * @param tolerance Largest departure from the curve in pixels.
+     */
+    UsgsAstroEpipolarCurve computeEpipolarCurve(const csm::RasterGM &otherModel,
+                                                const csm::ImageCoord &otherPt,
+                                                double minHeight, double maxHeight,
+                                                double tolerance) const;
+
     /**
     * This function determines if a sample, line intersects the target body and if so, where
     * this intersection occurs in body-fixed coordinates.
@@ -283,6 +379,35 @@ class UsgsAstroFrameSensorModel : public csm::RasterGM {
     virtual csm::SharingCriteria getParameterSharingCriteria(int index) const;
     virtual double getParameterValue(int index) const;
     virtual void setParameterValue(int index, double value);
+
+    /**
+     * Adds a delta to each of the adjustable parameters and refreshes only the
+     * cached quantities that depend on the parameters that changed. Use this
+     * between bundle adjustment iterations instead of replacing the model
+     * state.
+     *
+     * @param deltas One delta per adjustable parameter.
+     * @throw csm::Error::INDEX_OUT_OF_RANGE if the number of deltas differs
+     *        from the number of parameters.
+     */
+    void applyParameterDeltas(const std::vector<double> &deltas);
+
+    /**
+     * Returns the largest difference, in pixels, between the undistorted
+     * focal plane coordinates interpolated from the ray grid and those
+     * computed directly, measured at the center of every grid cell when
+     * the grid is built. Builds the grid if it has not been built yet. Zero
+     * when the distortion is too strong for the grid and is removed
+     * directly.
+     */
+    double getRayGridError() const;
+
+    /**
+     * Enables or disables the ray grid, which is enabled by default. While
+     * disabled, the lens distortion is removed from every focal plane
+     * coordinate directly. Meant for regression comparisons.
+     */
+    void setRayGrid(bool enable);
     virtual csm::param::Type getParameterType(int index) const;
     virtual void setParameterType(int index, csm::param::Type pType);
     virtual double getParameterCovariance(int index1, int index2) const;
@@ -318,6 +443,31 @@ class UsgsAstroFrameSensorModel : public csm::RasterGM {
     std::vector<double> m_noAdjustments;
     std::vector<double> m_odtX;
     std::vector<double> m_odtY;
+    std::shared_ptr<const UsgsAstroDistortion> m_distortion;
+
+    // Quantities derived from the state, refreshed by updateCachedState
+    double m_focalLength;
+    double m_rotationMatrix[3][3];
+
+    // Undistorted focal plane coordinates on a regular grid over the
+    // distorted focal plane coordinates of the image, interpolated
+    // bicubically in place of the iterative undistortion.
+    struct RayGrid {
+      double x0, y0;              // focal plane coordinates of node (0, 0)
+      double dx, dy;              // node spacing in millimeters
+      int nx, ny;                 // number of nodes
+      double error;               // interpolation error bound in pixels
+      std::vector<double> ux, uy; // undistorted coordinates, x fastest
+    };
+
+    // Built on first use and dropped by updateCachedState. Read and
+    // replaced with the atomic shared_ptr functions so that concurrent
+    // const calls can build it.
+    mutable std::shared_ptr<const RayGrid> m_rayGrid;
+    bool m_useRayGrid;
+    BatchKernel m_batchKernel;
+    static const int MAX_RAY_GRID_NODES;
+    static const double MAX_RAY_GRID_ERROR;  // pixels
 
     static const int         _NUM_STATE_KEYWORDS;
     static const std::string _STATE_KEYWORD[];
@@ -379,10 +529,22 @@ class UsgsAstroFrameSensorModel : public csm::RasterGM {
     csm::NoCorrelationModel _no_corr_model;
 
     double getValue(int index,const std::vector<double> &adjustments) const;
+    void updateDistortion();
+    void updateCachedState();
+    void updateRotationMatrix();
+    std::shared_ptr<const RayGrid> getRayGrid() const;
+    std::shared_ptr<const RayGrid> buildRayGrid() const;
+    void undistortFocalPlane(double dx, double dy,
+                             double &undistortedX, double &undistortedY) const;
+    static bool interpolateRayGrid(const RayGrid &grid, double dx, double dy,
+                                   double &undistortedX, double &undistortedY);
     void calcRotationMatrix(double m[3][3]) const;
     void calcRotationMatrix(double m[3][3], const std::vector<double> &adjustments) const;
+    void imageToLook(const csm::ImageCoord &imagePt, double &xl, double &yl, double &zl) const;
 
-    void losEllipsoidIntersect (double height,double xc,
+    // Returns false if the ray misses the ellipsoid, with the point of
+    // the ray nearest to it.
+    bool losEllipsoidIntersect (double height,double xc,
                                 double yc, double zc,
                                 double xl, double yl,
                                 double zl,
@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Geodetic height and height constrained ray intersection for a
+//    biaxial ellipsoid.
+//
+//    The height comes from the closed form solution of Vermeille (2002),
+//    "Direct transformation from geocentric coordinates to geodetic
+//    coordinates", Journal of Geodesy 76, with no iteration and exact to
+//    rounding for points outside the evolute of the ellipsoid, which is
+//    within a few tens of kilometers of the body center for the planets
+//    and moons handled here.  The ray intersection starts from the
+//    ellipsoid scaled by the height and corrects along the ray with Newton
+//    steps on the geodetic height, which converge in one or two steps.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_GEODESY_H
+#define __USGS_ASTRO_GEODESY_H
+
+#include <cstddef>
+
+class UsgsAstroGeodesy
+{
+public:
+
+   UsgsAstroGeodesy();
+
+   UsgsAstroGeodesy(double semiMajorAxis, double semiMinorAxis);
+
+   ~UsgsAstroGeodesy() {}
+
+   // Computes the geodetic latitude (radians) and height above the
+   // ellipsoid of an ECF coordinate.  Returns false, leaving the outputs
+   // unset, for points too close to the body center for the closed form
+   // and for prolate ellipsoids.
+   bool toGeodetic(
+      double  x,
+      double  y,
+      double  z,
+      double &latitude,
+      double &height) const;
+
+   // Computes the ECF coordinate of a geodetic latitude and longitude
+   // (radians) and height above the ellipsoid.
+   void fromGeodetic(
+      double  latitude,
+      double  longitude,
+      double  height,
+      double &x,
+      double &y,
+      double &z) const;
+
+   // Intersects a ray, given by a camera position and a look direction,
+   // with the surface at a geodetic height above the ellipsoid.  The
+   // nearer of the two intersections is returned.  A ray that misses the
+   // surface gives the point of the ray nearest to it; missed, when
+   // given, is set to whether it did.  Returns the number of correction
+   // steps taken, or -1 if the closed form height was not available.
+   int intersect(
+      double  height,
+      double  xc,
+      double  yc,
+      double  zc,
+      double  xl,
+      double  yl,
+      double  zl,
+      double &x,
+      double &y,
+      double &z,
+      double &achievedPrecision,
+      double  desiredPrecision,
+      bool   *missed = NULL) const;
+
+private:
+
+   double m_SemiMajorAxis;
+   double m_SemiMinorAxis;
+   double m_InvA2;   // 1 / a^2
+   double m_E2;      // first eccentricity squared
+   double m_E4;      // e^4
+};
+
+#endif
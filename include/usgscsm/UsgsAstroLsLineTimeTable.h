@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Line to time and time to line conversion for line scanner images
+//    with variable line rates.
+//
+//    The integration time table splits the image into segments, each with
+//    a starting line, a starting time and a constant integration time.
+//    Finding the segment of a line or of a time is a search over the
+//    starting lines or times.  This table replaces that search with a
+//    direct index into uniform buckets built once per model: each bucket
+//    records the segment in effect at its start, so a lookup is one
+//    division and a binary search over the few segments starting within
+//    the bucket.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_LINE_SCANNER_LINE_TIME_TABLE_H
+#define __USGS_ASTRO_LINE_SCANNER_LINE_TIME_TABLE_H
+
+#include <vector>
+
+class UsgsAstroLsLineTimeTable
+{
+public:
+
+   UsgsAstroLsLineTimeTable();
+
+   // Builds the table from the integration time segments. Lines are ISIS
+   // (USGS) image lines, and both lines and start times must be sorted.
+   UsgsAstroLsLineTimeTable(
+      const std::vector<double> &lines,
+      const std::vector<double> &startTimes,
+      const std::vector<double> &intTimes);
+
+   ~UsgsAstroLsLineTimeTable() {}
+
+   // Returns the index of the segment containing a line, that is the last
+   // segment starting at or before it, or the first segment for lines
+   // before the table.
+   int getLineSegment(double line) const;
+
+   // Returns the index of the segment containing a time, as for lines.
+   int getTimeSegment(double time) const;
+
+   // Returns the time at which a line was imaged.
+   double lineToTime(double line) const;
+
+   // Returns the line imaged at a time.
+   double timeToLine(double time) const;
+
+   int getNumSegments() const { return (int)m_Lines.size(); }
+
+private:
+
+   // Uniform buckets over the values of a sorted array.
+   struct BucketIndex
+   {
+      double           origin;  // value at the start of the first bucket
+      double           scale;   // buckets per unit value
+      std::vector<int> first;   // segment in effect at each bucket start
+   };
+
+   static void buildIndex(
+      const std::vector<double> &values,
+      BucketIndex               &index);
+
+   static int lookup(
+      const std::vector<double> &values,
+      const BucketIndex         &index,
+      double                     x);
+
+   std::vector<double> m_Lines;
+   std::vector<double> m_StartTimes;
+   std::vector<double> m_IntTimes;
+   BucketIndex         m_LineIndex;
+   BucketIndex         m_TimeIndex;
+};
+
+#endif
@@ -28,6 +28,13 @@
 #define __USGS_ASTRO_LINE_SCANNER_SENSORMODEL_H
 
 #include "UsgsAstroLsStateData.h"
+#include "UsgsAstroLsTrajectory.h"
+#include "UsgsAstroLsLineTimeTable.h"
+#include "UsgsAstroGeodesy.h"
+#include "UsgsAstroFootprint.h"
+#include "UsgsAstroRpcModel.h"
+#include "UsgsAstroEpipolarCurve.h"
+#include "UsgsAstroDistortion.h"
 #include <RasterGM.h>
 #include <SettableEllipsoid.h>
 #include <CorrelationModel.h>
@@ -579,6 +586,15 @@ public:
    //  the given index.
    //<
 
+   void applyParameterDeltas(const std::vector<double> &deltas);
+   //> This method adds a delta to each adjustable parameter and refreshes
+   //  only the cached quantities that depend on the parameters, currently
+   //  the linear approximation used to start groundToImage.  Unlike
+   //  replaceModelState, it does not reparse the state or recompute the
+   //  reference point, ground sample distance and flying height.  Throws
+   //  INDEX_OUT_OF_RANGE unless there is one delta per parameter.
+   //<
+
    virtual csm::param::Type getParameterType(int index) const;
    //> This method returns the type of the adjustable parameter
    //  referenced by the given index.
@@ -747,6 +763,12 @@ public:
    //  correlation and sharing.
    //<
 
+   const UsgsAstroLsTrajectory& getTrajectory() const;
+   //> This method returns the ephemeris and attitude of the model, which
+   //  are shared with every other model of the same trajectory built from
+   //  identical support data.
+   //<
+
    virtual std::string getSensorType() const;
    //> This method returns a description of the sensor type (EO, IR, SAR,
    //  etc).  See csm.h for a list of common types.  Should return
@@ -808,6 +830,225 @@ public:
    //> This method sets the planetary ellipsoid.
    //<
 
+   void setIterativeGeodesy(bool iterative);
+   //> This method selects the iterative computation of height above the
+   //  ellipsoid and of ray intersections at a height, in place of the
+   //  closed form height and Newton corrected intersection used by
+   //  default.  It is meant for regression comparisons.
+   //<
+
+   void setLookVectorTable(bool enable);
+   //> This method enables or disables a table of boresight frame look
+   //  vectors with a node at every detector sample.  While enabled, the
+   //  interior orientation of a ray is interpolated from the table rather
+   //  than computed, except for partials with respect to the focal bias.
+   //  Interpolated rays differ from computed ones by a tiny fraction of a
+   //  pixel.  The table is rebuilt when the focal bias parameter changes.
+   //<
+
+   enum ProjectionStatus
+   {
+      PROJECTION_SUCCESS,        // The projection succeeded
+      PROJECTION_NOT_VIEWED,     // The ground point is not viewed by the image
+      PROJECTION_NOT_CONVERGED,  // The image point is off by over 10 meters
+      PROJECTION_MISSED          // The ray misses the surface at the height
+   };
+   //> This enumeration lists the outcomes of the non-throwing projections.
+   //<
+
+   ProjectionStatus tryGroundToImage(
+      const csm::EcefCoord& groundPt,
+      csm::ImageCoord& imagePt,
+      double desiredPrecision = 0.001,
+      double* achievedPrecision = NULL) const noexcept;
+   //> This method is the non-throwing form of groundToImage.  Instead of
+   //  throwing a csm::Error when the ground point is not viewed by the
+   //  image or the solution did not converge, it returns the status and
+   //  leaves imagePt unspecified.  Precision warnings are not issued; the
+   //  achieved precision is returned as for groundToImage.  It is meant
+   //  for projecting many points of which some may fall outside the image,
+   //  where unwinding exceptions would dominate the cost.
+   //<
+
+   csm::ImageCoord groundToImage(
+      const csm::EcefCoord& groundPt,
+      const csm::ImageCoord& hintPt,
+      double searchRadius,
+      bool* hintUsed = NULL,
+      double desiredPrecision = 0.001,
+      double* achievedPrecision = NULL,
+      csm::WarningList* warnings = NULL) const;
+   //> This method is groundToImage with a hint of where the ground point
+   //  lands, such as the image point of a neighbouring ground point.
+   //  Instead of bracketing the whole image, the search brackets the
+   //  lines from hintPt to searchRadius lines away from it, on the side
+   //  of the viewing line, and widens the window geometrically until it
+   //  encloses the viewing line.  A hint within searchRadius lines of the
+   //  viewing line usually needs two or three evaluations of the line
+   //  offset.  hintUsed, when given, is set to whether the search
+   //  started from the hint, which it does not when the hint line is
+   //  outside the image; the whole image is searched then.
+   //<
+
+   ProjectionStatus tryGroundToImage(
+      const csm::EcefCoord& groundPt,
+      const csm::ImageCoord& hintPt,
+      double searchRadius,
+      csm::ImageCoord& imagePt,
+      bool* hintUsed = NULL,
+      double desiredPrecision = 0.001,
+      double* achievedPrecision = NULL) const noexcept;
+   //> This method is the non-throwing form of groundToImage with an image
+   //  point hint, returning the status as tryGroundToImage does.
+   //<
+
+   ProjectionStatus tryGroundToImageNearTime(
+      const csm::EcefCoord& groundPt,
+      double hintTime,
+      double searchRadius,
+      csm::ImageCoord& imagePt,
+      bool* hintUsed = NULL,
+      double desiredPrecision = 0.001,
+      double* achievedPrecision = NULL) const noexcept;
+   //> This method is tryGroundToImage with a hint of the viewing time of
+   //  the ground point, such as the time found for it by a previous
+   //  iteration of an adjustment, and a searchRadius in seconds.
+   //<
+
+   ProjectionStatus tryImageToGround(
+      const csm::ImageCoord& imagePt,
+      double height,
+      csm::EcefCoord& groundPt,
+      double desiredPrecision = 0.001,
+      double* achievedPrecision = NULL) const noexcept;
+   //> This method is the non-throwing form of imageToGround.  It returns
+   //  PROJECTION_MISSED when the image ray misses the surface at the given
+   //  height, with groundPt set to the point of the ray nearest to it,
+   //  which is what imageToGround returns in that case.
+   //<
+
+   void groundToImage(
+      int n,
+      const double* x,
+      const double* y,
+      const double* z,
+      double* line,
+      double* sample,
+      ProjectionStatus* status,
+      double desiredPrecision = 0.001) const noexcept;
+   //> This method projects n ground points, given as separate x, y and z
+   //  arrays in ECEF meters, with tryGroundToImage.  The line and sample
+   //  of a point whose status is not PROJECTION_SUCCESS are unspecified.
+   //<
+
+   bool isPossiblyVisible(
+      const csm::EcefCoord& groundPt) const;
+   //> This method returns false if the given groundPt (x,y,z in ECEF
+   //  meters) is not viewed by the image, that is if groundToImage would
+   //  throw and tryGroundToImage return PROJECTION_NOT_VIEWED for it.  It
+   //  makes the test that starts their line search, whether the point
+   //  lies on the same side of the first and of the last image line, from
+   //  the exterior orientation of those lines cached with the model, so
+   //  it costs a few matrix products instead of two interpolations of the
+   //  trajectory.  Points beyond the sample edges within the image lines
+   //  are viewed, as groundToImage returns their image points.  It is
+   //  meant for callers such as tile schedulers that skip points outside
+   //  the image.
+   //<
+
+   UsgsAstroFootprint computeFootprint(
+      double minHeight,
+      double maxHeight,
+      double tolerance) const;
+   //> This method returns the ground footprint polygon of the image
+   //  between minHeight and maxHeight (in meters relative to the
+   //  ellipsoid), walking the image border adaptively so that the polygon
+   //  departs from the ground border by at most tolerance meters.  The
+   //  polygon is available in ECEF and in latitude and longitude.  Border
+   //  points whose rays miss the surface are left out, so for an image
+   //  that sees past the limb the polygon joins the points at which the
+   //  border crosses it.
+   //<
+
+   UsgsAstroRpcModel computeRpcModel(
+      int gridSize = 15,
+      int numHeights = 5) const;
+   //> This method fits a rational polynomial approximation to the model
+   //  over its valid image and height ranges, sampling gridSize by gridSize
+   //  image points at numHeights heights, and returns it with its fit and
+   //  check residuals.
+   //<
+
+   csm::EcefLocus imageToRay(
+      const csm::ImageCoord& image_pt) const;
+   //> This method returns the ray of the given image_pt, with the sensor
+   //  position (x,y,z in ECEF meters) as its point and the unit look
+   //  direction, corrected for light aberration when the state asks for
+   //  it, as its direction.  It is the ray imageToGround intersects, from
+   //  a single evaluation of the line of sight.
+   //<
+
+   void imageToRays(
+      double line,
+      double firstSample,
+      double sampleSpacing,
+      int numSamples,
+      csm::EcefLocus* rays) const;
+   //> This method returns in rays the imageToRay rays of numSamples image
+   //  points of one line, starting at firstSample and sampleSpacing
+   //  samples apart.  The sensor position, velocity and attitude of the
+   //  line are evaluated once for all of them.
+   //<
+
+   UsgsAstroEpipolarCurve computeEpipolarCurve(
+      const csm::RasterGM& otherModel,
+      const csm::ImageCoord& otherPt,
+      double minHeight,
+      double maxHeight,
+      double tolerance) const;
+   //> This method returns the epipolar curve in this image of the image
+   //  point otherPt of otherModel: the projections of the points of its
+   //  ray between minHeight and maxHeight (in meters relative to the
+   //  ellipsoid of this model), as a polyline within tolerance pixels of
+   //  the curve.  Each projection starts its search from the viewing time
+   //  of the one before, rather than from the whole image.
+   //<
+
+   int computeObservationPartials(
+      int n,
+      const csm::ImageCoord* imagePts,
+      const csm::EcefCoord* groundPts,
+      double* residuals,
+      double* sensorPartials,
+      int sensorStride,
+      double* groundPartials,
+      int groundStride,
+      ProjectionStatus* status,
+      csm::param::Set pSet = csm::param::VALID,
+      double desiredPrecision = 0.001,
+      int numThreads = 0) const;
+   //> This method computes, for n observations of the ground points
+   //  groundPts (x,y,z in ECEF meters) at the measured imagePts, the
+   //  residuals (measured minus computed line and sample, 2 per
+   //  observation) and the partial derivatives of line and sample with
+   //  respect to the parameters of pSet, in the order of
+   //  getParameterSetIndices, and to the ground point.  Row 2*i (line) and
+   //  row 2*i+1 (sample) of observation i start at sensorPartials +
+   //  (2*i)*sensorStride and at groundPartials + (2*i)*groundStride, so
+   //  that packed blocks (strides 0, meaning the number of parameters and
+   //  3) and the rows of a CSR matrix whose rows hold the parameter
+   //  columns followed by the ground columns (both strides the number of
+   //  parameters plus 3) can be written in place.  The partials are those
+   //  of computeAllSensorPartials and computeGroundPartials, with every
+   //  perturbed solve started from the time of the observation's own
+   //  solve.  The observations are split over numThreads threads, all
+   //  the available ones for zero.  Any output may be NULL; the outputs of
+   //  an observation whose status is not PROJECTION_SUCCESS are zero.
+   //  Other errors, such as running out of memory, are rethrown here once
+   //  every thread has finished.  Returns the number of observations that
+   //  succeeded.
+   //<
+
 private:
 
    void determineSensorCovarianceInImageSpace(
@@ -824,13 +1065,110 @@ private:
       int index,
       const std::vector<double> &adjustments) const;
 
+   // State carried between the solves of a sequence of nearby ground
+   // points, such as the points of an epipolar curve.
+   struct SearchHint
+   {
+      bool   valid;           // whether time holds a converged time
+      double time;            // viewing time the search brackets first
+      double lineResolution;  // ground size of an image line, 0 if unknown
+      double timePerOffset;   // rate of the viewing time with the line
+                              // offset at the last window, 0 if unknown
+      double radius;          // time from the hinted one to the far end of
+                              // the first window when the rate is not
+                              // known, 0 for the default
+      bool   used;            // set to whether the search started from
+                              // the hinted time
+
+      SearchHint()
+         : valid(false), time(0.0), lineResolution(0.0), timePerOffset(0.0),
+           radius(0.0), used(false) {}
+   };
+
    // This private form of the g2i method is used to ensure thread safety.
    virtual csm::ImageCoord groundToImage(
       const csm::EcefCoord& groundPt,
       const std::vector<double> &adjustments,
       double desiredPrecision = 0.001,
       double* achievedPrecision = NULL,
-      csm::WarningList* warnings = NULL) const;
+      csm::WarningList* warnings = NULL,
+      SearchHint* hint = NULL) const;
+
+   // The non-throwing form of the private g2i method, on which the
+   // throwing forms are built.  Given a hint, the search brackets the
+   // viewing time between the hinted one and a step past the root predicted
+   // from the offset there, widening the window geometrically until it
+   // encloses the root, and the hint is updated to the converged time.
+   // A hinted time outside the image is not used, and the search brackets
+   // the whole image as without a hint.
+   ProjectionStatus tryGroundToImage(
+      const csm::EcefCoord& groundPt,
+      const std::vector<double> &adjustments,
+      csm::ImageCoord& imagePt,
+      double desiredPrecision,
+      double* achievedPrecision,
+      SearchHint* hint = NULL) const noexcept;
+
+   // Sets a hint to the viewing time of an image point, with a radius
+   // of the time to the line searchRadius lines away.
+   void setSearchHint(
+      const csm::ImageCoord& hintPt,
+      double searchRadius,
+      SearchHint& hint) const;
+
+   // Computes the outputs of computeObservationPartials for the
+   // observations from first up to last.
+   int computeObservationPartials(
+      int first,
+      int last,
+      const csm::ImageCoord* imagePts,
+      const csm::EcefCoord* groundPts,
+      const std::vector<int>& indices,
+      double* residuals,
+      double* sensorPartials,
+      int sensorStride,
+      double* groundPartials,
+      int groundStride,
+      ProjectionStatus* status,
+      double desiredPrecision) const;
+
+   // Throws the csm::Error corresponding to a failed projection status.
+   static void throwProjectionError(
+      ProjectionStatus status,
+      const std::string& function);
+
+   // Exterior orientation shared by every sample of an image line.
+   struct LineOrientation
+   {
+      double time;            // time of the line
+      double position[3];     // adjusted sensor position
+      double velocity[3];     // adjusted sensor velocity
+      double plFromApl[9];    // attitude correction rotation
+      double ecfFromPl[9];    // rotation from the sensor quaternions
+   };
+
+   // Computes the exterior orientation of the line of an image point.
+   void computeLineOrientation(
+      const double& line,
+      const std::vector<double>& adj,
+      LineOrientation& orientation) const;
+
+   // Computes the exterior orientation of the line imaged at a time.
+   void computeTimeOrientation(
+      const double& time,
+      const std::vector<double>& adj,
+      LineOrientation& orientation) const;
+
+   // Computes the line of sight of an image point from the exterior
+   // orientation of its line.
+   void lineLosToEcf(
+      const LineOrientation& orientation,
+      const double& line,
+      const double& sample,
+      const std::vector<double>& adj,
+      double& xl,
+      double& yl,
+      double& zl) const;
 
    // This method computes the imaging locus.
    void losToEcf(
@@ -859,19 +1197,10 @@ private:
       double&       dyl,
       double&       dzl) const;
 
-   // Lagrange interpolation of variable order.
-   void lagrangeInterp (
-      const int&     numTime,
-      const double*  valueArray,
-      const double&  startTime,
-      const double&  delTime,
-      const double&  time,
-      const int&     vectorLength,
-      const int&     i_order,
-      double*        valueVector ) const;
-
    // Intersects a LOS at a specified height above the ellipsoid.
-   void losEllipsoidIntersect (
+   // Returns false if the LOS misses the surface at that height, in which
+   // case the point of the LOS nearest to it is returned.
+   bool losEllipsoidIntersect (
       const double& height,
       const double& xc,
       const double& yc,
@@ -910,6 +1239,64 @@ private:
       double&       z,
       int&          mode ) const;
 
+   // Computes the look vector in the boresight frame for a detector sample
+   void computeDetectorLook(
+      const double& sampleUSGSFull,
+      const double& fractionalLine,
+      const double& focalBias,
+      double        losApl[3]) const;
+
+   // Fills the look vector table for the current focal bias
+   void buildLookTable();
+
+   // Unadjusted exterior orientation at the times of the first and last
+   // image lines, at which the line search tests whether the image views
+   // a ground point
+   struct ImageEnds
+   {
+      LineOrientation first;
+      LineOrientation last;
+   };
+
+   // Computes the orientation of the image ends
+   std::shared_ptr<const ImageEnds> buildImageEnds() const;
+
+   // Returns the orientation of the image ends, building it on first use
+   // after a change of the model
+   std::shared_ptr<const ImageEnds> getImageEnds() const;
+
+   // Drops the orientation of the image ends after a change of the model
+   void resetImageEnds();
+
+   // Builds the grid of the sensor partials of every parameter at pixel
+   // centers spread over the image, at the lowest and highest valid
+   // heights, left empty if the partials fail at any node
+   std::shared_ptr<const std::vector<double> > buildSensorPartialsGrid() const;
+
+   // Returns the sensor partials grid, building it on first use after a
+   // change of the model
+   std::shared_ptr<const std::vector<double> > getSensorPartialsGrid() const;
+
+   // Drops the sensor partials grid after a change of the model
+   void resetSensorPartialsGrid();
+
+   // Computes the sensor covariance in image space at an image point and
+   // height from the partials interpolated in the grid.  Returns false if
+   // the grid is empty, or if the point is outside the grid, from the
+   // first to the last pixel center and from the lowest to the highest
+   // valid height.
+   bool interpolateSensorCovariance(
+      const csm::ImageCoord& imagePt,
+      double height,
+      double sensorCov[4]) const;
+
+   // Interpolates the unit look vector at a full image sample in the look
+   // vector table, returning false outside it
+   bool interpolateLookTable(
+      const double& sampleUSGSFull,
+      const double& fractionalLine,
+      double        losApl[3]) const;
+
    // Computes the height above ellipsoid for an input ECF coordinate
    void computeElevation (
       const double& x,
@@ -932,12 +1319,36 @@ private:
 
    // Computes the imaging locus that would view a ground point at a specific
    // time. Computationally, this is the opposite of losToEcf.
+   // Given groundPartials, it also returns the partials of the detector
+   // line and sample with respect to the ground point at that time, line
+   // then sample, in pixels per meter.
    csm::ImageCoord computeViewingPixel(
       const double& time,   // The time to use the EO at
       const csm::EcefCoord& groundPoint,      // The ground coordinate
-      const std::vector<double>& adj // Parameter Adjustments for partials
+      const std::vector<double>& adj, // Parameter Adjustments for partials
+      double* groundPartials = NULL   // Output partials, 6 values
+   ) const;
+
+   // Computes the viewing pixel from the exterior orientation at the time,
+   // as computeViewingPixel above.
+   csm::ImageCoord computeViewingPixel(
+      const LineOrientation& orientation,
+      const csm::EcefCoord& groundPoint,
+      const std::vector<double>& adj,
+      double* groundPartials = NULL
    ) const;
 
+   // Computes the partials of line and sample with respect to a ground
+   // point (line then sample, in pixels per meter) from the time at which
+   // the image views it.  The viewing time is the root of the detector
+   // line offset, so by the implicit function theorem it moves with the
+   // ground point by minus the ratio of the partials of the offset with
+   // respect to the point and to the time.
+   void computeGroundPartials(
+      const csm::EcefCoord& groundPt,
+      double time,
+      double partials[6]) const;
+
    // The linear approximation for the sensor model is used as the starting point
    // for iterative rigorous calculations.
    void computeLinearApproximation(
@@ -950,8 +1361,29 @@ private:
    // Compute the determinant of a 3x3 matrix
    double determinant3x3(double mat[9]) const;
 
+   // Selects the interpolation kernels and the distortion model for the
+   // state data, so that the projection loops do not branch on the platform
+   // flag, the number of quaternions or the IK code.
+   void bindKernels();
+
+   typedef void (UsgsAstroLsTrajectory::*PositionVelocityKernel)(
+      const double&, double*, double*) const;
+   typedef void (UsgsAstroLsTrajectory::*RotationKernel)(
+      const double&, double*) const;
+
 
    UsgsAstroLsStateData _data;  // Holds the state data
+   std::shared_ptr<const UsgsAstroLsTrajectory> _trajectory; // Ephemeris and attitude, shared across images of an orbit
+   PositionVelocityKernel _positionVelocityKernel; // Ephemeris interpolation of the platform's order
+   RotationKernel _rotationKernel; // Attitude interpolation of the platform's order
+   std::shared_ptr<const UsgsAstroDistortion> _distortion; // Lens distortion for the IK code
+   UsgsAstroLsLineTimeTable _lineTimeTable; // Line to time mapping of the integration time segments
+   UsgsAstroGeodesy _geodesy; // Closed form geodetic height for the ellipsoid
+   bool _iterativeGeodesy; // Use the iterative height and intersection instead
+   bool _useLookTable; // Interpolate look vectors from _lookTable
+   std::vector<double> _lookTable; // Look vector and its line rate at each detector sample
+   mutable std::shared_ptr<const ImageEnds> _imageEnds; // Orientation at the first and last image lines, built on first use
+   mutable std::shared_ptr<const std::vector<double> > _sensorPartialsGrid; // Sensor partials over the image between the valid heights, built on first use
 
    csm::NoCorrelationModel     _no_corr_model; // A way to report no correlation between images is supported
    std::vector<double>         _no_adjustment; // A vector of zeros indicating no internal adjustment
@@ -130,6 +130,7 @@ class UsgsAstroLsStateData
    double       m_HalfTime;                       // 50
    std::vector<double> m_Covariance;              // 51
    int          m_ImageFlipFlag;                  // 52
+   int          m_EphemInterpFlag;                // 53
 
    // Hardcoded
    static const std::string      SENSOR_MODEL_NAME; // state date element 0
@@ -198,6 +199,7 @@ class UsgsAstroLsStateData
        STA_HALF_TIME,
        STA_COVARIANCE,
        STA_IMAGE_FLIP_FLAG,
+       STA_EPHEM_INTERP_FLAG,
        _NUM_STATE_KEYWORDS
    };
 
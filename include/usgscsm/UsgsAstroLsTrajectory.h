@@ -0,0 +1,404 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Immutable ephemeris and attitude of a line scanner platform.
+//
+//    Images cut from the same orbit carry the same trajectory identifier
+//    and, usually, identical ephemeris and attitude support data.  Rather
+//    than have every UsgsAstroLsSensorModel own a copy of the trajectory,
+//    models obtain a reference-counted instance through share(), which
+//    returns the existing instance when one with the same identifier and
+//    contents is still alive.  Because the object never changes after
+//    construction, it can be read from any number of models and threads
+//    without locking.
+//
+//    Besides the Lagrange interpolators, the trajectory keeps the
+//    ephemeris as piecewise quintic Hermite polynomials, one per interval
+//    between ephemeris posts, fitted to the positions, the rates and the
+//    accelerations differenced from the rates.  They are built once at
+//    construction and evaluated with a Horner loop.
+//
+//    The attitude is kept the same way: the Lagrange interpolants of the
+//    normalized quaternions are expanded into per-interval polynomials
+//    for the 4th and 8th order interpolations, and getRotationMatrix
+//    evaluates one and returns the rotation directly.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_LINE_SCANNER_TRAJECTORY_H
+#define __USGS_ASTRO_LINE_SCANNER_TRAJECTORY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class UsgsAstroLsStateData;
+
+class UsgsAstroLsTrajectory
+{
+public:
+
+   // Builds a trajectory from the ephemeris and attitude in the state data.
+   UsgsAstroLsTrajectory(const UsgsAstroLsStateData &state_data);
+
+   ~UsgsAstroLsTrajectory() {}
+
+   // Returns a trajectory for the state data, reusing a live instance
+   // with the same trajectory identifier and identical contents when one
+   // exists.  State data without a trajectory identifier always gets a
+   // private instance.
+   static std::shared_ptr<const UsgsAstroLsTrajectory> share(
+      const UsgsAstroLsStateData &state_data);
+
+   // Copies the ephemeris and attitude vectors back into state data.
+   void toStateData(UsgsAstroLsStateData &state_data) const;
+
+   // Returns true if the state data describes this trajectory.
+   bool matches(const UsgsAstroLsStateData &state_data) const;
+
+   // Interpolates the nominal sensor position and velocity at a time
+   // with the order fixed at compile time.
+   template <int ORDER>
+   void getPositionVelocity(
+      const double& time,
+      double        position[3],
+      double        velocity[3]) const;
+
+   // Interpolates the (unnormalized) attitude quaternion at a time with
+   // the order fixed at compile time.
+   template <int ORDER>
+   void getQuaternion(
+      const double& time,
+      double        quaternion[4]) const;
+
+   // Evaluates the piecewise Hermite ephemeris at a time.  The velocity
+   // is the derivative of the position polynomial.  Falls back to Lagrange
+   // interpolation when there are fewer than two ephemeris posts.
+   void getHermitePositionVelocity(
+      const double& time,
+      double        position[3],
+      double        velocity[3]) const;
+
+   // Reports the largest differences between the Hermite ephemeris and
+   // 8th order Lagrange interpolation, sampling every interval at the
+   // given number of evenly spaced times.  Toward the ends of the data
+   // the Lagrange order drops as low as 2, so differences found there
+   // are mostly the error of the Lagrange interpolation.
+   void compareHermiteEphemeris(
+      int     samplesPerInterval,
+      double &maxPositionDifference,
+      double &maxVelocityDifference) const;
+
+   // Returns the rotation from the sensor platform frame to body fixed at
+   // a time, from the attitude interpolated with a maximum order of 4 or
+   // 8.  The interpolated quaternion is not normalized; the rotation is
+   // scaled by its squared norm instead.  The inverse rotation is the
+   // transpose.
+   template <int ORDER>
+   void getRotationMatrix(
+      const double& time,
+      double        rotation[9]) const;
+
+   // Interpolates the nominal sensor position and velocity at a time.
+   void getPositionVelocity(
+      const double& time,
+      const int&    i_order,
+      double        position[3],
+      double        velocity[3]) const;
+
+   // Interpolates the (unnormalized) attitude quaternion at a time.
+   void getQuaternion(
+      const double& time,
+      const int&    i_order,
+      double        quaternion[4]) const;
+
+   const std::string& getIdentifier() const { return m_Identifier; }
+   int    getNumEphem() const { return m_NumEphem; }
+   int    getNumQuaternions() const { return m_NumQuaternions; }
+   const double* getEphemPts() const { return &m_EphemPts[0]; }
+   const double* getEphemRates() const { return &m_EphemRates[0]; }
+
+   // Lagrange interpolation of variable order.
+   static void lagrangeInterp (
+      const int&     numTime,
+      const double*  valueArray,
+      const double&  startTime,
+      const double&  delTime,
+      const double&  time,
+      const int&     vectorLength,
+      const int&     i_order,
+      double*        valueVector );
+
+   // Lagrange interpolation with the order and vector length fixed at
+   // compile time.  Away from the ends of the data the weights and the
+   // accumulation unroll to straight-line code; near the ends, where the
+   // order has to drop, it defers to the variable order version.
+   template <int ORDER, int LENGTH>
+   static void lagrangeInterp (
+      const int&     numTime,
+      const double*  valueArray,
+      const double&  startTime,
+      const double&  delTime,
+      const double&  time,
+      double*        valueVector );
+
+   // Lagrange weights of a given order for a uniform post interval, with
+   // tau measured from the post preceding the interpolation time.
+   template <int ORDER>
+   static void lagrangeWeights(const double& tau, double* d);
+
+private:
+
+   // Not copyable, instances are shared by reference.
+   UsgsAstroLsTrajectory(const UsgsAstroLsTrajectory &);
+   UsgsAstroLsTrajectory& operator=(const UsgsAstroLsTrajectory &);
+
+   // Fits the Hermite ephemeris polynomials.
+   void buildEphemPolynomials();
+
+   // Hermite ephemeris coefficients stored per interval and per axis, six
+   // position coefficients followed by five velocity coefficients, in
+   // increasing powers of the fraction of the interval.
+   static const int EPHEM_POLY_SIZE = 11;
+
+   // Expands the quaternion Lagrange interpolation of a maximum order into
+   // per-interval polynomials.
+   void buildQuatPolynomials(int maxOrder, std::vector<double> &poly) const;
+
+   // Attitude coefficients stored per interval and per component, in
+   // increasing powers of the fraction of the interval, zero padded to
+   // the largest order.
+   static const int QUAT_POLY_SIZE = 8;
+
+   std::string         m_Identifier;
+   double              m_DtEphem;
+   double              m_T0Ephem;
+   double              m_DtQuat;
+   double              m_T0Quat;
+   int                 m_NumEphem;
+   int                 m_NumQuaternions;
+   std::vector<double> m_EphemPts;
+   std::vector<double> m_EphemRates;
+   std::vector<double> m_Quaternions;
+   std::vector<double> m_EphemPoly;
+   std::vector<double> m_QuatPoly4;
+   std::vector<double> m_QuatPoly8;
+};
+
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::lagrangeWeights
+//*****************************************************************************
+template <>
+inline void UsgsAstroLsTrajectory::lagrangeWeights<2>(
+   const double& tau, double* d)
+{
+   double tm1 = tau - 1;
+   d[0] = -tm1;
+   d[1] = tau;
+}
+
+template <>
+inline void UsgsAstroLsTrajectory::lagrangeWeights<4>(
+   const double& tau, double* d)
+{
+   double tp1 = tau + 1;
+   double tm1 = tau - 1;
+   double tm2 = tau - 2;
+   d[0] = -tau * tm1 * tm2 / 6.0;
+   d[1] = tp1 *       tm1 * tm2 / 2.0;
+   d[2] = -tp1 * tau *       tm2 / 2.0;
+   d[3] = tp1 * tau * tm1 / 6.0;
+}
+
+template <>
+inline void UsgsAstroLsTrajectory::lagrangeWeights<6>(
+   const double& tau, double* d)
+{
+   double tp2 = tau + 2;
+   double tp1 = tau + 1;
+   double tm1 = tau - 1;
+   double tm2 = tau - 2;
+   double tm3 = tau - 3;
+   d[0] = -tp1 * tau * tm1 * tm2 * tm3 / 120.0;
+   d[1] = tp2 *       tau * tm1 * tm2 * tm3 / 24.0;
+   d[2] = -tp2 * tp1 *       tm1 * tm2 * tm3 / 12.0;
+   d[3] = tp2 * tp1 * tau *       tm2 * tm3 / 12.0;
+   d[4] = -tp2 * tp1 * tau * tm1 *       tm3 / 24.0;
+   d[5] = tp2 * tp1 * tau * tm1 * tm2 / 120.0;
+}
+
+template <>
+inline void UsgsAstroLsTrajectory::lagrangeWeights<8>(
+   const double& tau, double* d)
+{
+   double tp3 = tau + 3;
+   double tp2 = tau + 2;
+   double tp1 = tau + 1;
+   double tm1 = tau - 1;
+   double tm2 = tau - 2;
+   double tm3 = tau - 3;
+   double tm4 = tau - 4;
+   d[0] = -tp2 * tp1 * tau * tm1 * tm2 * tm3 * tm4 / 5040.0;
+   d[1] = tp3 *       tp1 * tau * tm1 * tm2 * tm3 * tm4 / 720.0;
+   d[2] = -tp3 * tp2 *       tau * tm1 * tm2 * tm3 * tm4 / 240.0;
+   d[3] = tp3 * tp2 * tp1 *       tm1 * tm2 * tm3 * tm4 / 144.0;
+   d[4] = -tp3 * tp2 * tp1 * tau *       tm2 * tm3 * tm4 / 144.0;
+   d[5] = tp3 * tp2 * tp1 * tau * tm1 *       tm3 * tm4 / 240.0;
+   d[6] = -tp3 * tp2 * tp1 * tau * tm1 * tm2 *       tm4 / 720.0;
+   d[7] = tp3 * tp2 * tp1 * tau * tm1 * tm2 * tm3 / 5040.0;
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::lagrangeInterp (fixed order)
+//*****************************************************************************
+template <int ORDER, int LENGTH>
+inline void UsgsAstroLsTrajectory::lagrangeInterp(
+   const int&     numTime,
+   const double*  valueArray,
+   const double&  startTime,
+   const double&  delTime,
+   const double&  time,
+   double*        valueVector)
+{
+   double fndex = (time - startTime) / delTime;
+   int    index = int(fndex);
+
+   // The full order needs ORDER / 2 posts on either side of the interval
+   if (index < ORDER / 2 - 1 || index > numTime - 1 - ORDER / 2)
+   {
+      lagrangeInterp(numTime, valueArray, startTime, delTime, time,
+         LENGTH, ORDER, valueVector);
+      return;
+   }
+
+   double d[ORDER];
+   lagrangeWeights<ORDER>(fndex - index, d);
+
+   const double* values = valueArray + LENGTH * (index - ORDER / 2 + 1);
+   for (int j = 0; j < LENGTH; j++)
+   {
+      valueVector[j] = 0.0;
+   }
+   for (int i = 0; i < ORDER; i++)
+   {
+      for (int j = 0; j < LENGTH; j++)
+      {
+         valueVector[j] += d[i] * values[LENGTH * i + j];
+      }
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getPositionVelocity (fixed order)
+//*****************************************************************************
+template <int ORDER>
+inline void UsgsAstroLsTrajectory::getPositionVelocity(
+   const double& time,
+   double        position[3],
+   double        velocity[3]) const
+{
+   lagrangeInterp<ORDER, 3>(m_NumEphem, &m_EphemPts[0], m_T0Ephem, m_DtEphem,
+      time, position);
+   lagrangeInterp<ORDER, 3>(m_NumEphem, &m_EphemRates[0], m_T0Ephem, m_DtEphem,
+      time, velocity);
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getHermitePositionVelocity
+//*****************************************************************************
+inline void UsgsAstroLsTrajectory::getHermitePositionVelocity(
+   const double& time,
+   double        position[3],
+   double        velocity[3]) const
+{
+   if (m_EphemPoly.empty())
+   {
+      getPositionVelocity(time, 8, position, velocity);
+      return;
+   }
+
+   double fndex = (time - m_T0Ephem) / m_DtEphem;
+   int    index = int(fndex);
+   if (index < 0)
+   {
+      index = 0;
+   }
+   if (index > m_NumEphem - 2)
+   {
+      index = m_NumEphem - 2;
+   }
+   double tau = fndex - index;
+
+   const double* c = &m_EphemPoly[3 * EPHEM_POLY_SIZE * index];
+   for (int k = 0; k < 3; k++, c += EPHEM_POLY_SIZE)
+   {
+      position[k] = c[0] + tau * (c[1] + tau * (c[2] + tau * (c[3]
+                  + tau * (c[4] + tau * c[5]))));
+      velocity[k] = c[6] + tau * (c[7] + tau * (c[8] + tau * (c[9]
+                  + tau * c[10])));
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getQuaternion (fixed order)
+//*****************************************************************************
+template <int ORDER>
+inline void UsgsAstroLsTrajectory::getQuaternion(
+   const double& time,
+   double        quaternion[4]) const
+{
+   lagrangeInterp<ORDER, 4>(m_NumQuaternions, &m_Quaternions[0], m_T0Quat,
+      m_DtQuat, time, quaternion);
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getRotationMatrix
+//*****************************************************************************
+template <int ORDER>
+inline void UsgsAstroLsTrajectory::getRotationMatrix(
+   const double& time,
+   double        rotation[9]) const
+{
+   const std::vector<double>& poly = ORDER <= 4 ? m_QuatPoly4 : m_QuatPoly8;
+   double q[4];
+   if (poly.empty())
+   {
+      getQuaternion(time, ORDER, q);
+   }
+   else
+   {
+      double fndex = (time - m_T0Quat) / m_DtQuat;
+      int    index = int(fndex);
+      if (index < 0)
+      {
+         index = 0;
+      }
+      if (index > m_NumQuaternions - 2)
+      {
+         index = m_NumQuaternions - 2;
+      }
+      double tau = fndex - index;
+
+      const double* c = &poly[4 * QUAT_POLY_SIZE * index];
+      for (int k = 0; k < 4; k++, c += QUAT_POLY_SIZE)
+      {
+         q[k] = c[0] + tau * (c[1] + tau * (c[2] + tau * (c[3] + tau * (c[4]
+              + tau * (c[5] + tau * (c[6] + tau * c[7]))))));
+      }
+   }
+
+   double scale = 1.0 / (q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+   double scale2 = 2.0 * scale;
+   rotation[0] = (q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3]) * scale;
+   rotation[1] = (q[0] * q[1] - q[2] * q[3]) * scale2;
+   rotation[2] = (q[0] * q[2] + q[1] * q[3]) * scale2;
+   rotation[3] = (q[0] * q[1] + q[2] * q[3]) * scale2;
+   rotation[4] = (-q[0] * q[0] + q[1] * q[1] - q[2] * q[2] + q[3] * q[3]) * scale;
+   rotation[5] = (q[1] * q[2] - q[0] * q[3]) * scale2;
+   rotation[6] = (q[0] * q[2] - q[1] * q[3]) * scale2;
+   rotation[7] = (q[1] * q[2] + q[0] * q[3]) * scale2;
+   rotation[8] = (-q[0] * q[0] - q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) * scale;
+}
+
+#endif
@@ -0,0 +1,36 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Splitting of a batch into contiguous blocks run on several threads,
+//    for the batch methods of the sensor models and the rasters.
+//
+//    The last block runs on the calling thread, as does any block whose
+//    thread cannot be started.  An exception thrown by a block is kept
+//    until every block has finished, and the first, in block order, is
+//    then rethrown on the calling thread.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_PARALLEL_H
+#define __USGS_ASTRO_PARALLEL_H
+
+#include <functional>
+
+class UsgsAstroParallel
+{
+public:
+
+   // Work on the items from first up to last, as block of the batch.
+   typedef std::function<void(int block, int first, int last)> BlockWork;
+
+   // Returns the number of threads for numItems items: numThreads, or all
+   // the available ones for zero or less, reduced to leave at least
+   // minItemsPerThread items per thread, and at least one.
+   static int numThreads(int numThreads, int numItems, int minItemsPerThread);
+
+   // Runs work on numBlocks contiguous blocks of numItems items, the block
+   // sizes differing by at most one.
+   static void parallelFor(int numItems, int numBlocks, const BlockWork &work);
+};
+
+#endif
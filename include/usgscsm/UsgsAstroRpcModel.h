@@ -0,0 +1,136 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Rational polynomial approximation of a rigorous sensor model.
+//
+//    Line and sample are each the ratio of two cubic polynomials in
+//    normalized latitude, longitude and height, with the twenty terms in
+//    the order of the RPC00B format.  The rigorous model is sampled with
+//    imageToGround on a grid over its valid image range and several heights
+//    over its valid height range, and the coefficients are solved by linear
+//    least squares on the line and sample equations multiplied through by
+//    the denominator, reweighted by the denominator from the previous
+//    solution so that the residuals are those of the ratio.  A second grid,
+//    at the centers of the cells of the first, gives independent check
+//    residuals, and the ratios fall back to plain cubic polynomials when
+//    those do better there.
+//
+//    Evaluating the approximation needs the geodetic coordinates of the
+//    ground point and two polynomial ratios, against an iterative search
+//    with the rigorous model.
+//
+//    The approximation is not a csm::RasterGM.  It offers only ground to
+//    image, image to ground at a height and the valid ranges; partials,
+//    covariance, loci, state and the other parts of the CSM interface are
+//    left to the rigorous model it approximates.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_RPC_MODEL_H
+#define __USGS_ASTRO_RPC_MODEL_H
+
+#include "UsgsAstroGeodesy.h"
+
+#include <RasterGM.h>
+
+#include <utility>
+#include <vector>
+
+class UsgsAstroRpcModel
+{
+public:
+
+   static const int NUM_TERMS = 20;
+
+   // Fits the approximation to a rigorous model with the given ellipsoid.
+   // The image range is sampled at gridSize by gridSize points and the
+   // height range at numHeights heights; a height range narrower than a
+   // kilometer is widened to one about its middle so that the height terms
+   // stay determined.  Throws csm::Error for too small a grid and for
+   // ellipsoids without geodetic coordinates.
+   UsgsAstroRpcModel(
+      const csm::RasterGM &model,
+      double               semiMajorAxis,
+      double               semiMinorAxis,
+      int                  gridSize = 15,
+      int                  numHeights = 5);
+
+   // Restores a fitted approximation.  The offsets and scales are of the
+   // line, sample, latitude and longitude (degrees) and height, and the
+   // coefficients are the line numerator and denominator then the sample
+   // numerator and denominator, NUM_TERMS each.
+   UsgsAstroRpcModel(
+      double        semiMajorAxis,
+      double        semiMinorAxis,
+      const double *offsets,
+      const double *scales,
+      const double *coefficients);
+
+   ~UsgsAstroRpcModel() {}
+
+   csm::ImageCoord groundToImage(const csm::EcefCoord &groundPt) const;
+
+   // Intersects the image point with the surface at a height by Newton
+   // iteration on latitude and longitude.  Throws csm::Error if it does
+   // not converge.
+   csm::EcefCoord imageToGround(
+      const csm::ImageCoord &imagePt,
+      double                 height) const;
+
+   std::pair<csm::ImageCoord, csm::ImageCoord> getValidImageRange() const;
+
+   std::pair<double, double> getValidHeightRange() const;
+
+   // Offsets and scales, in the order of the restoring constructor.
+   const double *getOffsets() const { return m_Offsets; }
+   const double *getScales() const { return m_Scales; }
+
+   // Coefficients, in the order of the restoring constructor.
+   const double *getCoefficients() const { return m_Coefficients; }
+
+   // Root mean square and largest residuals in pixels, over the fit grid
+   // and over the check grid.  Zero for a restored approximation.
+   double getFitRmsResidual() const { return m_FitRms; }
+   double getFitMaxResidual() const { return m_FitMax; }
+   double getCheckRmsResidual() const { return m_CheckRms; }
+   double getCheckMaxResidual() const { return m_CheckMax; }
+
+private:
+
+   // Geodetic latitude and longitude of a ground point in degrees, the
+   // longitude within half a turn of its offset, and normalized height.
+   // Returns false where the geodetic coordinates are not available.
+   bool normalize(
+      const csm::EcefCoord &groundPt,
+      double               &latitude,
+      double               &longitude,
+      double               &height) const;
+
+   // Solves one coordinate, line (0) or sample (1), from the normalized
+   // ground points and image coordinates, as a ratio or with a denominator
+   // of one.
+   void fitCoordinate(
+      int                        coordinate,
+      bool                       rational,
+      const std::vector<double> &ground,
+      const std::vector<double> &image);
+
+   // Largest and root mean square distance, in pixels, between the image
+   // points of the ground points and the given ones.
+   void residuals(
+      const std::vector<double> &ground,
+      const std::vector<double> &image,
+      double                    &rms,
+      double                    &max) const;
+
+   UsgsAstroGeodesy m_Geodesy;
+   double           m_Offsets[5];
+   double           m_Scales[5];
+   double           m_Coefficients[4 * NUM_TERMS];
+   double           m_FitRms;
+   double           m_FitMax;
+   double           m_CheckRms;
+   double           m_CheckMax;
+};
+
+#endif
@@ -0,0 +1,74 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Least squares intersection of the rays of several images of a ground
+//    point, for the frame and line scanner sensor models.
+//
+//    The rays come from imageToRay for the models of this library and
+//    from imageToRemoteImagingLocus and getSensorPosition for other
+//    models.  Each observation costs two of them, its own ray and the ray
+//    one sample over, whose angle from it gives the angle subtended by the
+//    image measurement standard deviation.  The point minimizes the
+//    weighted sum of its squared distances to the rays, each weighted by
+//    the inverse square of the ground distance subtended by that angle at
+//    the point, and the covariance is the inverse of the normal matrix of
+//    that problem.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_TRIANGULATION_H
+#define __USGS_ASTRO_TRIANGULATION_H
+
+#include <RasterGM.h>
+
+class UsgsAstroTriangulation
+{
+public:
+
+   struct Observation
+   {
+      const csm::RasterGM *model;
+      csm::ImageCoord      imagePt;
+      double               sigma;    // image measurement standard
+                                     // deviation, in pixels
+   };
+
+   // Returns the ray of an image point, with the sensor position as its
+   // point and the unit look direction as its direction.
+   static csm::EcefLocus getRay(
+      const csm::RasterGM   &model,
+      const csm::ImageCoord &imagePt);
+
+   // Intersects the rays of numObservations observations of one ground
+   // point.  The covariance (3 by 3, row major, square meters) and the
+   // distances in meters of the point from each ray are returned where the
+   // pointers are not NULL.  Returns false, leaving the outputs unset, for
+   // fewer than two observations and for rays too close to parallel to
+   // intersect.  Errors from the models are passed on.
+   static bool triangulate(
+      int                numObservations,
+      const Observation *observations,
+      csm::EcefCoord    &groundPt,
+      double            *covariance = NULL,
+      double            *residuals = NULL);
+
+   // Intersects numMatches matches at once on numThreads threads, all the
+   // available ones for zero.  The observations of match i are those from
+   // matchStart[i] up to matchStart[i + 1], and groundPts, covariances (9
+   // per match) and valid are per match, residuals per observation.  Any
+   // of covariances, residuals and valid may be NULL.  A match whose
+   // triangulate fails or whose models throw csm::Error is not valid;
+   // other errors are rethrown on the calling thread once every thread
+   // has finished.  Returns the number of valid matches.
+   static int triangulate(
+      int                numMatches,
+      const int         *matchStart,
+      const Observation *observations,
+      csm::EcefCoord    *groundPts,
+      double            *covariances,
+      double            *residuals,
+      bool              *valid,
+      int                numThreads = 0);
+};
+
+#endif
@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Raster of the ground covariance of every pixel of an image region,
+//    for models that implement the covariance form of imageToGround.
+//
+//    The region is split into square tiles, spread over threads.  Each
+//    tile starts as one cell whose corner pixels are evaluated rigorously,
+//    with the sensor, unmodeled and measurement covariances the model
+//    includes, and the covariance of the pixels inside a cell is the
+//    bilinear interpolation of its corners.  Weights that are positive and
+//    sum to one keep the interpolation positive definite.  A cell is
+//    accepted when the rigorous covariance at its center is within a
+//    tolerance of the interpolation there, and is otherwise split in four
+//    down to single pixels.  The tolerance is relative to the standard
+//    deviations: entry (i, j) may differ by the tolerance times the square
+//    root of the product of diagonal entries i and j.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __USGS_ASTRO_UNCERTAINTY_RASTER_H
+#define __USGS_ASTRO_UNCERTAINTY_RASTER_H
+
+#include <RasterGM.h>
+
+class UsgsAstroUncertaintyRaster
+{
+public:
+
+   // Prepares the raster of a model at a height in meters above its
+   // ellipsoid, with a height variance in square meters, and a covariance
+   // of the image measurements in square pixels (line, line-sample,
+   // sample-line and sample), zero if NULL.
+   UsgsAstroUncertaintyRaster(
+      const csm::RasterGM &model,
+      double               height,
+      double               heightVariance,
+      double               tolerance,
+      const double        *imageCovariance = NULL);
+
+   ~UsgsAstroUncertaintyRaster() {}
+
+   // Computes the covariance of numLines by numSamples pixels, pixel (r,
+   // c) at line firstLine + r * spacing and sample firstSample + c *
+   // spacing, on numThreads threads, all the available ones for zero.  The
+   // covariances, in square meters, are written 6 per pixel in row major
+   // pixel order as the xx, xy, xz, yy, yz and zz entries, NaN for the
+   // pixels that could not be evaluated.  Returns the number of pixels
+   // with a covariance.  Exceptions other than the csm::Error of a pixel
+   // that cannot be evaluated are rethrown on the calling thread.
+   int compute(
+      double  firstLine,
+      double  firstSample,
+      double  spacing,
+      int     numLines,
+      int     numSamples,
+      double *covariances,
+      int     numThreads = 0);
+
+   // Returns the largest relative difference, over the accepted cells of
+   // the last compute, between the rigorous covariance at the center and
+   // the interpolation there.  For covariances of slowly changing
+   // curvature over the image it bounds the error of every pixel.
+   double getErrorBound() const { return m_ErrorBound; }
+
+   // Returns the number of rigorous evaluations of the last compute.
+   int getNumEvaluations() const { return m_NumEvaluations; }
+
+private:
+
+   const csm::RasterGM *m_Model;
+   double               m_Height;
+   double               m_HeightVariance;
+   double               m_Tolerance;
+   double               m_ImageCovariance[4];
+   double               m_ErrorBound;
+   int                  m_NumEvaluations;
+};
+
+#endif
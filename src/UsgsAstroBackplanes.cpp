@@ -0,0 +1,268 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Geometric and photometric backplanes of an image region, for the
+//    frame and line scanner sensor models.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroBackplanes.h"
+#include "UsgsAstroGeodesy.h"
+#include "UsgsAstroLsSensorModel.h"
+#include "UsgsAstroParallel.h"
+#include "UsgsAstroTriangulation.h"
+
+#include <Error.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <vector>
+
+// Lines per thread below which the region uses fewer threads.
+static const int MIN_LINES_PER_THREAD = 8;
+
+static const double RAD_TO_DEG = 180.0 / M_PI;
+
+// Returns the angle in degrees between two vectors of the given lengths.
+static double angleBetween(const double a[3], double aLength,
+                           const double b[3], double bLength)
+{
+   double cosine = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2])
+                 / (aLength * bLength);
+   return acos(std::max(-1.0, std::min(1.0, cosine))) * RAD_TO_DEG;
+}
+
+//*****************************************************************************
+// UsgsAstroBackplanes Constructor
+//*****************************************************************************
+UsgsAstroBackplanes::UsgsAstroBackplanes(
+   const csm::RasterGM &model,
+   double               semiMajorAxis,
+   double               semiMinorAxis,
+   double               height)
+:
+   m_Model(&model),
+   m_SemiMajorAxis(semiMajorAxis),
+   m_SemiMinorAxis(semiMinorAxis),
+   m_Height(height),
+   m_HasSunPosition(false)
+{
+}
+
+//*****************************************************************************
+// UsgsAstroBackplanes::setSunPosition
+//*****************************************************************************
+void UsgsAstroBackplanes::setSunPosition(const csm::EcefCoord &sunPosition)
+{
+   m_SunPosition = sunPosition;
+   m_HasSunPosition = true;
+}
+
+//*****************************************************************************
+// UsgsAstroBackplanes::computeLines
+//*****************************************************************************
+void UsgsAstroBackplanes::computeLines(
+   int            first,
+   int            last,
+   double         firstLine,
+   double         firstSample,
+   double         spacing,
+   int            numSamples,
+   bool           illuminated,
+   double *const  planes[NUM_PLANES],
+   int           *numValid) const
+{
+   const UsgsAstroLsSensorModel *ls =
+      dynamic_cast<const UsgsAstroLsSensorModel *>(m_Model);
+   UsgsAstroGeodesy geodesy(m_SemiMajorAxis, m_SemiMinorAxis);
+   const double nan = std::numeric_limits<double>::quiet_NaN();
+
+   // The ray one spacing past the last pixel gives the resolution of the
+   // last pixel
+   std::vector<csm::EcefLocus> rays(numSamples + 1);
+   std::vector<bool> hasRay(numSamples + 1);
+   int count = 0;
+   for (int r = first; r < last; r++)
+   {
+      double line = firstLine + r * spacing;
+      if (ls)
+      {
+         ls->imageToRays(line, firstSample, spacing, numSamples + 1, &rays[0]);
+         std::fill(hasRay.begin(), hasRay.end(), true);
+      }
+      else
+      {
+         for (int c = 0; c <= numSamples; c++)
+         {
+            try
+            {
+               rays[c] = UsgsAstroTriangulation::getRay(
+                  *m_Model, csm::ImageCoord(line, firstSample + c * spacing));
+               hasRay[c] = true;
+            }
+            catch (csm::Error &)
+            {
+               hasRay[c] = false;
+            }
+         }
+      }
+
+      for (int c = 0; c < numSamples; c++)
+      {
+         double values[NUM_PLANES];
+         std::fill(values, values + NUM_PLANES, nan);
+         const csm::EcefLocus &ray = rays[c];
+         double ground[3];
+         double achieved;
+         bool missed = false;
+         double latitude, height;
+         if (hasRay[c] &&
+             geodesy.intersect(
+                m_Height, ray.point.x, ray.point.y, ray.point.z,
+                ray.direction.x, ray.direction.y, ray.direction.z,
+                ground[0], ground[1], ground[2], achieved, 0.001,
+                &missed) >= 0 &&
+             !missed &&
+             geodesy.toGeodetic(
+                ground[0], ground[1], ground[2], latitude, height))
+         {
+            count++;
+            double longitude = atan2(ground[1], ground[0]);
+            double normal[3] = { cos(latitude) * cos(longitude),
+                                 cos(latitude) * sin(longitude),
+                                 sin(latitude) };
+            double toSensor[3] = { ray.point.x - ground[0],
+                                   ray.point.y - ground[1],
+                                   ray.point.z - ground[2] };
+            double range = sqrt(toSensor[0] * toSensor[0]
+                              + toSensor[1] * toSensor[1]
+                              + toSensor[2] * toSensor[2]);
+            for (int k = 0; k < 3; k++)
+            {
+               values[GROUND_X + k] = ground[k];
+               values[NORMAL_X + k] = normal[k];
+            }
+            values[LATITUDE] = latitude * RAD_TO_DEG;
+            values[LONGITUDE] = longitude * RAD_TO_DEG;
+            values[HEIGHT] = height;
+            values[EMISSION] = angleBetween(normal, 1.0, toSensor, range);
+
+            double toSun[3];
+            bool hasSun = true;
+            if (m_HasSunPosition)
+            {
+               toSun[0] = m_SunPosition.x - ground[0];
+               toSun[1] = m_SunPosition.y - ground[1];
+               toSun[2] = m_SunPosition.z - ground[2];
+            }
+            else if (illuminated)
+            {
+               try
+               {
+                  csm::EcefVector direction =
+                     m_Model->getIlluminationDirection(
+                        csm::EcefCoord(ground[0], ground[1], ground[2]));
+                  toSun[0] = -direction.x;
+                  toSun[1] = -direction.y;
+                  toSun[2] = -direction.z;
+               }
+               catch (csm::Error &)
+               {
+                  hasSun = false;
+               }
+            }
+            else
+            {
+               hasSun = false;
+            }
+            if (hasSun)
+            {
+               double sunDistance = sqrt(toSun[0] * toSun[0]
+                                       + toSun[1] * toSun[1]
+                                       + toSun[2] * toSun[2]);
+               values[INCIDENCE] =
+                  angleBetween(normal, 1.0, toSun, sunDistance);
+               values[PHASE] =
+                  angleBetween(toSensor, range, toSun, sunDistance);
+            }
+
+            // The angle between the unit rays of neighbouring pixels, from
+            // their chord
+            if (hasRay[c + 1])
+            {
+               const csm::EcefVector &d0 = ray.direction;
+               const csm::EcefVector &d1 = rays[c + 1].direction;
+               double chord = sqrt((d1.x - d0.x) * (d1.x - d0.x)
+                                 + (d1.y - d0.y) * (d1.y - d0.y)
+                                 + (d1.z - d0.z) * (d1.z - d0.z));
+               values[RESOLUTION] =
+                  range * 2.0 * asin(std::min(1.0, chord / 2.0)) / spacing;
+            }
+         }
+
+         long long pixel = (long long)r * numSamples + c;
+         for (int p = 0; p < NUM_PLANES; p++)
+         {
+            if (planes[p])
+            {
+               planes[p][pixel] = values[p];
+            }
+         }
+      }
+   }
+   *numValid = count;
+}
+
+//*****************************************************************************
+// UsgsAstroBackplanes::compute
+//*****************************************************************************
+int UsgsAstroBackplanes::compute(
+   double         firstLine,
+   double         firstSample,
+   double         spacing,
+   int            numLines,
+   int            numSamples,
+   double *const  planes[NUM_PLANES],
+   int            numThreads) const
+{
+   if (numLines <= 0 || numSamples <= 0 || !(spacing > 0.0))
+   {
+      return 0;
+   }
+
+   // Models without an illumination direction throw for any point
+   bool illuminated = false;
+   if (!m_HasSunPosition)
+   {
+      try
+      {
+         m_Model->getIlluminationDirection(
+            csm::EcefCoord(m_SemiMajorAxis, 0.0, 0.0));
+         illuminated = true;
+      }
+      catch (csm::Error &)
+      {
+      }
+   }
+
+   numThreads = UsgsAstroParallel::numThreads(
+      numThreads, numLines, MIN_LINES_PER_THREAD);
+
+   // Contiguous blocks of lines
+   std::vector<int> numValid(numThreads, 0);
+   UsgsAstroParallel::parallelFor(numLines, numThreads,
+      [&](int block, int first, int last)
+      {
+         computeLines(first, last, firstLine, firstSample, spacing,
+                      numSamples, illuminated, planes, &numValid[block]);
+      });
+
+   int total = 0;
+   for (int t = 0; t < numThreads; t++)
+   {
+      total += numValid[t];
+   }
+   return total;
+}
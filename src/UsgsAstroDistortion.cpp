@@ -0,0 +1,528 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Lens distortion models shared by the frame and line scanner sensor
+//    models.
+//
+//-----------------------------------------------------------------------------
+
+#include "UsgsAstroDistortion.h"
+
+#include <map>
+#include <mutex>
+#include <math.h>
+
+#include <Error.h>
+
+namespace
+{
+   // Returns the i-th coefficient, or zero past the end of the list.
+   double coefficient(const std::vector<double> &coefficients, size_t i)
+   {
+      return i < coefficients.size() ? coefficients[i] : 0.0;
+   }
+
+   std::shared_ptr<const UsgsAstroDistortion> createNone(
+      const std::vector<double> & /* coefficients */)
+   {
+      return std::make_shared<const UsgsAstroNoDistortion>();
+   }
+
+   std::shared_ptr<const UsgsAstroDistortion> createRadial(
+      const std::vector<double> &coefficients)
+   {
+      return std::make_shared<const UsgsAstroRadialDistortion>(coefficients);
+   }
+
+   std::shared_ptr<const UsgsAstroDistortion> createTaylor(
+      const std::vector<double> &coefficients)
+   {
+      return std::make_shared<const UsgsAstroTaylorDistortion>(coefficients);
+   }
+
+   std::shared_ptr<const UsgsAstroDistortion> createTransverse(
+      const std::vector<double> &coefficients)
+   {
+      return std::make_shared<const UsgsAstroTransverseDistortion>(coefficients);
+   }
+
+   typedef std::map<std::string, UsgsAstroDistortion::Factory> FactoryMap;
+
+   std::mutex registryMutex;
+
+   // Built on first use so that registration from other static
+   // initializers is safe.
+   FactoryMap &registry()
+   {
+      static FactoryMap factories;
+      if (factories.empty())
+      {
+         factories["NONE"]       = &createNone;
+         factories["RADIAL"]     = &createRadial;
+         factories["TAYLOR"]     = &createTaylor;
+         factories["TRANSVERSE"] = &createTransverse;
+      }
+      return factories;
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroDistortion::create
+//*****************************************************************************
+std::shared_ptr<const UsgsAstroDistortion> UsgsAstroDistortion::create(
+   const std::string         &name,
+   const std::vector<double> &coefficients)
+{
+   Factory factory = 0;
+   {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      FactoryMap::const_iterator it = registry().find(name);
+      if (it != registry().end())
+      {
+         factory = it->second;
+      }
+   }
+
+   if (!factory)
+   {
+      throw csm::Error(
+         csm::Error::INVALID_USE,
+         "Unknown distortion model: " + name,
+         "UsgsAstroDistortion::create");
+   }
+   return factory(coefficients);
+}
+
+//*****************************************************************************
+// UsgsAstroDistortion::registerModel
+//*****************************************************************************
+void UsgsAstroDistortion::registerModel(
+   const std::string &name,
+   Factory            factory)
+{
+   std::lock_guard<std::mutex> lock(registryMutex);
+   registry()[name] = factory;
+}
+
+//*****************************************************************************
+// UsgsAstroDistortion::isRegistered
+//*****************************************************************************
+bool UsgsAstroDistortion::isRegistered(const std::string &name)
+{
+   std::lock_guard<std::mutex> lock(registryMutex);
+   return registry().count(name) > 0;
+}
+
+//*****************************************************************************
+// UsgsAstroDistortion::distort (array)
+//*****************************************************************************
+void UsgsAstroDistortion::distort(
+   int           n,
+   const double *ux,
+   const double *uy,
+   double       *dx,
+   double       *dy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      distort(ux[i], uy[i], dx[i], dy[i]);
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroDistortion::undistort (array)
+//*****************************************************************************
+void UsgsAstroDistortion::undistort(
+   int           n,
+   const double *dx,
+   const double *dy,
+   double       *ux,
+   double       *uy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      undistort(dx[i], dy[i], ux[i], uy[i]);
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroNoDistortion
+//*****************************************************************************
+void UsgsAstroNoDistortion::distort(
+   double ux, double uy, double &dx, double &dy) const
+{
+   dx = ux;
+   dy = uy;
+}
+
+void UsgsAstroNoDistortion::undistort(
+   double dx, double dy, double &ux, double &uy) const
+{
+   ux = dx;
+   uy = dy;
+}
+
+void UsgsAstroNoDistortion::jacobian(
+   double /* ux */, double /* uy */,
+   double &Jxx, double &Jxy, double &Jyx, double &Jyy) const
+{
+   Jxx = 1.0;
+   Jxy = 0.0;
+   Jyx = 0.0;
+   Jyy = 1.0;
+}
+
+//*****************************************************************************
+// UsgsAstroRadialDistortion
+//*****************************************************************************
+UsgsAstroRadialDistortion::UsgsAstroRadialDistortion(
+   const std::vector<double> &coefficients)
+:
+   m_k0(coefficient(coefficients, 0)),
+   m_k1(coefficient(coefficients, 1)),
+   m_k2(coefficient(coefficients, 2))
+{
+}
+
+void UsgsAstroRadialDistortion::undistort(
+   double dx, double dy, double &ux, double &uy) const
+{
+   ux = dx;
+   uy = dy;
+   double rr = dx * dx + dy * dy;
+   if (rr > 1.0E-6)
+   {
+      double dr = m_k0 + (rr * (m_k1 + rr * m_k2));
+      ux = dx * (1.0 - dr);
+      uy = dy * (1.0 - dr);
+   }
+}
+
+void UsgsAstroRadialDistortion::undistort(
+   int           n,
+   const double *dx,
+   const double *dy,
+   double       *ux,
+   double       *uy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      double rr = dx[i] * dx[i] + dy[i] * dy[i];
+      double scale = 1.0 - (m_k0 + (rr * (m_k1 + rr * m_k2)));
+      scale = rr > 1.0E-6 ? scale : 1.0;
+      ux[i] = dx[i] * scale;
+      uy[i] = dy[i] * scale;
+   }
+}
+
+void UsgsAstroRadialDistortion::distort(
+   double ux, double uy, double &dx, double &dy) const
+{
+   // The distortion only scales the radius, so invert it along the radius
+   // with Newton's method on rd * (1 - k0 - k1 rd^2 - k2 rd^4) = ru.
+   dx = ux;
+   dy = uy;
+   double ru = sqrt(ux * ux + uy * uy);
+   if (ru == 0.0 || m_k0 >= 1.0)
+   {
+      return;
+   }
+
+   double rd = ru / (1.0 - m_k0);
+   bool converged = false;
+   for (int it = 0; it < 10; it++)
+   {
+      double rr = rd * rd;
+      double f = rd * (1.0 - m_k0 - rr * (m_k1 + rr * m_k2)) - ru;
+      double df = 1.0 - m_k0 - rr * (3.0 * m_k1 + rr * 5.0 * m_k2);
+      // Past the turning point of the polynomial there is no inverse
+      if (df <= 0.0)
+      {
+         break;
+      }
+      double step = f / df;
+      rd -= step;
+      if (fabs(step) < 1.0E-12)
+      {
+         converged = true;
+         break;
+      }
+   }
+
+   // Far from the detector the polynomial need not be invertible, leave
+   // those coordinates undistorted.  Radii inside the threshold used by
+   // undistort are not distorted either.
+   if (!converged || rd * rd <= 1.0E-6)
+   {
+      return;
+   }
+   dx = ux * rd / ru;
+   dy = uy * rd / ru;
+}
+
+void UsgsAstroRadialDistortion::jacobian(
+   double ux, double uy,
+   double &Jxx, double &Jxy, double &Jyx, double &Jyy) const
+{
+   // Invert the Jacobian of undistort, s I - c d d^T, at the distorted
+   // coordinate.
+   double dx, dy;
+   distort(ux, uy, dx, dy);
+   double rr = dx * dx + dy * dy;
+   if (rr <= 1.0E-6)
+   {
+      Jxx = 1.0;
+      Jxy = 0.0;
+      Jyx = 0.0;
+      Jyy = 1.0;
+      return;
+   }
+   double s = 1.0 - (m_k0 + (rr * (m_k1 + rr * m_k2)));
+   double c = 2.0 * m_k1 + 4.0 * m_k2 * rr;
+   double a11 = s - c * dx * dx;
+   double a12 = -c * dx * dy;
+   double a22 = s - c * dy * dy;
+   double determinant = a11 * a22 - a12 * a12;
+   Jxx = a22 / determinant;
+   Jxy = -a12 / determinant;
+   Jyx = -a12 / determinant;
+   Jyy = a11 / determinant;
+}
+
+//*****************************************************************************
+// UsgsAstroTaylorDistortion
+//*****************************************************************************
+UsgsAstroTaylorDistortion::UsgsAstroTaylorDistortion(
+   const std::vector<double> &coefficients)
+{
+   for (int i = 0; i < 10; i++)
+   {
+      m_odtX[i] = coefficient(coefficients, i);
+      m_odtY[i] = coefficient(coefficients, i + 10);
+   }
+}
+
+void UsgsAstroTaylorDistortion::distort(
+   double ux, double uy, double &dx, double &dy) const
+{
+   double f[10];
+   f[0] = 1;
+   f[1] = ux;
+   f[2] = uy;
+   f[3] = ux * ux;
+   f[4] = ux * uy;
+   f[5] = uy * uy;
+   f[6] = ux * ux * ux;
+   f[7] = ux * ux * uy;
+   f[8] = ux * uy * uy;
+   f[9] = uy * uy * uy;
+
+   dx = 0.0;
+   dy = 0.0;
+   for (int i = 0; i < 10; i++)
+   {
+      dx = dx + f[i] * m_odtX[i];
+      dy = dy + f[i] * m_odtY[i];
+   }
+}
+
+void UsgsAstroTaylorDistortion::distort(
+   int           n,
+   const double *ux,
+   const double *uy,
+   double       *dx,
+   double       *dy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      double x = ux[i];
+      double y = uy[i];
+      double xx = x * x;
+      double xy = x * y;
+      double yy = y * y;
+      dx[i] = m_odtX[0] + m_odtX[1] * x + m_odtX[2] * y
+            + m_odtX[3] * xx + m_odtX[4] * xy + m_odtX[5] * yy
+            + m_odtX[6] * xx * x + m_odtX[7] * xx * y
+            + m_odtX[8] * x * yy + m_odtX[9] * yy * y;
+      dy[i] = m_odtY[0] + m_odtY[1] * x + m_odtY[2] * y
+            + m_odtY[3] * xx + m_odtY[4] * xy + m_odtY[5] * yy
+            + m_odtY[6] * xx * x + m_odtY[7] * xx * y
+            + m_odtY[8] * x * yy + m_odtY[9] * yy * y;
+   }
+}
+
+void UsgsAstroTaylorDistortion::undistort(
+   double dx, double dy, double &ux, double &uy) const
+{
+   // Solve the distortion equation using the Newton-Raphson method.
+   // Set the error tolerance to about one millionth of a NAC pixel.
+   const double tol = 1.4E-5;
+
+   // The maximum number of iterations of the Newton-Raphson method.
+   const int maxTries = 60;
+
+   double x;
+   double y;
+   double fx;
+   double fy;
+   double Jxx;
+   double Jxy;
+   double Jyx;
+   double Jyy;
+
+   // Initial guess at the root
+   x = dx;
+   y = dy;
+
+   distort(x, y, fx, fy);
+
+   for (int count = 1; ((fabs(fx) + fabs(fy)) > tol) && (count < maxTries); count++)
+   {
+      distort(x, y, fx, fy);
+
+      fx = dx - fx;
+      fy = dy - fy;
+
+      jacobian(x, y, Jxx, Jxy, Jyx, Jyy);
+
+      double determinant = Jxx * Jyy - Jxy * Jyx;
+      if (determinant < 1E-6)
+      {
+         // Near-zero determinant, return with no convergence
+         break;
+      }
+
+      x = x + (Jyy * fx - Jxy * fy) / determinant;
+      y = y + (Jxx * fy - Jyx * fx) / determinant;
+   }
+
+   if ((fabs(fx) + fabs(fy)) <= tol)
+   {
+      // The method converged to a root.
+      ux = x;
+      uy = y;
+   }
+   else
+   {
+      // The method did not converge to a root within the maximum
+      // number of iterations. Return with no distortion.
+      ux = dx;
+      uy = dy;
+   }
+}
+
+void UsgsAstroTaylorDistortion::jacobian(
+   double x, double y,
+   double &Jxx, double &Jxy, double &Jyx, double &Jyy) const
+{
+   double d_dx[10];
+   d_dx[0] = 0;
+   d_dx[1] = 1;
+   d_dx[2] = 0;
+   d_dx[3] = 2 * x;
+   d_dx[4] = y;
+   d_dx[5] = 0;
+   d_dx[6] = 3 * x * x;
+   d_dx[7] = 2 * x * y;
+   d_dx[8] = y * y;
+   d_dx[9] = 0;
+   double d_dy[10];
+   d_dy[0] = 0;
+   d_dy[1] = 0;
+   d_dy[2] = 1;
+   d_dy[3] = 0;
+   d_dy[4] = x;
+   d_dy[5] = 2 * y;
+   d_dy[6] = 0;
+   d_dy[7] = x * x;
+   d_dy[8] = 2 * x * y;
+   d_dy[9] = 3 * y * y;
+
+   Jxx = 0.0;
+   Jxy = 0.0;
+   Jyx = 0.0;
+   Jyy = 0.0;
+
+   for (int i = 0; i < 10; i++)
+   {
+      Jxx = Jxx + d_dx[i] * m_odtX[i];
+      Jxy = Jxy + d_dy[i] * m_odtX[i];
+      Jyx = Jyx + d_dx[i] * m_odtY[i];
+      Jyy = Jyy + d_dy[i] * m_odtY[i];
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroTransverseDistortion
+//*****************************************************************************
+UsgsAstroTransverseDistortion::UsgsAstroTransverseDistortion(
+   const std::vector<double> &coefficients)
+:
+   m_k(coefficient(coefficients, 0))
+{
+}
+
+void UsgsAstroTransverseDistortion::undistort(
+   double dx, double dy, double &ux, double &uy) const
+{
+   ux = dx;
+   uy = dy / (1.0 + m_k * dy * dy);
+}
+
+void UsgsAstroTransverseDistortion::undistort(
+   int           n,
+   const double *dx,
+   const double *dy,
+   double       *ux,
+   double       *uy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      ux[i] = dx[i];
+      uy[i] = dy[i] / (1.0 + m_k * dy[i] * dy[i]);
+   }
+}
+
+void UsgsAstroTransverseDistortion::distort(
+   double ux, double uy, double &dx, double &dy) const
+{
+   // uy = dy / (1 + k dy^2) is a quadratic in dy, take the root that is
+   // continuous with k = 0.
+   dx = ux;
+   dy = uy;
+   double discriminant = 1.0 - 4.0 * m_k * uy * uy;
+   if (discriminant >= 0.0)
+   {
+      dy = 2.0 * uy / (1.0 + sqrt(discriminant));
+   }
+}
+
+void UsgsAstroTransverseDistortion::distort(
+   int           n,
+   const double *ux,
+   const double *uy,
+   double       *dx,
+   double       *dy) const
+{
+   for (int i = 0; i < n; i++)
+   {
+      double discriminant = 1.0 - 4.0 * m_k * uy[i] * uy[i];
+      double root = sqrt(discriminant > 0.0 ? discriminant : 0.0);
+      dx[i] = ux[i];
+      dy[i] = discriminant >= 0.0 ? 2.0 * uy[i] / (1.0 + root) : uy[i];
+   }
+}
+
+void UsgsAstroTransverseDistortion::jacobian(
+   double ux, double uy,
+   double &Jxx, double &Jxy, double &Jyx, double &Jyy) const
+{
+   // Inverse of the derivative of undistort at the distorted coordinate
+   double dx, dy;
+   distort(ux, uy, dx, dy);
+   double denominator = 1.0 + m_k * dy * dy;
+   Jxx = 1.0;
+   Jxy = 0.0;
+   Jyx = 0.0;
+   Jyy = denominator * denominator / (1.0 - m_k * dy * dy);
+}
@@ -0,0 +1,159 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Epipolar curve of an image point in a second image, for the frame and
+//    line scanner sensor models.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroEpipolarCurve.h"
+#include "UsgsAstroGeodesy.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Height intervals before any refinement.
+static const int NUM_START_INTERVALS = 4;
+
+// Limit on the bisection depth, below a thousandth of a start interval.
+static const int MAX_DEPTH = 10;
+
+//*****************************************************************************
+// UsgsAstroEpipolarCurve Constructor
+//*****************************************************************************
+UsgsAstroEpipolarCurve::UsgsAstroEpipolarCurve(
+   const csm::EcefLocus &ray,
+   double                semiMajorAxis,
+   double                semiMinorAxis,
+   double                minHeight,
+   double                maxHeight,
+   double                tolerance,
+   const Projector      &project)
+:
+   m_Ray(&ray),
+   m_Project(&project),
+   m_SemiMajorAxis(semiMajorAxis),
+   m_SemiMinorAxis(semiMinorAxis),
+   m_Tolerance(tolerance),
+   m_ErrorBound(0.0),
+   m_NumProjections(0)
+{
+   Vertex start = evaluate(minHeight);
+   m_Vertices.push_back(start);
+   if (maxHeight > minHeight)
+   {
+      for (int i = 1; i <= NUM_START_INTERVALS; i++)
+      {
+         Vertex end = evaluate(
+            minHeight + i * (maxHeight - minHeight) / NUM_START_INTERVALS);
+         refine(start, end, 0);
+         m_Vertices.push_back(end);
+         start = end;
+      }
+   }
+   m_Ray = NULL;
+   m_Project = NULL;
+}
+
+//*****************************************************************************
+// UsgsAstroEpipolarCurve::interpolate
+//*****************************************************************************
+bool UsgsAstroEpipolarCurve::interpolate(
+   double           height,
+   csm::ImageCoord &imagePt) const
+{
+   if (m_Vertices.empty() ||
+       height < m_Vertices.front().height ||
+       height > m_Vertices.back().height)
+   {
+      return false;
+   }
+
+   size_t i = 0;
+   while (i + 2 < m_Vertices.size() && m_Vertices[i + 1].height < height)
+   {
+      i++;
+   }
+   const Vertex &a = m_Vertices[i];
+   if (m_Vertices.size() == 1)
+   {
+      imagePt = a.imagePt;
+      return a.valid;
+   }
+   const Vertex &b = m_Vertices[i + 1];
+   if (!a.valid || !b.valid)
+   {
+      return false;
+   }
+   double t = (height - a.height) / (b.height - a.height);
+   imagePt.line = a.imagePt.line + t * (b.imagePt.line - a.imagePt.line);
+   imagePt.samp = a.imagePt.samp + t * (b.imagePt.samp - a.imagePt.samp);
+   return true;
+}
+
+//*****************************************************************************
+// UsgsAstroEpipolarCurve::evaluate
+//*****************************************************************************
+UsgsAstroEpipolarCurve::Vertex UsgsAstroEpipolarCurve::evaluate(double height)
+{
+   Vertex vertex;
+   vertex.height = height;
+   vertex.valid = false;
+
+   UsgsAstroGeodesy geodesy(m_SemiMajorAxis, m_SemiMinorAxis);
+   csm::EcefCoord groundPt;
+   double achieved;
+   bool missed = false;
+   int steps = geodesy.intersect(
+      height, m_Ray->point.x, m_Ray->point.y, m_Ray->point.z,
+      m_Ray->direction.x, m_Ray->direction.y, m_Ray->direction.z,
+      groundPt.x, groundPt.y, groundPt.z, achieved, 0.001, &missed);
+   if (steps < 0 || missed)
+   {
+      return vertex;
+   }
+
+   m_NumProjections++;
+   vertex.valid = (*m_Project)(groundPt, vertex.imagePt);
+   return vertex;
+}
+
+//*****************************************************************************
+// UsgsAstroEpipolarCurve::refine
+//*****************************************************************************
+void UsgsAstroEpipolarCurve::refine(
+   const Vertex &start,
+   const Vertex &end,
+   int           depth)
+{
+   // Intervals with an end off the curve are left as they are
+   if (depth >= MAX_DEPTH || !start.valid || !end.valid)
+   {
+      return;
+   }
+
+   Vertex mid = evaluate((start.height + end.height) / 2.0);
+   if (mid.valid)
+   {
+      double dl = mid.imagePt.line
+                - (start.imagePt.line + end.imagePt.line) / 2.0;
+      double ds = mid.imagePt.samp
+                - (start.imagePt.samp + end.imagePt.samp) / 2.0;
+      double deviation = sqrt(dl * dl + ds * ds);
+
+      // At the depth limit the deviation is kept in the bound even though
+      // it is over the tolerance
+      if (deviation <= m_Tolerance || depth + 1 >= MAX_DEPTH)
+      {
+         m_ErrorBound = std::max(m_ErrorBound, deviation);
+         return;
+      }
+   }
+
+   // A middle vertex off the curve is kept, so that the interval is not
+   // interpolated across it
+   refine(start, mid, depth + 1);
+   m_Vertices.push_back(mid);
+   refine(mid, end, depth + 1);
+}
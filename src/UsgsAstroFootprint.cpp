@@ -0,0 +1,223 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Ground footprint polygon of an image, for the frame and line scanner
+//    sensor models.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroFootprint.h"
+#include "UsgsAstroGeodesy.h"
+
+#include <math.h>
+
+// Border segments per image edge before any refinement.  More than one
+// keeps a bend that is symmetric about the middle of an edge, which the
+// midpoint of a single chord would not see, from being missed.
+static const int NUM_START_SEGMENTS = 4;
+
+// Limit on the bisection depth, below a thousandth of a start segment.
+static const int MAX_DEPTH = 10;
+
+static const double RAD_TO_DEG = 180.0 / 3.14159265358979323846;
+
+//*****************************************************************************
+// UsgsAstroFootprint Constructor
+//*****************************************************************************
+UsgsAstroFootprint::UsgsAstroFootprint(
+   const std::pair<csm::ImageCoord, csm::ImageCoord> &imageRange,
+   double                                             semiMajorAxis,
+   double                                             semiMinorAxis,
+   double                                             minHeight,
+   double                                             maxHeight,
+   double                                             tolerance,
+   const Intersector                                 &intersect)
+:
+   m_Intersect(&intersect),
+   m_SemiMajorAxis(semiMajorAxis),
+   m_SemiMinorAxis(semiMinorAxis),
+   m_MinHeight(minHeight),
+   m_MaxHeight(maxHeight),
+   m_Tolerance(tolerance),
+   m_Center(0.0, 0.0, 0.0),
+   m_NumRays(0)
+{
+   double line0 = imageRange.first.line;
+   double samp0 = imageRange.first.samp;
+   double line1 = imageRange.second.line;
+   double samp1 = imageRange.second.samp;
+
+   // Where the ray of the center misses the surface the center stays at
+   // the body center, and the higher ground point is the outer one
+   if (m_MinHeight != m_MaxHeight)
+   {
+      csm::EcefCoord center;
+      if (intersect(
+             csm::ImageCoord((line0 + line1) / 2.0, (samp0 + samp1) / 2.0),
+             (m_MinHeight + m_MaxHeight) / 2.0, center))
+      {
+         m_Center = center;
+      }
+      m_NumRays++;
+   }
+
+   // Corners in order around the border
+   csm::ImageCoord corners[5] = {
+      csm::ImageCoord(line0, samp0),
+      csm::ImageCoord(line0, samp1),
+      csm::ImageCoord(line1, samp1),
+      csm::ImageCoord(line1, samp0),
+      csm::ImageCoord(line0, samp0) };
+
+   BorderPoint first = borderPoint(corners[0]);
+   BorderPoint start = first;
+   for (int edge = 0; edge < 4; edge++)
+   {
+      for (int i = 1; i <= NUM_START_SEGMENTS; i++)
+      {
+         double t = double(i) / NUM_START_SEGMENTS;
+         BorderPoint end = (edge == 3 && i == NUM_START_SEGMENTS)
+            ? first
+            : borderPoint(csm::ImageCoord(
+                 corners[edge].line
+                    + t * (corners[edge + 1].line - corners[edge].line),
+                 corners[edge].samp
+                    + t * (corners[edge + 1].samp - corners[edge].samp)));
+
+         if (start.hit)
+         {
+            m_Polygon.push_back(start.ground);
+         }
+         refine(start, end, 0);
+         start = end;
+      }
+   }
+   if (!m_Polygon.empty())
+   {
+      m_Polygon.push_back(m_Polygon.front());
+   }
+   m_Intersect = NULL;
+}
+
+//*****************************************************************************
+// UsgsAstroFootprint::getLatLonPolygon
+//*****************************************************************************
+std::vector<double> UsgsAstroFootprint::getLatLonPolygon() const
+{
+   UsgsAstroGeodesy geodesy(m_SemiMajorAxis, m_SemiMinorAxis);
+   std::vector<double> latLon;
+   latLon.reserve(2 * m_Polygon.size());
+   for (size_t i = 0; i < m_Polygon.size(); i++)
+   {
+      const csm::EcefCoord &p = m_Polygon[i];
+      double latitude, height;
+      if (!geodesy.toGeodetic(p.x, p.y, p.z, latitude, height))
+      {
+         // Close to the center only the geocentric latitude is defined
+         latitude = atan2(p.z, sqrt(p.x * p.x + p.y * p.y));
+      }
+      latLon.push_back(latitude * RAD_TO_DEG);
+      latLon.push_back(atan2(p.y, p.x) * RAD_TO_DEG);
+   }
+   return latLon;
+}
+
+//*****************************************************************************
+// UsgsAstroFootprint::borderPoint
+//*****************************************************************************
+UsgsAstroFootprint::BorderPoint UsgsAstroFootprint::borderPoint(
+   const csm::ImageCoord &imagePt)
+{
+   BorderPoint point;
+   point.imagePt = imagePt;
+   point.hit = (*m_Intersect)(imagePt, m_MinHeight, point.ground);
+   m_NumRays++;
+   if (m_MinHeight == m_MaxHeight)
+   {
+      return point;
+   }
+
+   csm::EcefCoord high;
+   bool highHit = (*m_Intersect)(imagePt, m_MaxHeight, high);
+   m_NumRays++;
+   if (!point.hit || !highHit)
+   {
+      // The larger ellipsoid may catch a ray that misses the smaller
+      if (highHit)
+      {
+         point.ground = high;
+         point.hit = true;
+      }
+      return point;
+   }
+
+   const csm::EcefCoord &low = point.ground;
+   double dxl = low.x - m_Center.x;
+   double dyl = low.y - m_Center.y;
+   double dzl = low.z - m_Center.z;
+   double dxh = high.x - m_Center.x;
+   double dyh = high.y - m_Center.y;
+   double dzh = high.z - m_Center.z;
+   if (dxl * dxl + dyl * dyl + dzl * dzl < dxh * dxh + dyh * dyh + dzh * dzh)
+   {
+      point.ground = high;
+   }
+   return point;
+}
+
+//*****************************************************************************
+// UsgsAstroFootprint::refine
+//*****************************************************************************
+void UsgsAstroFootprint::refine(
+   const BorderPoint &start,
+   const BorderPoint &end,
+   int                depth)
+{
+   if (depth >= MAX_DEPTH)
+   {
+      return;
+   }
+
+   BorderPoint mid = borderPoint(csm::ImageCoord(
+      (start.imagePt.line + end.imagePt.line) / 2.0,
+      (start.imagePt.samp + end.imagePt.samp) / 2.0));
+
+   if (start.hit && mid.hit && end.hit)
+   {
+      // Departure of the ground border from the chord at the midpoint,
+      // across the local vertical.  The chord also passes below the
+      // surface, which only matters to a polygon drawn through the body.
+      const csm::EcefCoord &s = start.ground;
+      const csm::EcefCoord &m = mid.ground;
+      const csm::EcefCoord &e = end.ground;
+      double dx = m.x - (s.x + e.x) / 2.0;
+      double dy = m.y - (s.y + e.y) / 2.0;
+      double dz = m.z - (s.z + e.z) / 2.0;
+      double rr = m.x * m.x + m.y * m.y + m.z * m.z;
+      if (rr > 0.0)
+      {
+         double up = (dx * m.x + dy * m.y + dz * m.z) / rr;
+         dx -= up * m.x;
+         dy -= up * m.y;
+         dz -= up * m.z;
+      }
+      if (dx * dx + dy * dy + dz * dz <= m_Tolerance * m_Tolerance)
+      {
+         return;
+      }
+   }
+   else if (!start.hit && !mid.hit && !end.hit)
+   {
+      // A stretch of border off the surface at both ends and the middle
+      // is taken to stay off it
+      return;
+   }
+
+   refine(start, mid, depth + 1);
+   if (mid.hit)
+   {
+      m_Polygon.push_back(mid.ground);
+   }
+   refine(mid, end, depth + 1);
+}
@@ -273,6 +273,8 @@ csm::Model *UsgsAstroFramePlugin::constructModelFromState(const std::string& mod
     mdsensor_model->m_currentParameterCovariance = state["m_currentParameterCovariance"].get<std::vector<double>>();
 
 
+    mdsensor_model->updateCachedState();
+
 sensor_model = mdsensor_model;
 return sensor_model;
 }
@@ -411,6 +413,8 @@ csm::Model *UsgsAstroFramePlugin::constructModelFromISD(const csm::Isd &imageSup
                      "UsgsAstroFramePlugin::constructModelFromISD");
   }
 
+  sensorModel->updateCachedState();
+
   return sensorModel;
 }
 
@@ -1,5 +1,8 @@
 #include "UsgsAstroFrameSensorModel.h"
+#include "UsgsAstroTriangulation.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -16,6 +19,8 @@ using namespace std;
 const std::string UsgsAstroFrameSensorModel::_SENSOR_MODEL_NAME
                                       = "USGS_ASTRO_FRAME_SENSOR_MODEL";
 const int UsgsAstroFrameSensorModel::m_numParameters = 6;
+const int UsgsAstroFrameSensorModel::MAX_RAY_GRID_NODES = 65536;
+const double UsgsAstroFrameSensorModel::MAX_RAY_GRID_ERROR = 1.0e-4;
 const std::string UsgsAstroFrameSensorModel::m_parameterName[] = {
   "X Sensor Position (m)",  // 0
   "Y Sensor Position (m)",  // 1
@@ -137,6 +142,10 @@ UsgsAstroFrameSensorModel::UsgsAstroFrameSensorModel() {
 
   m_parameterType.assign(m_numParameters, csm::param::REAL);
 
+  m_useRayGrid = true;
+  m_batchKernel = BATCH_KERNEL_AUTO;
+
+  updateCachedState();
 }
 
 
@@ -186,8 +195,7 @@ csm::ImageCoord UsgsAstroFrameSensorModel::groundToImage(
   double yo = y - getValue(1,adjustments);
   double zo = z - getValue(2,adjustments);
 
-  double f;
-  f = atof(m_focal_length_model[1].c_str());
+  double f = m_focalLength;
 
   // Camera rotation matrix
   double m[3][3];
@@ -213,6 +221,46 @@ csm::ImageCoord UsgsAstroFrameSensorModel::groundToImage(
 }
 
 
+bool UsgsAstroFrameSensorModel::isPossiblyVisible(const csm::EcefCoord &groundPt) const {
+  double xo = groundPt.x - m_currentParameterValue[0];
+  double yo = groundPt.y - m_currentParameterValue[1];
+  double zo = groundPt.z - m_currentParameterValue[2];
+  if (m_rotationMatrix[0][2] * xo + m_rotationMatrix[1][2] * yo + m_rotationMatrix[2][2] * zo <= 0.0) {
+    return false;
+  }
+
+  csm::ImageCoord imagePt = groundToImage(groundPt);
+  std::pair<csm::ImageCoord, csm::ImageCoord> range = getValidImageRange();
+  return imagePt.line >= range.first.line && imagePt.line <= range.second.line &&
+         imagePt.samp >= range.first.samp && imagePt.samp <= range.second.samp;
+}
+
+
+UsgsAstroFootprint UsgsAstroFrameSensorModel::computeFootprint(
+    double minHeight, double maxHeight, double tolerance) const {
+  UsgsAstroFootprint::Intersector intersect =
+      [this](const csm::ImageCoord &imagePt, double height,
+             csm::EcefCoord &groundPt) {
+    double xl, yl, zl;
+    imageToLook(imagePt, xl, yl, zl);
+    return losEllipsoidIntersect(height, m_currentParameterValue[0],
+                                 m_currentParameterValue[1],
+                                 m_currentParameterValue[2], xl, yl, zl,
+                                 groundPt.x, groundPt.y, groundPt.z);
+  };
+  return UsgsAstroFootprint(getValidImageRange(), atof(m_radii[0].c_str()),
+                            atof(m_radii[1].c_str()), minHeight, maxHeight,
+                            tolerance, intersect);
+}
+
+
+UsgsAstroRpcModel UsgsAstroFrameSensorModel::computeRpcModel(int gridSize,
+                                                             int numHeights) const {
+  return UsgsAstroRpcModel(*this, atof(m_radii[0].c_str()), atof(m_radii[1].c_str()),
+                           gridSize, numHeights);
+}
+
+
 csm::ImageCoordCovar UsgsAstroFrameSensorModel::groundToImage(const csm::EcefCoordCovar &groundPt,
                                    double desiredPrecision,
                                    double *achievedPrecision,
@@ -224,12 +272,236 @@ csm::ImageCoordCovar UsgsAstroFrameSensorModel::groundToImage(const csm::EcefCoo
 }
 
 
+namespace {
+
+// The constants of the collinearity equations without adjustments,
+// gathered once per batch so that the kernels hold them in registers.
+struct FrameProjection {
+  double px, py, pz;          // sensor position
+  double mx[3], my[3], mz[3]; // rotation matrix columns
+  double f, samplePp, linePp;
+};
+
+// Points projected per pass, so that the focal plane coordinates handed
+// from the kernel to the distortion model stay on the stack and in cache.
+const int FRAME_BATCH_CHUNK = 256;
+
+// GCC and Clang vector types let one template serve the scalar and vector
+// widths, with the scalar constants broadcast across the lanes. The
+// kernels using them are compiled for their instruction set through the
+// target attribute and chosen with __builtin_cpu_supports.
+#if (defined(__GNUC__) && __GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define FRAME_PROJECTION_DISPATCH
+#define FRAME_PROJECTION_INLINE inline __attribute__((always_inline))
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+#else
+#define FRAME_PROJECTION_INLINE inline
+#endif
+
+/**
+ * @description Computes the undistorted focal plane coordinates of points
+ * from begin in whole blocks of V, which is double or a vector of doubles,
+ * in the same order of operations as groundToImage.
+ *
+ * @return The index of the first point not projected.
+ */
+template <typename V>
+FRAME_PROJECTION_INLINE int projectFramePoints(
+    const FrameProjection &p, int begin, int n,
+    const double *x, const double *y, const double *z,
+    double *undistortedX, double *undistortedY) {
+  const int width = sizeof(V) / sizeof(double);
+  int i = begin;
+  for (; i + width <= n; i += width) {
+    V xo, yo, zo;
+    memcpy(&xo, x + i, sizeof(V));
+    memcpy(&yo, y + i, sizeof(V));
+    memcpy(&zo, z + i, sizeof(V));
+    xo = xo - p.px;
+    yo = yo - p.py;
+    zo = zo - p.pz;
+
+    V denom = p.mz[0] * xo + p.mz[1] * yo + p.mz[2] * zo;
+    V ux = (p.f * (p.mx[0] * xo + p.mx[1] * yo + p.mx[2] * zo) / denom) + p.samplePp;
+    V uy = (p.f * (p.my[0] * xo + p.my[1] * yo + p.my[2] * zo) / denom) + p.linePp;
+    memcpy(undistortedX + i, &ux, sizeof(V));
+    memcpy(undistortedY + i, &uy, sizeof(V));
+  }
+  return i;
+}
+
+typedef void (*FrameProjectionKernel)(
+    const FrameProjection &p, int n,
+    const double *x, const double *y, const double *z,
+    double *undistortedX, double *undistortedY);
+
+void projectFrameScalar(
+    const FrameProjection &p, int n,
+    const double *x, const double *y, const double *z,
+    double *undistortedX, double *undistortedY) {
+  projectFramePoints<double>(p, 0, n, x, y, z, undistortedX, undistortedY);
+}
+
+#ifdef FRAME_PROJECTION_DISPATCH
+__attribute__((target("avx2")))
+void projectFrameAvx2(
+    const FrameProjection &p, int n,
+    const double *x, const double *y, const double *z,
+    double *undistortedX, double *undistortedY) {
+  int i = projectFramePoints<Double4>(p, 0, n, x, y, z, undistortedX, undistortedY);
+  projectFramePoints<double>(p, i, n, x, y, z, undistortedX, undistortedY);
+}
+
+__attribute__((target("avx512f")))
+void projectFrameAvx512(
+    const FrameProjection &p, int n,
+    const double *x, const double *y, const double *z,
+    double *undistortedX, double *undistortedY) {
+  int i = projectFramePoints<Double8>(p, 0, n, x, y, z, undistortedX, undistortedY);
+  projectFramePoints<double>(p, i, n, x, y, z, undistortedX, undistortedY);
+}
+#endif
+
+/**
+ * @description Returns the kernel for an instruction set, or NULL if the
+ * compiler or the processor does not support it. BATCH_KERNEL_AUTO
+ * returns the widest supported kernel.
+ */
+FrameProjectionKernel frameProjectionKernel(
+    UsgsAstroFrameSensorModel::BatchKernel kernel) {
+#ifdef FRAME_PROJECTION_DISPATCH
+  __builtin_cpu_init();
+  bool avx512 = __builtin_cpu_supports("avx512f");
+  bool avx2 = __builtin_cpu_supports("avx2");
+  switch (kernel) {
+    case UsgsAstroFrameSensorModel::BATCH_KERNEL_AUTO:
+      return avx512 ? projectFrameAvx512
+           : avx2 ? projectFrameAvx2 : projectFrameScalar;
+    case UsgsAstroFrameSensorModel::BATCH_KERNEL_AVX2:
+      return avx2 ? projectFrameAvx2 : NULL;
+    case UsgsAstroFrameSensorModel::BATCH_KERNEL_AVX512:
+      return avx512 ? projectFrameAvx512 : NULL;
+    default:
+      return projectFrameScalar;
+  }
+#else
+  switch (kernel) {
+    case UsgsAstroFrameSensorModel::BATCH_KERNEL_AUTO:
+    case UsgsAstroFrameSensorModel::BATCH_KERNEL_SCALAR:
+      return projectFrameScalar;
+    default:
+      return NULL;
+  }
+#endif
+}
+
+}
+
+
+bool UsgsAstroFrameSensorModel::setBatchKernel(BatchKernel kernel) {
+  if (!frameProjectionKernel(kernel)) {
+    return false;
+  }
+  m_batchKernel = kernel;
+  return true;
+}
+
+
+void UsgsAstroFrameSensorModel::groundToImage(
+    int n, const double *x, const double *y, const double *z,
+    double *line, double *sample) const {
+  static const FrameProjectionKernel autoKernel =
+      frameProjectionKernel(BATCH_KERNEL_AUTO);
+  const FrameProjectionKernel kernel = m_batchKernel == BATCH_KERNEL_AUTO ?
+      autoKernel : frameProjectionKernel(m_batchKernel);
+
+  FrameProjection p;
+  p.px = m_currentParameterValue[0];
+  p.py = m_currentParameterValue[1];
+  p.pz = m_currentParameterValue[2];
+  for (int k = 0; k < 3; k++) {
+    p.mx[k] = m_rotationMatrix[k][0];
+    p.my[k] = m_rotationMatrix[k][1];
+    p.mz[k] = m_rotationMatrix[k][2];
+  }
+  p.f = m_focalLength;
+  p.samplePp = m_sample_pp;
+  p.linePp = m_line_pp;
+
+  double undistortedX[FRAME_BATCH_CHUNK], undistortedY[FRAME_BATCH_CHUNK];
+  double distortedX[FRAME_BATCH_CHUNK], distortedY[FRAME_BATCH_CHUNK];
+  for (int begin = 0; begin < n; begin += FRAME_BATCH_CHUNK) {
+    int count = std::min(FRAME_BATCH_CHUNK, n - begin);
+    kernel(p, count, x + begin, y + begin, z + begin,
+           undistortedX, undistortedY);
+    m_distortion->distort(count, undistortedX, undistortedY,
+                          distortedX, distortedY);
+
+    // As groundToImage, which offsets the line by the sample center too
+    for (int i = 0; i < count; i++) {
+      sample[begin + i] = m_iTransS[0] + m_iTransS[1] * distortedX[i]
+                        + m_iTransS[2] * distortedX[i] + m_ccdCenter[0] - 0.5;
+      line[begin + i] = m_iTransL[0] + m_iTransL[1] * distortedY[i]
+                      + m_iTransL[2] * distortedY[i] + m_ccdCenter[0] - 0.5;
+    }
+  }
+}
+
+
 csm::EcefCoord UsgsAstroFrameSensorModel::imageToGround(const csm::ImageCoord &imagePt,
                                                  double height,
                                                  double desiredPrecision,
                                                  double *achievedPrecision,
                                                  csm::WarningList *warnings) const {
 
+  double xl, yl, zl;
+  imageToLook(imagePt, xl, yl, zl);
+
+  double x, y, z;
+  double xc, yc, zc;
+  xc = m_currentParameterValue[0];
+  yc = m_currentParameterValue[1];
+  zc = m_currentParameterValue[2];
+
+  // Intersect with some height about the ellipsoid.
+  losEllipsoidIntersect(height, xc, yc, zc, xl, yl, zl, x, y, z);
+
+  return csm::EcefCoord(x, y, z);
+}
+
+
+csm::EcefLocus UsgsAstroFrameSensorModel::imageToRay(const csm::ImageCoord &imagePt) const {
+  double xl, yl, zl;
+  imageToLook(imagePt, xl, yl, zl);
+  double mag = sqrt(xl * xl + yl * yl + zl * zl);
+  return csm::EcefLocus(m_currentParameterValue[0], m_currentParameterValue[1],
+                        m_currentParameterValue[2], xl / mag, yl / mag, zl / mag);
+}
+
+
+UsgsAstroEpipolarCurve UsgsAstroFrameSensorModel::computeEpipolarCurve(
+    const csm::RasterGM &otherModel, const csm::ImageCoord &otherPt,
+    double minHeight, double maxHeight, double tolerance) const {
+  csm::EcefLocus ray = UsgsAstroTriangulation::getRay(otherModel, otherPt);
+  UsgsAstroEpipolarCurve::Projector project =
+      [this](const csm::EcefCoord &groundPt, csm::ImageCoord &imagePt) {
+    try {
+      imagePt = groundToImage(groundPt);
+    }
+    catch (csm::Error &) {
+      return false;
+    }
+    return true;
+  };
+  return UsgsAstroEpipolarCurve(ray, atof(m_radii[0].c_str()), atof(m_radii[1].c_str()),
+                                minHeight, maxHeight, tolerance, project);
+}
+
+
+void UsgsAstroFrameSensorModel::imageToLook(const csm::ImageCoord &imagePt,
+                                            double &xl, double &yl, double &zl) const {
   double sample = imagePt.samp;
   double line = imagePt.line;
 
@@ -238,7 +510,7 @@ csm::EcefCoord UsgsAstroFrameSensorModel::imageToGround(const csm::ImageCoord &i
   calcRotationMatrix(m);
 
   //Apply the principal point offset, assuming the pp is given in pixels
-  double xl, yl, zl, lo, so;
+  double lo, so;
   lo = line - m_line_pp;
   so = sample - m_sample_pp;
 
@@ -251,27 +523,16 @@ csm::EcefCoord UsgsAstroFrameSensorModel::imageToGround(const csm::ImageCoord &i
 
   // Apply the distortion model (remove distortion)
   double undistorted_cameraX, undistorted_cameraY = 0.0;
-  setFocalPlane(x_camera, y_camera, undistorted_cameraX, undistorted_cameraY);
+  undistortFocalPlane(x_camera, y_camera, undistorted_cameraX, undistorted_cameraY);
 
   //Now back from distorted mm to pixels
   double udx, udy; //distorted line and sample
   udx = undistorted_cameraX;
   udy = undistorted_cameraY;
 
-  xl = m[0][0] * udx + m[0][1] * udy - m[0][2] * -atof(m_focal_length_model[1].c_str());
-  yl = m[1][0] * udx + m[1][1] * udy - m[1][2] * -atof(m_focal_length_model[1].c_str());
-  zl = m[2][0] * udx + m[2][1] * udy - m[2][2] * -atof(m_focal_length_model[1].c_str());
-
-  double x, y, z;
-  double xc, yc, zc;
-  xc = m_currentParameterValue[0];
-  yc = m_currentParameterValue[1];
-  zc = m_currentParameterValue[2];
-
-  // Intersect with some height about the ellipsoid.
-  losEllipsoidIntersect(height, xc, yc, zc, xl, yl, zl, x, y, z);
-
-  return csm::EcefCoord(x, y, z);
+  xl = m[0][0] * udx + m[0][1] * udy - m[0][2] * -m_focalLength;
+  yl = m[1][0] * udx + m[1][1] * udy - m[1][2] * -m_focalLength;
+  zl = m[2][0] * udx + m[2][1] * udy - m[2][2] * -m_focalLength;
 }
 
 
@@ -310,12 +571,12 @@ csm::EcefLocus UsgsAstroFrameSensorModel::imageToRemoteImagingLocus(const csm::I
   double undistortedFocalPlaneX = focalPlaneX;
   double undistortedFocalPlaneY = focalPlaneY;
 
-  setFocalPlane(focalPlaneX, focalPlaneY, undistortedFocalPlaneX, undistortedFocalPlaneY);
+  undistortFocalPlane(focalPlaneX, focalPlaneY, undistortedFocalPlaneX, undistortedFocalPlaneY);
 
   // Get rotation matrix and transform to a body-fixed frame
   double m[3][3];
   calcRotationMatrix(m);
-  std::vector<double> lookC { undistortedFocalPlaneX, undistortedFocalPlaneY, atof(m_focal_length_model[1].c_str()) };
+  std::vector<double> lookC { undistortedFocalPlaneX, undistortedFocalPlaneY, m_focalLength };
   std::vector<double> lookB {
     m[0][0] * lookC[0] + m[0][1] * lookC[1] + m[0][2] * lookC[2],
     m[1][0] * lookC[0] + m[1][1] * lookC[1] + m[1][2] * lookC[2],
@@ -567,7 +828,7 @@ std::vector<double> UsgsAstroFrameSensorModel::computeGroundPartials(const csm::
     w = m[2][0] * xo + m[2][1] * yo + m[2][2] * zo;
 
     double fdw, udw, vdw;
-    fdw = atof(m_focal_length_model[1].c_str()) / w;
+    fdw = m_focalLength / w;
     udw = u / w;
     vdw = v / w;
 
@@ -783,6 +1044,7 @@ void UsgsAstroFrameSensorModel::replaceModelState(const std::string& modelState)
 
         m_currentParameterCovariance = state["m_currentParameterCovariance"].get<std::vector<double>>();
     }
+    updateCachedState();
 }
 
 
@@ -853,6 +1115,32 @@ double UsgsAstroFrameSensorModel::getParameterValue(int index) const {
 
 void UsgsAstroFrameSensorModel::setParameterValue(int index, double value) {
   m_currentParameterValue[index] = value;
+  if (index >= 3) {
+    updateRotationMatrix();
+  }
+}
+
+
+void UsgsAstroFrameSensorModel::applyParameterDeltas(const std::vector<double> &deltas) {
+  if (deltas.size() != (size_t)m_numParameters) {
+    throw csm::Error(csm::Error::INDEX_OUT_OF_RANGE,
+                     "Expected one delta per adjustable parameter",
+                     "UsgsAstroFrameSensorModel::applyParameterDeltas");
+  }
+
+  bool rotationChanged = false;
+  for (int i = 0; i < m_numParameters; i++) {
+    m_currentParameterValue[i] += deltas[i];
+    if (i >= 3 && deltas[i] != 0.0) {
+      rotationChanged = true;
+    }
+  }
+
+  // The sensor position is read directly from the parameters, so only the
+  // rotation matrix needs to be refreshed.
+  if (rotationChanged) {
+    updateRotationMatrix();
+  }
 }
 
 
@@ -923,31 +1211,23 @@ std::vector<double> UsgsAstroFrameSensorModel::getCrossCovarianceMatrix(
 void UsgsAstroFrameSensorModel::calcRotationMatrix(
     double m[3][3]) const {
 
-  // Trigonometric functions for rotation matrix
-  double sinw = std::sin(m_currentParameterValue[3]);
-  double cosw = std::cos(m_currentParameterValue[3]);
-  double sinp = std::sin(m_currentParameterValue[4]);
-  double cosp = std::cos(m_currentParameterValue[4]);
-  double sink = std::sin(m_currentParameterValue[5]);
-  double cosk = std::cos(m_currentParameterValue[5]);
-
-  // Rotation matrix taken from Introduction to Mordern Photogrammetry by
-  // Edward M. Mikhail, et al., p. 373
-  m[0][0] = cosp * cosk;
-  m[0][1] = cosw * sink + sinw * sinp * cosk;
-  m[0][2] = sinw * sink - cosw * sinp * cosk;
-  m[1][0] = -1 * cosp * sink;
-  m[1][1] = cosw * cosk - sinw * sinp * sink;
-  m[1][2] = sinw * cosk + cosw * sinp * sink;
-  m[2][0] = sinp;
-  m[2][1] = -1 * sinw * cosp;
-  m[2][2] = cosw * cosp;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] = m_rotationMatrix[i][j];
+    }
+  }
 }
 
 
 void UsgsAstroFrameSensorModel::calcRotationMatrix(
   double m[3][3], const std::vector<double> &adjustments) const {
 
+  // Without angular adjustments the cached matrix applies
+  if (adjustments[3] == 0.0 && adjustments[4] == 0.0 && adjustments[5] == 0.0) {
+    calcRotationMatrix(m);
+    return;
+  }
+
   // Trigonometric functions for rotation matrix
   double sinw = std::sin(getValue(3,adjustments));
   double cosw = std::cos(getValue(3,adjustments));
@@ -968,7 +1248,7 @@ void UsgsAstroFrameSensorModel::calcRotationMatrix(
 }
 
 
-void UsgsAstroFrameSensorModel::losEllipsoidIntersect(
+bool UsgsAstroFrameSensorModel::losEllipsoidIntersect(
       const double height,
       const double xc,
       const double yc,
@@ -1003,7 +1283,8 @@ void UsgsAstroFrameSensorModel::losEllipsoidIntersect(
    // zero means solving for a point on the ray nearest
    // the surface of the ellisoid.
 
-   if ( 0.0 > quadTerm )
+   bool hit = quadTerm >= 0.0;
+   if ( !hit )
    {
       quadTerm = 0.0;
    }
@@ -1014,6 +1295,8 @@ void UsgsAstroFrameSensorModel::losEllipsoidIntersect(
    x = xc + scale * xl;
    y = yc + scale * yl;
    z = zc + scale * zl;
+
+   return hit;
 }
 
 
@@ -1040,66 +1323,10 @@ bool UsgsAstroFrameSensorModel::setFocalPlane(double dx,double dy,
                                        double &undistortedX,
                                        double &undistortedY ) const {
 
-
-  // Solve the distortion equation using the Newton-Raphson method.
-  // Set the error tolerance to about one millionth of a NAC pixel.
-  const double tol = 1.4E-5;
-
-  // The maximum number of iterations of the Newton-Raphson method.
-  const int maxTries = 60;
-
-  double x;
-  double y;
-  double fx;
-  double fy;
-  double Jxx;
-  double Jxy;
-  double Jyx;
-  double Jyy;
-
-  // Initial guess at the root
-  x = dx;
-  y = dy;
-
-  distortionFunction(x, y, fx, fy);
-
-  for (int count = 1; ((fabs(fx) + fabs(fy)) > tol) && (count < maxTries); count++) {
-
-    this->distortionFunction(x, y, fx, fy);
-
-    fx = dx - fx;
-    fy = dy - fy;
-
-    distortionJacobian(x, y, Jxx, Jxy, Jyx, Jyy);
-
-    double determinant = Jxx * Jyy - Jxy * Jyx;
-    if (determinant < 1E-6) {
-      //
-      // Near-zero determinant. Add error handling here.
-      //
-      //-- Just break out and return with no convergence
-      break;
-    }
-
-    x = x + (Jyy * fx - Jxy * fy) / determinant;
-    y = y + (Jxx * fy - Jyx * fx) / determinant;
-  }
-
-  if ( (fabs(fx) + fabs(fy)) <= tol) {
-    // The method converged to a root.
-    undistortedX = x;
-    undistortedY = y;
-
-  }
-  else {
-    // The method did not converge to a root within the maximum
-    // number of iterations. Return with no distortion.
-    undistortedX = dx;
-    undistortedY = dy;
-  }
-
+  // The Taylor model solves the distortion equation using the Newton-Raphson
+  // method and returns with no distortion if it does not converge.
+  m_distortion->undistort(dx, dy, undistortedX, undistortedY);
   return true;
-
 }
 
 
@@ -1117,47 +1344,10 @@ bool UsgsAstroFrameSensorModel::setFocalPlane(double dx,double dy,
  */
 void UsgsAstroFrameSensorModel::distortionJacobian(double x, double y, double &Jxx, double &Jxy,
                                             double &Jyx, double &Jyy) const {
-
-  double d_dx[10];
-  d_dx[0] = 0;
-  d_dx[1] = 1;
-  d_dx[2] = 0;
-  d_dx[3] = 2 * x;
-  d_dx[4] = y;
-  d_dx[5] = 0;
-  d_dx[6] = 3 * x * x;
-  d_dx[7] = 2 * x * y;
-  d_dx[8] = y * y;
-  d_dx[9] = 0;
-  double d_dy[10];
-  d_dy[0] = 0;
-  d_dy[1] = 0;
-  d_dy[2] = 1;
-  d_dy[3] = 0;
-  d_dy[4] = x;
-  d_dy[5] = 2 * y;
-  d_dy[6] = 0;
-  d_dy[7] = x * x;
-  d_dy[8] = 2 * x * y;
-  d_dy[9] = 3 * y * y;
-
-  Jxx = 0.0;
-  Jxy = 0.0;
-  Jyx = 0.0;
-  Jyy = 0.0;
-
-  for (int i = 0; i < 10; i++) {
-    Jxx = Jxx + d_dx[i] * m_odtX[i];
-    Jxy = Jxy + d_dy[i] * m_odtX[i];
-    Jyx = Jyx + d_dx[i] * m_odtY[i];
-    Jyy = Jyy + d_dy[i] * m_odtY[i];
-  }
-
-
+  m_distortion->jacobian(x, y, Jxx, Jxy, Jyx, Jyy);
 }
 
 
-
 /**
  * @description Compute distorted focal plane (dx,dy) coordinate  given an undistorted focal
  * plane (ux,uy) coordinate. This describes the third order Taylor approximation to the
@@ -1169,25 +1359,7 @@ void UsgsAstroFrameSensorModel::distortionJacobian(double x, double y, double &J
  * @param dy Result distorted y
  */
 void UsgsAstroFrameSensorModel::distortionFunction(double ux, double uy, double &dx, double &dy) const {
-
-  double f[10];
-  f[0] = 1;
-  f[1] = ux;
-  f[2] = uy;
-  f[3] = ux * ux;
-  f[4] = ux * uy;
-  f[5] = uy * uy;
-  f[6] = ux * ux * ux;
-  f[7] = ux * ux * uy;
-  f[8] = ux * uy * uy;
-  f[9] = uy * uy * uy;
-
-  dx = 0.0;
-  dy = 0.0;
-  for (int i = 0; i < 10; i++) {
-    dx = dx + f[i] * m_odtX[i];
-    dy = dy + f[i] * m_odtY[i];
-  }
+  m_distortion->distort(ux, uy, dx, dy);
 }
 
 /***** Helper Functions *****/
@@ -1198,3 +1370,251 @@ double UsgsAstroFrameSensorModel::getValue(
 {
    return m_currentParameterValue[index] + adjustments[index];
 }
+
+
+/**
+ * @description Binds the Taylor distortion model to the current m_odtX and
+ * m_odtY coefficients.
+ */
+void UsgsAstroFrameSensorModel::updateDistortion() {
+  std::vector<double> coefficients(m_odtX);
+  coefficients.resize(10, 0.0);
+  coefficients.insert(coefficients.end(), m_odtY.begin(), m_odtY.end());
+  m_distortion = UsgsAstroDistortion::create("TAYLOR", coefficients);
+}
+
+
+/**
+ * @description Refreshes the quantities derived from the state: the focal
+ * length, the distortion model and the rotation matrix. Drops the ray grid,
+ * which is rebuilt from the new interior orientation on first use. Call
+ * after the state is set directly.
+ */
+void UsgsAstroFrameSensorModel::updateCachedState() {
+  m_focalLength = atof(m_focal_length_model[1].c_str());
+  updateDistortion();
+  updateRotationMatrix();
+  std::atomic_store(&m_rayGrid, std::shared_ptr<const RayGrid>());
+}
+
+
+double UsgsAstroFrameSensorModel::getRayGridError() const {
+  std::shared_ptr<const RayGrid> grid = getRayGrid();
+  return grid ? grid->error : 0.0;
+}
+
+
+/**
+ * @description Returns the ray grid, building it on first use. Two threads
+ * may both build it; the last one stored wins and the grids are identical.
+ */
+std::shared_ptr<const UsgsAstroFrameSensorModel::RayGrid>
+UsgsAstroFrameSensorModel::getRayGrid() const {
+  std::shared_ptr<const RayGrid> grid = std::atomic_load(&m_rayGrid);
+  if (!grid) {
+    grid = buildRayGrid();
+    std::atomic_store(&m_rayGrid, grid);
+  }
+  return grid;
+}
+
+
+/**
+ * @description Builds the ray grid over the distorted focal plane
+ * coordinates reached by the pixels of the image, with one node of margin
+ * beyond them on every side. The node spacing is at least 8 pixels and is
+ * widened to keep the grid to about MAX_RAY_GRID_NODES nodes. The
+ * interpolation error is measured at the center of every cell, and while
+ * it is over MAX_RAY_GRID_ERROR pixels the spacing is halved, down to one
+ * pixel and up to 16 times as many nodes.
+ *
+ * @return The grid, or an empty grid if the image or focal plane
+ *         transformation is degenerate or the distortion is too strong for
+ *         the densest grid, in which case the undistortion is computed
+ *         directly.
+ */
+std::shared_ptr<const UsgsAstroFrameSensorModel::RayGrid>
+UsgsAstroFrameSensorModel::buildRayGrid() const {
+  std::shared_ptr<RayGrid> grid = std::make_shared<RayGrid>();
+  grid->nx = 0;
+  grid->ny = 0;
+  grid->error = 0.0;
+
+  // The focal plane x depends only on the sample and y only on the line
+  double scaleX = fabs(m_transX[1] + m_transX[2]);
+  double scaleY = fabs(m_transY[1] + m_transY[2]);
+  if (m_image_lines <= 0 || m_image_samples <= 0 ||
+      scaleX == 0.0 || scaleY == 0.0) {
+    return grid;
+  }
+
+  // imageToGround offsets the pixels by the principal point and
+  // imageToRemoteImagingLocus does not, so cover both.
+  double minX = 1.0e300, maxX = -1.0e300, minY = 1.0e300, maxY = -1.0e300;
+  for (int end = 0; end < 2; end++) {
+    for (int pp = 0; pp < 2; pp++) {
+      double col = end * m_image_samples - pp * m_sample_pp - (m_ccdCenter[0] - 0.5);
+      double row = end * m_image_lines - pp * m_line_pp - (m_ccdCenter[1] - 0.5);
+      double x = m_transX[0] + m_transX[1] * col + m_transX[2] * col;
+      double y = m_transY[0] + m_transY[1] * row + m_transY[2] * row;
+      minX = std::min(minX, x);
+      maxX = std::max(maxX, x);
+      minY = std::min(minY, y);
+      maxY = std::max(maxY, y);
+    }
+  }
+
+  double spacing = std::max(8.0, std::ceil(std::sqrt(
+      double(m_image_lines) * m_image_samples / MAX_RAY_GRID_NODES)));
+  for (;;) {
+    grid->dx = spacing * scaleX;
+    grid->dy = spacing * scaleY;
+    grid->nx = int(std::ceil((maxX - minX) / grid->dx)) + 3;
+    grid->ny = int(std::ceil((maxY - minY) / grid->dy)) + 3;
+    grid->x0 = minX - grid->dx;
+    grid->y0 = minY - grid->dy;
+    grid->ux.resize(grid->nx * grid->ny);
+    grid->uy.resize(grid->nx * grid->ny);
+    for (int j = 0; j < grid->ny; j++) {
+      for (int i = 0; i < grid->nx; i++) {
+        int k = j * grid->nx + i;
+        setFocalPlane(grid->x0 + i * grid->dx, grid->y0 + j * grid->dy,
+                      grid->ux[k], grid->uy[k]);
+      }
+    }
+
+    // Interpolate the finished grid at the cell centers
+    double error = 0.0;
+    for (int j = 1; j < grid->ny - 2; j++) {
+      for (int i = 1; i < grid->nx - 2; i++) {
+        double x = grid->x0 + (i + 0.5) * grid->dx;
+        double y = grid->y0 + (j + 0.5) * grid->dy;
+        double ux, uy, gridX, gridY;
+        setFocalPlane(x, y, ux, uy);
+        interpolateRayGrid(*grid, x, y, gridX, gridY);
+        error = std::max(error, std::max(fabs(gridX - ux) / scaleX,
+                                         fabs(gridY - uy) / scaleY));
+      }
+    }
+    if (error <= MAX_RAY_GRID_ERROR) {
+      grid->error = error;
+      return grid;
+    }
+    if (spacing <= 1.0 ||
+        4.0 * grid->nx * grid->ny > 16.0 * MAX_RAY_GRID_NODES) {
+      break;
+    }
+    spacing = std::max(1.0, spacing / 2.0);
+  }
+
+  grid->nx = 0;
+  grid->ny = 0;
+  grid->ux.clear();
+  grid->uy.clear();
+  return grid;
+}
+
+
+/**
+ * @description Enables or disables the ray grid. While disabled, the lens
+ * distortion is removed from every focal plane coordinate directly.
+ *
+ * @param enable Whether to interpolate the ray grid.
+ */
+void UsgsAstroFrameSensorModel::setRayGrid(bool enable) {
+  m_useRayGrid = enable;
+}
+
+
+/**
+ * @description Removes the lens distortion from a focal plane coordinate,
+ * interpolating the ray grid and falling back to setFocalPlane outside it
+ * or while it is disabled.
+ *
+ * @param dx distorted focal plane x in millimeters
+ * @param dy distorted focal plane y in millimeters
+ * @param undistortedX The undistorted x coordinate, in millimeters.
+ * @param undistortedY The undistorted y coordinate, in millimeters.
+ */
+void UsgsAstroFrameSensorModel::undistortFocalPlane(
+    double dx, double dy, double &undistortedX, double &undistortedY) const {
+  if (!m_useRayGrid ||
+      !interpolateRayGrid(*getRayGrid(), dx, dy, undistortedX, undistortedY)) {
+    setFocalPlane(dx, dy, undistortedX, undistortedY);
+  }
+}
+
+
+/**
+ * @description Interpolates a ray grid with 4 by 4 point Lagrange (bicubic)
+ * weights.
+ *
+ * @return false, leaving the outputs unset, outside the grid.
+ */
+bool UsgsAstroFrameSensorModel::interpolateRayGrid(
+    const RayGrid &grid, double dx, double dy,
+    double &undistortedX, double &undistortedY) {
+  if (grid.nx == 0) {
+    return false;
+  }
+  double fx = (dx - grid.x0) / grid.dx;
+  double fy = (dy - grid.y0) / grid.dy;
+  if (!(fx >= 1.0 && fx < grid.nx - 2 && fy >= 1.0 && fy < grid.ny - 2)) {
+    return false;
+  }
+
+  int i = int(fx);
+  int j = int(fy);
+  double wx[4], wy[4];
+  double t = fx - i;
+  wx[0] = -t * (t - 1) * (t - 2) / 6.0;
+  wx[1] = (t + 1) * (t - 1) * (t - 2) / 2.0;
+  wx[2] = -(t + 1) * t * (t - 2) / 2.0;
+  wx[3] = (t + 1) * t * (t - 1) / 6.0;
+  t = fy - j;
+  wy[0] = -t * (t - 1) * (t - 2) / 6.0;
+  wy[1] = (t + 1) * (t - 1) * (t - 2) / 2.0;
+  wy[2] = -(t + 1) * t * (t - 2) / 2.0;
+  wy[3] = (t + 1) * t * (t - 1) / 6.0;
+
+  undistortedX = 0.0;
+  undistortedY = 0.0;
+  for (int b = 0; b < 4; b++) {
+    int k = (j - 1 + b) * grid.nx + i - 1;
+    double rowX = wx[0] * grid.ux[k] + wx[1] * grid.ux[k + 1]
+                + wx[2] * grid.ux[k + 2] + wx[3] * grid.ux[k + 3];
+    double rowY = wx[0] * grid.uy[k] + wx[1] * grid.uy[k + 1]
+                + wx[2] * grid.uy[k + 2] + wx[3] * grid.uy[k + 3];
+    undistortedX += wy[b] * rowX;
+    undistortedY += wy[b] * rowY;
+  }
+  return true;
+}
+
+
+/**
+ * @description Refreshes the cached rotation matrix from the current omega,
+ * phi and kappa.
+ */
+void UsgsAstroFrameSensorModel::updateRotationMatrix() {
+
+  // Trigonometric functions for rotation matrix
+  double sinw = std::sin(m_currentParameterValue[3]);
+  double cosw = std::cos(m_currentParameterValue[3]);
+  double sinp = std::sin(m_currentParameterValue[4]);
+  double cosp = std::cos(m_currentParameterValue[4]);
+  double sink = std::sin(m_currentParameterValue[5]);
+  double cosk = std::cos(m_currentParameterValue[5]);
+
+  // Rotation matrix taken from Introduction to Mordern Photogrammetry by
+  // Edward M. Mikhail, et al., p. 373
+  m_rotationMatrix[0][0] = cosp * cosk;
+  m_rotationMatrix[0][1] = cosw * sink + sinw * sinp * cosk;
+  m_rotationMatrix[0][2] = sinw * sink - cosw * sinp * cosk;
+  m_rotationMatrix[1][0] = -1 * cosp * sink;
+  m_rotationMatrix[1][1] = cosw * cosk - sinw * sinp * sink;
+  m_rotationMatrix[1][2] = sinw * cosk + cosw * sinp * sink;
+  m_rotationMatrix[2][0] = sinp;
+  m_rotationMatrix[2][1] = -1 * sinw * cosp;
+  m_rotationMatrix[2][2] = cosw * cosp;
+}
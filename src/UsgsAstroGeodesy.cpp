@@ -0,0 +1,185 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Geodetic height and height constrained ray intersection for a
+//    biaxial ellipsoid.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroGeodesy.h"
+
+#include <math.h>
+
+//*****************************************************************************
+// UsgsAstroGeodesy Constructors
+//*****************************************************************************
+UsgsAstroGeodesy::UsgsAstroGeodesy()
+:
+   m_SemiMajorAxis(1.0),
+   m_SemiMinorAxis(1.0),
+   m_InvA2(1.0),
+   m_E2(0.0),
+   m_E4(0.0)
+{
+}
+
+UsgsAstroGeodesy::UsgsAstroGeodesy(double semiMajorAxis, double semiMinorAxis)
+:
+   m_SemiMajorAxis(semiMajorAxis),
+   m_SemiMinorAxis(semiMinorAxis)
+{
+   m_InvA2 = 1.0 / (semiMajorAxis * semiMajorAxis);
+   m_E2 = 1.0 - semiMinorAxis * semiMinorAxis * m_InvA2;
+   m_E4 = m_E2 * m_E2;
+}
+
+//*****************************************************************************
+// UsgsAstroGeodesy::toGeodetic
+//*****************************************************************************
+bool UsgsAstroGeodesy::toGeodetic(
+   double  x,
+   double  y,
+   double  z,
+   double &latitude,
+   double &height) const
+{
+   // The closed form is for oblate ellipsoids
+   if (m_E2 < 0.0)
+   {
+      return false;
+   }
+
+   double d2 = x * x + y * y;
+   double p = d2 * m_InvA2;
+   double q = (1.0 - m_E2) * z * z * m_InvA2;
+   double r = (p + q - m_E4) / 6.0;
+   if (r <= 0.0)
+   {
+      return false;
+   }
+
+   double s = m_E4 * p * q / (4.0 * r * r * r);
+   double disc = s * (2.0 + s);
+   if (disc < 0.0)
+   {
+      return false;
+   }
+   double t = cbrt(1.0 + s + sqrt(disc));
+   double u = r * (1.0 + t + 1.0 / t);
+   double v = sqrt(u * u + m_E4 * q);
+   double w = m_E2 * (u + v - q) / (2.0 * v);
+   double k = sqrt(u + v + w * w) - w;
+   double dd = k * sqrt(d2) / (k + m_E2);
+   double rho = sqrt(dd * dd + z * z);
+
+   height = (k + m_E2 - 1.0) / k * rho;
+   latitude = 2.0 * atan2(z, dd + rho);
+   return true;
+}
+
+//*****************************************************************************
+// UsgsAstroGeodesy::fromGeodetic
+//*****************************************************************************
+void UsgsAstroGeodesy::fromGeodetic(
+   double  latitude,
+   double  longitude,
+   double  height,
+   double &x,
+   double &y,
+   double &z) const
+{
+   double sinLat = sin(latitude);
+   double cosLat = cos(latitude);
+   double n = m_SemiMajorAxis / sqrt(1.0 - m_E2 * sinLat * sinLat);
+   x = (n + height) * cosLat * cos(longitude);
+   y = (n + height) * cosLat * sin(longitude);
+   z = (n * (1.0 - m_E2) + height) * sinLat;
+}
+
+//*****************************************************************************
+// UsgsAstroGeodesy::intersect
+//*****************************************************************************
+int UsgsAstroGeodesy::intersect(
+   double  height,
+   double  xc,
+   double  yc,
+   double  zc,
+   double  xl,
+   double  yl,
+   double  zl,
+   double &x,
+   double &y,
+   double &z,
+   double &achievedPrecision,
+   double  desiredPrecision,
+   bool   *missed) const
+{
+   const int MKTR = 10;
+
+   // Start from the ellipsoid with both axes lengthened by the height,
+   // which is within a small fraction of the height of the true surface.
+   double ap = m_SemiMajorAxis + height;
+   double bp = m_SemiMinorAxis + height;
+   double k = ap * ap / (bp * bp);
+   double at = xl * xl + yl * yl + k * zl * zl;
+   double bt = 2.0 * (xl * xc + yl * yc + k * zl * zc);
+   double ct = xc * xc + yc * yc + k * zc * zc - ap * ap;
+   double quadTerm = bt * bt - 4.0 * at * ct;
+   bool miss = quadTerm < 0.0;
+   if (miss)
+   {
+      quadTerm = 0.0;
+   }
+   if (missed)
+   {
+      *missed = miss;
+   }
+   double sTerm = sqrt(quadTerm);
+   double scale = -bt - sTerm;
+   double scale1 = -bt + sTerm;
+   if (fabs(scale1) < fabs(scale))
+   {
+      scale = scale1;
+   }
+   scale /= 2.0 * at;
+   x = xc + scale * xl;
+   y = yc + scale * yl;
+   z = zc + scale * zl;
+
+   double latitude, h;
+   if (!toGeodetic(x, y, z, latitude, h))
+   {
+      return -1;
+   }
+
+   // The height changes along the ray at the rate of the component of the
+   // look direction along the surface normal.  A ray that misses the
+   // surface has no root to step toward.
+   int ktr = 0;
+   while (!miss && ktr < MKTR && fabs(height - h) > desiredPrecision)
+   {
+      double d = sqrt(x * x + y * y);
+      double cosLat = cos(latitude);
+      double nx = d > 0.0 ? cosLat * x / d : 0.0;
+      double ny = d > 0.0 ? cosLat * y / d : 0.0;
+      double nz = sin(latitude);
+      double dhds = nx * xl + ny * yl + nz * zl;
+      if (dhds == 0.0)
+      {
+         break;
+      }
+      scale += (height - h) / dhds;
+      x = xc + scale * xl;
+      y = yc + scale * yl;
+      z = zc + scale * zl;
+      if (!toGeodetic(x, y, z, latitude, h))
+      {
+         return -1;
+      }
+      ktr++;
+   }
+
+   achievedPrecision = fabs(height - h);
+   return ktr;
+}
@@ -0,0 +1,132 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Line to time and time to line conversion for line scanner images
+//    with variable line rates.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroLsLineTimeTable.h"
+
+#include <algorithm>
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable Constructors
+//*****************************************************************************
+UsgsAstroLsLineTimeTable::UsgsAstroLsLineTimeTable()
+{
+   m_LineIndex.origin = 0.0;
+   m_LineIndex.scale = 0.0;
+   m_TimeIndex.origin = 0.0;
+   m_TimeIndex.scale = 0.0;
+}
+
+UsgsAstroLsLineTimeTable::UsgsAstroLsLineTimeTable(
+   const std::vector<double> &lines,
+   const std::vector<double> &startTimes,
+   const std::vector<double> &intTimes)
+:
+   m_Lines(lines),
+   m_StartTimes(startTimes),
+   m_IntTimes(intTimes)
+{
+   buildIndex(m_Lines, m_LineIndex);
+   buildIndex(m_StartTimes, m_TimeIndex);
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::getLineSegment
+//*****************************************************************************
+int UsgsAstroLsLineTimeTable::getLineSegment(double line) const
+{
+   return lookup(m_Lines, m_LineIndex, line);
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::getTimeSegment
+//*****************************************************************************
+int UsgsAstroLsLineTimeTable::getTimeSegment(double time) const
+{
+   return lookup(m_StartTimes, m_TimeIndex, time);
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::lineToTime
+//*****************************************************************************
+double UsgsAstroLsLineTimeTable::lineToTime(double line) const
+{
+   int i = getLineSegment(line);
+   return m_StartTimes[i] + m_IntTimes[i] * (line - m_Lines[i]);
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::timeToLine
+//*****************************************************************************
+double UsgsAstroLsLineTimeTable::timeToLine(double time) const
+{
+   int i = getTimeSegment(time);
+   return m_Lines[i] + (time - m_StartTimes[i]) / m_IntTimes[i];
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::buildIndex
+//*****************************************************************************
+void UsgsAstroLsLineTimeTable::buildIndex(
+   const std::vector<double> &values,
+   BucketIndex               &index)
+{
+   index.first.clear();
+   index.origin = values.empty() ? 0.0 : values.front();
+   index.scale = 0.0;
+   if (values.size() < 2 || values.back() <= values.front())
+   {
+      index.first.push_back(0);
+      return;
+   }
+
+   // Two buckets per segment keeps the search within a bucket short even
+   // when the segment lengths vary.
+   int numBuckets = 2 * (int)values.size();
+   index.scale = numBuckets / (values.back() - values.front());
+   index.first.resize(numBuckets);
+   std::vector<double>::const_iterator it = values.begin();
+   for (int b = 0; b < numBuckets; b++)
+   {
+      double start = index.origin + b / index.scale;
+      it = std::upper_bound(it, values.end(), start);
+      index.first[b] = std::max(0, (int)(it - values.begin()) - 1);
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsLineTimeTable::lookup
+//*****************************************************************************
+int UsgsAstroLsLineTimeTable::lookup(
+   const std::vector<double> &values,
+   const BucketIndex         &index,
+   double                     x)
+{
+   int n = (int)values.size();
+   if (n < 2 || !(x >= values[0]))
+   {
+      return 0;
+   }
+
+   double fbucket = (x - index.origin) * index.scale;
+   int numBuckets = (int)index.first.size();
+   int b = fbucket < numBuckets ? (int)fbucket : numBuckets - 1;
+
+   // Search the segments in effect over the bucket, from the one at its
+   // start through the one at the start of the next, with one more each
+   // side as the bucket starts can round either side of x.
+   int lo = std::max(0, index.first[b] - 1);
+   int hi = b + 1 < numBuckets ? std::min(n, index.first[b + 1] + 2) : n;
+   std::vector<double>::const_iterator begin = values.begin();
+   int i = (int)(std::upper_bound(begin + lo, begin + hi, x) - begin) - 1;
+   if (i < lo || (i + 1 < n && values[i + 1] <= x))
+   {
+      i = (int)(std::upper_bound(begin, values.end(), x) - begin) - 1;
+   }
+   return std::max(0, i);
+}
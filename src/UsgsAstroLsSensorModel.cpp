@@ -19,18 +19,46 @@
 #define USGSASTROLINESCANNER_LIBRARY
 
 #include "UsgsAstroLsSensorModel.h"
+#include "UsgsAstroParallel.h"
+#include "UsgsAstroTriangulation.h"
 
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <math.h>
 
+// Index of the focal bias among the adjustable parameters
+static const int FOCAL_BIAS_INDEX = 15;
+
+// Half width, in image lines, of the first search window about a hinted
+// viewing time when the rate of the offset is not known
+static const double WARM_START_LINES = 2.0;
+
+// Factor by which the first search window about a hinted viewing time
+// reaches past the predicted root, so that it usually encloses it
+static const double WARM_START_OVERSHOOT = 1.25;
+
+// Observations per thread below which computeObservationPartials uses
+// fewer threads
+static const int MIN_OBSERVATIONS_PER_THREAD = 64;
+
+// Nodes along each image axis of the grid of sensor partials used by the
+// covariance form of imageToGround
+static const int SENSOR_PARTIALS_GRID_SIZE = 9;
+
+// Smallest determinant of the image partials and the surface normal,
+// relative to the product of their lengths, for the covariance form of
+// imageToGround to invert them rather than difference imageToGround
+static const double MIN_RELATIVE_DETERMINANT = 1.0e-9;
+
 //*****************************************************************************
 // UsgsAstroLsSensorModel Constructor
 //*****************************************************************************
 UsgsAstroLsSensorModel::UsgsAstroLsSensorModel()
 {
    _no_adjustment.assign(UsgsAstroLsStateData::NUM_PARAMETERS, 0.0);
+   _iterativeGeodesy = false;
+   _useLookTable = false;
 }
 
 //*****************************************************************************
@@ -58,6 +86,17 @@ void UsgsAstroLsSensorModel::set(const UsgsAstroLsStateData &state_data)
    _no_adjustment.assign(UsgsAstroLsStateData::NUM_PARAMETERS, 0.0);
    _data = state_data;
 
+   // The ephemeris and attitude live in a trajectory shared with the other
+   // models from the same orbit, so the local copies are released.
+   _trajectory = UsgsAstroLsTrajectory::share(_data);
+   std::vector<double>().swap(_data.m_EphemPts);
+   std::vector<double>().swap(_data.m_EphemRates);
+   std::vector<double>().swap(_data.m_Quaternions);
+   bindKernels();
+   _lineTimeTable = UsgsAstroLsLineTimeTable(_data.m_IntTimeLines,
+      _data.m_IntTimeStartTimes, _data.m_IntTimes);
+   _geodesy = UsgsAstroGeodesy(_data.m_SemiMajorAxis, _data.m_SemiMinorAxis);
+
    // If needed set state data elements that need a sensor model to compute
    // Update if still using default settings
    if (_data.m_Gsd == 1.0  && _data.m_FlyingHeight == 1000.0)
@@ -65,6 +104,14 @@ void UsgsAstroLsSensorModel::set(const UsgsAstroLsStateData &state_data)
       updateState();
    }
 
+   _lookTable.clear();
+   if (_useLookTable)
+   {
+      buildLookTable();
+   }
+   resetImageEnds();
+   resetSensorPartialsGrid();
+
    try
    {
       setLinearApproximation();
@@ -127,15 +174,17 @@ void UsgsAstroLsSensorModel::updateState()
    }
 
    // Set flag for flipping image along horizontal axis
-   int index = int((_data.m_NumEphem - 1) / 2.0) * 3;
+   int index = int((_trajectory->getNumEphem() - 1) / 2.0) * 3;
+   const double* ephemPts = _trajectory->getEphemPts();
+   const double* ephemRates = _trajectory->getEphemRates();
    double xs, ys, zs;    // mid sensor position
-   xs = _data.m_EphemPts[index];
-   ys = _data.m_EphemPts[index + 1];
-   zs = _data.m_EphemPts[index + 2];
+   xs = ephemPts[index];
+   ys = ephemPts[index + 1];
+   zs = ephemPts[index + 2];
    double xv, yv, zv;    // mid sensor velocity
-   xv = _data.m_EphemRates[index];
-   yv = _data.m_EphemRates[index + 1];
-   zv = _data.m_EphemRates[index + 2];
+   xv = ephemRates[index];
+   yv = ephemRates[index + 1];
+   zv = ephemRates[index + 2];
    double xm, ym, zm;    // mid line position (mid sample)
    xm = _data.m_ReferencePointXyz.x;
    ym = _data.m_ReferencePointXyz.y;
@@ -198,7 +247,155 @@ csm::ImageCoord UsgsAstroLsSensorModel::groundToImage(
    const std::vector<double>& adj,
    double                desired_precision,
    double*               achieved_precision,
-   csm::WarningList*     warnings) const
+   csm::WarningList*     warnings,
+   SearchHint*           hint) const
+{
+   csm::ImageCoord calculatedPixel;
+   double aPrec;
+   ProjectionStatus status = tryGroundToImage(
+      ground_pt, adj, calculatedPixel, desired_precision, &aPrec, hint);
+   if (status != PROJECTION_SUCCESS) {
+      throwProjectionError(status, "UsgsAstroLsSensorModel::groundToImage");
+   }
+
+   if (achieved_precision) {
+      *achieved_precision = aPrec;
+   }
+
+   double len = aPrec * aPrec;
+   double preSquare = desired_precision * desired_precision;
+   if (warnings && (desired_precision > 0.0) && (preSquare < len)) {
+      std::stringstream msg;
+      msg << "Desired precision not achieved. ";
+      msg << len << "  " << preSquare << "\n";
+      warnings->push_back(
+         csm::Warning(csm::Warning::PRECISION_NOT_MET,
+         msg.str().c_str(),
+         "UsgsAstroLsSensorModel::groundToImage()"));
+   }
+
+   return calculatedPixel;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::tryGroundToImage
+//***************************************************************************
+UsgsAstroLsSensorModel::ProjectionStatus
+UsgsAstroLsSensorModel::tryGroundToImage(
+   const csm::EcefCoord& ground_pt,
+   csm::ImageCoord&      image_pt,
+   double                desired_precision,
+   double*               achieved_precision) const noexcept
+{
+   return tryGroundToImage(
+      ground_pt, _no_adjustment, image_pt,
+      desired_precision, achieved_precision);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::groundToImage (hinted version)
+//***************************************************************************
+csm::ImageCoord UsgsAstroLsSensorModel::groundToImage(
+   const csm::EcefCoord&  ground_pt,
+   const csm::ImageCoord& hint_pt,
+   double                 search_radius,
+   bool*                  hint_used,
+   double                 desired_precision,
+   double*                achieved_precision,
+   csm::WarningList*      warnings) const
+{
+   if (hint_used) {
+      *hint_used = false;
+   }
+   SearchHint hint;
+   setSearchHint(hint_pt, search_radius, hint);
+   csm::ImageCoord image_pt = groundToImage(
+      ground_pt, _no_adjustment,
+      desired_precision, achieved_precision, warnings, &hint);
+   if (hint_used) {
+      *hint_used = hint.used;
+   }
+   return image_pt;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::tryGroundToImage (hinted version)
+//***************************************************************************
+UsgsAstroLsSensorModel::ProjectionStatus
+UsgsAstroLsSensorModel::tryGroundToImage(
+   const csm::EcefCoord&  ground_pt,
+   const csm::ImageCoord& hint_pt,
+   double                 search_radius,
+   csm::ImageCoord&       image_pt,
+   bool*                  hint_used,
+   double                 desired_precision,
+   double*                achieved_precision) const noexcept
+{
+   SearchHint hint;
+   setSearchHint(hint_pt, search_radius, hint);
+   return tryGroundToImageNearTime(
+      ground_pt, hint.time, hint.radius, image_pt, hint_used,
+      desired_precision, achieved_precision);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::tryGroundToImageNearTime
+//***************************************************************************
+UsgsAstroLsSensorModel::ProjectionStatus
+UsgsAstroLsSensorModel::tryGroundToImageNearTime(
+   const csm::EcefCoord& ground_pt,
+   double                hint_time,
+   double                search_radius,
+   csm::ImageCoord&      image_pt,
+   bool*                 hint_used,
+   double                desired_precision,
+   double*               achieved_precision) const noexcept
+{
+   if (hint_used) {
+      *hint_used = false;
+   }
+
+   SearchHint hint;
+   hint.valid = true;
+   hint.time = hint_time;
+   hint.radius = fabs(search_radius);
+   ProjectionStatus status = tryGroundToImage(
+      ground_pt, _no_adjustment, image_pt,
+      desired_precision, achieved_precision, &hint);
+   if (hint_used) {
+      *hint_used = hint.used;
+   }
+   return status;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::setSearchHint
+//***************************************************************************
+void UsgsAstroLsSensorModel::setSearchHint(
+   const csm::ImageCoord& hint_pt,
+   double                 search_radius,
+   SearchHint&            hint) const
+{
+   // The radius in lines becomes the time to the line that far from the
+   // hint, at the line rate there
+   hint.valid = true;
+   hint.time = getImageTime(hint_pt);
+   hint.radius = fabs(getImageTime(
+      csm::ImageCoord(hint_pt.line + fabs(search_radius), hint_pt.samp))
+      - hint.time);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::tryGroundToImage (internal version)
+//***************************************************************************
+UsgsAstroLsSensorModel::ProjectionStatus
+UsgsAstroLsSensorModel::tryGroundToImage(
+   const csm::EcefCoord& ground_pt,
+   const std::vector<double>& adj,
+   csm::ImageCoord&      image_pt,
+   double                desired_precision,
+   double*               achieved_precision,
+   SearchHint*           hint) const noexcept
 {
    // Search for the line, sample coordinate that viewed a given ground point.
    // This method uses an iterative bisection method to search for the image
@@ -223,77 +420,199 @@ csm::ImageCoord UsgsAstroLsSensorModel::groundToImage(
 
    // Start bisection search on the image lines
    double sampCtr = _data.m_TotalSamples / 2.0;
-   double firstTime = getImageTime(csm::ImageCoord(0.0, sampCtr));
-   double lastTime = getImageTime(csm::ImageCoord(_data.m_TotalLines, sampCtr));
-   double firstOffset = computeViewingPixel(firstTime, ground_pt, adj).line - 0.5;
-   double lastOffset = computeViewingPixel(lastTime, ground_pt, adj).line - 0.5;
+   double imageFirstTime = getImageTime(csm::ImageCoord(0.0, sampCtr));
+   double imageLastTime = getImageTime(csm::ImageCoord(_data.m_TotalLines, sampCtr));
+   double firstTime = imageFirstTime;
+   double lastTime = imageLastTime;
+   double firstOffset, lastOffset;
+   double approxLineRes = hint ? hint->lineResolution : 0.0;
+
+   // Without adjustments the orientation at the image ends is cached, so a
+   // point that the image does not view is rejected without interpolating
+   // the trajectory
+   double endOffsets[2];
+   bool unadjusted = adj == _no_adjustment;
+   if (unadjusted) {
+      std::shared_ptr<const ImageEnds> ends = getImageEnds();
+      endOffsets[0] =
+         computeViewingPixel(ends->first, ground_pt, adj).line - 0.5;
+      endOffsets[1] =
+         computeViewingPixel(ends->last, ground_pt, adj).line - 0.5;
+      if ((endOffsets[0] > 0) != (endOffsets[1] < 0)) {
+         return PROJECTION_NOT_VIEWED;
+      }
+   }
+   if (hint) {
+      hint->used = hint->valid &&
+                   hint->time >= std::min(imageFirstTime, imageLastTime) &&
+                   hint->time <= std::max(imageFirstTime, imageLastTime);
+   }
+   if (hint && hint->used) {
+      // Window from the hinted time to just past the time at which the
+      // offset there, at the rate of the previous solve, would vanish.  If
+      // it does not enclose the root, it is moved outwards on the side of
+      // the root, by a growing step, until it does.  Where the offset grows
+      // away from the root the end beyond the window's far side is the one
+      // to move.
+      double hintTime = hint->time;
+      double partials[6];
+      double hintOffset = computeViewingPixel(hintTime, ground_pt, adj,
+         approxLineRes > 0.0 ? NULL : partials).line - 0.5;
+      if (approxLineRes <= 0.0) {
+         // The ground size of a line offset along the surface, from the
+         // line partials across the ellipsoid normal
+         double a2 = _data.m_SemiMajorAxis * _data.m_SemiMajorAxis;
+         double b2 = _data.m_SemiMinorAxis * _data.m_SemiMinorAxis;
+         double normal[3] = { ground_pt.x / a2, ground_pt.y / a2,
+                              ground_pt.z / b2 };
+         double mag = sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                         + normal[2] * normal[2]);
+         double along = (partials[0] * normal[0] + partials[1] * normal[1]
+                       + partials[2] * normal[2]) / (mag * mag);
+         double gradient = 0.0;
+         for (int i = 0; i < 3; i++) {
+            double across = partials[i] - along * normal[i];
+            gradient += across * across;
+         }
+         if (gradient > 0.0) {
+            approxLineRes = 1.0 / sqrt(gradient);
+         }
+      }
+      double step = hint->radius > 0.0 ? hint->radius
+                  : WARM_START_LINES * (imageLastTime - imageFirstTime)
+                  / _data.m_TotalLines;
+      double reach = -WARM_START_OVERSHOOT * hintOffset * hint->timePerOffset;
+      if (!(fabs(reach) > 0.0)) {
+         reach = hintOffset > 0 ? -step : step;
+      }
+      double otherTime = std::min(imageLastTime,
+                                  std::max(imageFirstTime, hintTime + reach));
+      double otherOffset =
+         computeViewingPixel(otherTime, ground_pt, adj).line - 0.5;
+      if (otherTime < hintTime) {
+         firstTime = otherTime;
+         firstOffset = otherOffset;
+         lastTime = hintTime;
+         lastOffset = hintOffset;
+      }
+      else {
+         firstTime = hintTime;
+         firstOffset = hintOffset;
+         lastTime = otherTime;
+         lastOffset = otherOffset;
+      }
+      step = std::max(step, fabs(reach));
+      while ((firstOffset > 0) != (lastOffset < 0)) {
+         step *= 4.0;
+         bool rootBefore = (lastOffset - firstOffset > 0) == (firstOffset > 0);
+         if (rootBefore && firstTime > imageFirstTime) {
+            lastTime = firstTime;
+            lastOffset = firstOffset;
+            firstTime = std::max(imageFirstTime, firstTime - step);
+            firstOffset = computeViewingPixel(firstTime, ground_pt, adj).line - 0.5;
+         }
+         else if (!rootBefore && lastTime < imageLastTime) {
+            firstTime = lastTime;
+            firstOffset = lastOffset;
+            lastTime = std::min(imageLastTime, lastTime + step);
+            lastOffset = computeViewingPixel(lastTime, ground_pt, adj).line - 0.5;
+         }
+         else {
+            return PROJECTION_NOT_VIEWED;
+         }
+      }
+   }
+   else if (unadjusted) {
+      firstOffset = endOffsets[0];
+      lastOffset = endOffsets[1];
+   }
+   else {
+      firstOffset = computeViewingPixel(firstTime, ground_pt, adj).line - 0.5;
+      lastOffset = computeViewingPixel(lastTime, ground_pt, adj).line - 0.5;
 
-   // Check if both offsets have the same sign.
-   // This means there is not guaranteed to be a zero.
-   if ((firstOffset > 0) != (lastOffset < 0)) {
-        throw csm::Error(
-           csm::Error::ALGORITHM,
-           "Ground point is not viewed by the image.",
-           "UsgsAstroLsSensorModel::groundToImage");
+      // Check if both offsets have the same sign.
+      // This means there is not guaranteed to be a zero.
+      if ((firstOffset > 0) != (lastOffset < 0)) {
+         return PROJECTION_NOT_VIEWED;
+      }
+   }
+   if (hint && lastOffset != firstOffset) {
+      hint->timePerOffset = (lastTime - firstTime) / (lastOffset - firstOffset);
    }
 
    // Convert the ground precision to pixel precision so we can
    // check for convergence without re-intersecting
-   csm::ImageCoord approxPoint;
-   computeLinearApproximation(ground_pt, approxPoint);
-   csm::ImageCoord approxNextPoint = approxPoint;
-   if (approxNextPoint.line + 1 < _data.m_TotalLines) {
-      ++approxNextPoint.line;
+   if (approxLineRes <= 0.0) {
+      csm::ImageCoord approxPoint;
+      computeLinearApproximation(ground_pt, approxPoint);
+      csm::ImageCoord approxNextPoint = approxPoint;
+      if (approxNextPoint.line + 1 < _data.m_TotalLines) {
+         ++approxNextPoint.line;
+      }
+      else {
+         --approxNextPoint.line;
+      }
+      csm::EcefCoord approxIntersect, approxNextIntersect;
+      tryImageToGround(approxPoint, _data.m_RefElevation, approxIntersect);
+      tryImageToGround(approxNextPoint, _data.m_RefElevation, approxNextIntersect);
+      double lineDX = approxNextIntersect.x - approxIntersect.x;
+      double lineDY = approxNextIntersect.y - approxIntersect.y;
+      double lineDZ = approxNextIntersect.z - approxIntersect.z;
+      approxLineRes = sqrt(lineDX * lineDX + lineDY * lineDY + lineDZ * lineDZ);
+   }
+   if (hint) {
+      hint->lineResolution = approxLineRes;
    }
-   else {
-      --approxNextPoint.line;
-   }
-   csm::EcefCoord approxIntersect = imageToGround(approxPoint, _data.m_RefElevation);
-   csm::EcefCoord approxNextIntersect = imageToGround(approxNextPoint, _data.m_RefElevation);
-   double lineDX = approxNextIntersect.x - approxIntersect.x;
-   double lineDY = approxNextIntersect.y - approxIntersect.y;
-   double lineDZ = approxNextIntersect.z - approxIntersect.z;
-   double approxLineRes = sqrt(lineDX * lineDX + lineDY * lineDY + lineDZ * lineDZ);
    // Increase the precision by a small amount to ensure the desired precision is met
    double pixelPrec = desired_precision / approxLineRes * 0.9;
 
-   // Start bisection search for zero
+   // Start bisection search for zero. Plain false position keeps one end
+   // of the window fixed and only creeps up on the zero from the other, so
+   // use the Illinois variant: halve the offset of an end that is retained
+   // twice in a row. Stop as soon as the viewing line is within precision.
+   double computedTime = firstTime;
+   csm::ImageCoord calculatedPixel;
+   int retained = 0;
    for (int it = 0; it < 30; it++) {
-      double nextTime = ((firstTime * lastOffset) - (lastTime * firstOffset))
-                      / (lastOffset - firstOffset);
-      double nextOffset = computeViewingPixel(nextTime, ground_pt, adj).line - 0.5;
+      computedTime = ((firstTime * lastOffset) - (lastTime * firstOffset))
+                   / (lastOffset - firstOffset);
+      calculatedPixel = computeViewingPixel(computedTime, ground_pt, adj);
+      double nextOffset = calculatedPixel.line - 0.5;
+      if (fabs(nextOffset) < pixelPrec) {
+         break;
+      }
       // We're looking for a zero, so check that either firstLine and middleLine have
       // opposite signs, or middleLine and lastLine have opposite signs.
       if ((firstOffset > 0) == (nextOffset < 0)) {
-         lastTime = nextTime;
+         lastTime = computedTime;
          lastOffset = nextOffset;
+         if (retained == -1) {
+            firstOffset /= 2.0;
+         }
+         retained = -1;
       }
       else {
-         firstTime = nextTime;
+         firstTime = computedTime;
          firstOffset = nextOffset;
-      }
-      if (fabs(lastOffset - firstOffset) < pixelPrec) {
-         break;
+         if (retained == 1) {
+            lastOffset /= 2.0;
+         }
+         retained = 1;
       }
    }
 
    // Check that the desired precision was met
 
-   double computedTime = ((firstTime * lastOffset) - (lastTime * firstOffset))
-                       / (lastOffset - firstOffset);
-   csm::ImageCoord calculatedPixel = computeViewingPixel(computedTime, ground_pt, adj);
    // The computed viewing line is the detector line, so we need to convert that to image lines
-   auto referenceTimeIt = std::upper_bound(_data.m_IntTimeStartTimes.begin(),
-                                           _data.m_IntTimeStartTimes.end(),
-                                           computedTime);
-   if (referenceTimeIt != _data.m_IntTimeStartTimes.begin()) {
-      --referenceTimeIt;
-   }
-   size_t referenceIndex = std::distance(_data.m_IntTimeStartTimes.begin(), referenceTimeIt);
-   calculatedPixel.line += _data.m_IntTimeLines[referenceIndex] - 1
-                         + (computedTime - _data.m_IntTimeStartTimes[referenceIndex])
-                         / _data.m_IntTimes[referenceIndex];
-   csm::EcefCoord calculatedPoint = imageToGround(calculatedPixel, _data.m_RefElevation);
+   calculatedPixel.line += _lineTimeTable.timeToLine(computedTime) - 1;
+
+   // Re-intersect at the height of the ground point itself, not at the
+   // reference elevation
+   double height, aPrec;
+   computeElevation(ground_pt.x, ground_pt.y, ground_pt.z, height, aPrec,
+      desired_precision);
+   csm::EcefCoord calculatedPoint;
+   tryImageToGround(calculatedPixel, height, calculatedPoint);
    double dx = ground_pt.x - calculatedPoint.x;
    double dy = ground_pt.y - calculatedPoint.y;
    double dz = ground_pt.z - calculatedPoint.z;
@@ -301,30 +620,207 @@ csm::ImageCoord UsgsAstroLsSensorModel::groundToImage(
 
    // If the final correction is greater than 10 meters,
    // the solution is not valid enough to report even with a warning
-   printf("%f\n", len);
    if (len > 100.0) {
-      throw csm::Error(
-         csm::Error::ALGORITHM,
-         "Did not converge.",
-         "UsgsAstroLsSensorModel::groundToImage");
+      return PROJECTION_NOT_CONVERGED;
    }
 
    if (achieved_precision) {
       *achieved_precision = sqrt(len);
    }
 
-   double preSquare = desired_precision * desired_precision;
-   if (warnings && (desired_precision > 0.0) && (preSquare < len)) {
-      std::stringstream msg;
-      msg << "Desired precision not achieved. ";
-      msg << len << "  " << preSquare << "\n";
-      warnings->push_back(
-         csm::Warning(csm::Warning::PRECISION_NOT_MET,
-         msg.str().c_str(),
-         "UsgsAstroLsSensorModel::groundToImage()"));
+   if (hint) {
+      hint->valid = true;
+      hint->time = computedTime;
    }
 
-   return calculatedPixel;
+   image_pt = calculatedPixel;
+   return PROJECTION_SUCCESS;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::groundToImage (array version)
+//***************************************************************************
+void UsgsAstroLsSensorModel::groundToImage(
+   int               n,
+   const double*     x,
+   const double*     y,
+   const double*     z,
+   double*           line,
+   double*           sample,
+   ProjectionStatus* status,
+   double            desired_precision) const noexcept
+{
+   for (int i = 0; i < n; i++)
+   {
+      csm::ImageCoord imagePt;
+      status[i] = tryGroundToImage(
+         csm::EcefCoord(x[i], y[i], z[i]), imagePt, desired_precision);
+      line[i] = imagePt.line;
+      sample[i] = imagePt.samp;
+   }
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::isPossiblyVisible
+//***************************************************************************
+bool UsgsAstroLsSensorModel::isPossiblyVisible(
+   const csm::EcefCoord& ground_pt) const
+{
+   std::shared_ptr<const ImageEnds> ends = getImageEnds();
+   double firstOffset =
+      computeViewingPixel(ends->first, ground_pt, _no_adjustment).line - 0.5;
+   double lastOffset =
+      computeViewingPixel(ends->last, ground_pt, _no_adjustment).line - 0.5;
+   return (firstOffset > 0) == (lastOffset < 0);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeFootprint
+//***************************************************************************
+UsgsAstroFootprint UsgsAstroLsSensorModel::computeFootprint(
+   double minHeight,
+   double maxHeight,
+   double tolerance) const
+{
+   UsgsAstroFootprint::Intersector intersect =
+      [this](const csm::ImageCoord& image_pt, double height,
+             csm::EcefCoord& ground_pt)
+   {
+      return tryImageToGround(image_pt, height, ground_pt)
+         == PROJECTION_SUCCESS;
+   };
+   return UsgsAstroFootprint(
+      getValidImageRange(), _data.m_SemiMajorAxis, _data.m_SemiMinorAxis,
+      minHeight, maxHeight, tolerance, intersect);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeRpcModel
+//***************************************************************************
+UsgsAstroRpcModel UsgsAstroLsSensorModel::computeRpcModel(
+   int gridSize,
+   int numHeights) const
+{
+   return UsgsAstroRpcModel(
+      *this, _data.m_SemiMajorAxis, _data.m_SemiMinorAxis,
+      gridSize, numHeights);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::imageToRay
+//***************************************************************************
+csm::EcefLocus UsgsAstroLsSensorModel::imageToRay(
+   const csm::ImageCoord& image_pt) const
+{
+   double xc, yc, zc;
+   double vx, vy, vz;
+   double xl, yl, zl;
+   double dxl, dyl, dzl;
+   losToEcf(
+      image_pt.line, image_pt.samp, _no_adjustment,
+      xc, yc, zc, vx, vy, vz, xl, yl, zl);
+   if (_data.m_AberrFlag == 1)
+   {
+      lightAberrationCorr(vx, vy, vz, xl, yl, zl, dxl, dyl, dzl);
+      xl += dxl;
+      yl += dyl;
+      zl += dzl;
+   }
+
+   double mag = sqrt(xl * xl + yl * yl + zl * zl);
+   return csm::EcefLocus(xc, yc, zc, xl / mag, yl / mag, zl / mag);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::imageToRays
+//***************************************************************************
+void UsgsAstroLsSensorModel::imageToRays(
+   double          line,
+   double          firstSample,
+   double          sampleSpacing,
+   int             numSamples,
+   csm::EcefLocus* rays) const
+{
+   LineOrientation orientation;
+   computeLineOrientation(line, _no_adjustment, orientation);
+   const double* position = orientation.position;
+   const double* velocity = orientation.velocity;
+   for (int i = 0; i < numSamples; i++)
+   {
+      double xl, yl, zl;
+      double dxl, dyl, dzl;
+      lineLosToEcf(
+         orientation, line, firstSample + i * sampleSpacing, _no_adjustment,
+         xl, yl, zl);
+      if (_data.m_AberrFlag == 1)
+      {
+         lightAberrationCorr(
+            velocity[0], velocity[1], velocity[2], xl, yl, zl, dxl, dyl, dzl);
+         xl += dxl;
+         yl += dyl;
+         zl += dzl;
+      }
+
+      double mag = sqrt(xl * xl + yl * yl + zl * zl);
+      rays[i] = csm::EcefLocus(position[0], position[1], position[2],
+                               xl / mag, yl / mag, zl / mag);
+   }
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeEpipolarCurve
+//***************************************************************************
+UsgsAstroEpipolarCurve UsgsAstroLsSensorModel::computeEpipolarCurve(
+   const csm::RasterGM&   otherModel,
+   const csm::ImageCoord& otherPt,
+   double                 minHeight,
+   double                 maxHeight,
+   double                 tolerance) const
+{
+   csm::EcefLocus ray = UsgsAstroTriangulation::getRay(otherModel, otherPt);
+
+   // The curve visits its points in order, so each search is hinted with
+   // the time of the point before
+   SearchHint hint;
+   UsgsAstroEpipolarCurve::Projector project =
+      [this, &hint](const csm::EcefCoord& ground_pt, csm::ImageCoord& image_pt)
+   {
+      return tryGroundToImage(
+         ground_pt, _no_adjustment, image_pt, 0.001, NULL, &hint)
+         == PROJECTION_SUCCESS;
+   };
+   return UsgsAstroEpipolarCurve(
+      ray, _data.m_SemiMajorAxis, _data.m_SemiMinorAxis,
+      minHeight, maxHeight, tolerance, project);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::throwProjectionError
+//***************************************************************************
+void UsgsAstroLsSensorModel::throwProjectionError(
+   ProjectionStatus   status,
+   const std::string& function)
+{
+   switch (status)
+   {
+      case PROJECTION_NOT_VIEWED:
+         throw csm::Error(
+            csm::Error::ALGORITHM,
+            "Ground point is not viewed by the image.",
+            function);
+      case PROJECTION_NOT_CONVERGED:
+         throw csm::Error(
+            csm::Error::ALGORITHM,
+            "Did not converge.",
+            function);
+      case PROJECTION_MISSED:
+         throw csm::Error(
+            csm::Error::ALGORITHM,
+            "Image ray does not intersect the surface.",
+            function);
+      default:
+         break;
+   }
 }
 
 //***************************************************************************
@@ -406,6 +902,37 @@ csm::EcefCoord UsgsAstroLsSensorModel::imageToGround(
    double desired_precision,
    double* achieved_precision,
    csm::WarningList* warnings) const
+{
+   // A ray that misses the surface gives the nearest point, as it always
+   // has, rather than an error.
+   double aPrec;
+   csm::EcefCoord ground_pt;
+   tryImageToGround(image_pt, height, ground_pt, desired_precision, &aPrec);
+
+   if (achieved_precision)
+      *achieved_precision = aPrec;
+
+   if (warnings && (desired_precision > 0.0) && (aPrec > desired_precision))
+   {
+      warnings->push_back(
+         csm::Warning(
+            csm::Warning::PRECISION_NOT_MET,
+            "Desired precision not achieved.",
+            "UsgsAstroLsSensorModel::imageToGround()"));
+   }
+   return ground_pt;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::tryImageToGround
+//***************************************************************************
+UsgsAstroLsSensorModel::ProjectionStatus
+UsgsAstroLsSensorModel::tryImageToGround(
+   const csm::ImageCoord& image_pt,
+   double                 height,
+   csm::EcefCoord&        ground_pt,
+   double                 desired_precision,
+   double*                achieved_precision) const noexcept
 {
    double xc, yc, zc;
    double vx, vy, vz;
@@ -423,22 +950,14 @@ csm::EcefCoord UsgsAstroLsSensorModel::imageToGround(
    }
 
    double aPrec;
-   double x, y, z;
-   losEllipsoidIntersect(
-      height, xc, yc, zc, xl, yl, zl, x, y, z, aPrec, desired_precision);
+   bool hit = losEllipsoidIntersect(
+      height, xc, yc, zc, xl, yl, zl,
+      ground_pt.x, ground_pt.y, ground_pt.z, aPrec, desired_precision);
 
    if (achieved_precision)
       *achieved_precision = aPrec;
 
-   if (warnings && (desired_precision > 0.0) && (aPrec > desired_precision))
-   {
-      warnings->push_back(
-         csm::Warning(
-            csm::Warning::PRECISION_NOT_MET,
-            "Desired precision not achieved.",
-            "UsgsAstroLsSensorModel::imageToGround()"));
-   }
-   return csm::EcefCoord(x, y, z);
+   return hit ? PROJECTION_SUCCESS : PROJECTION_MISSED;
 }
 
 
@@ -481,40 +1000,93 @@ csm::EcefCoordCovar UsgsAstroLsSensorModel::imageToGround(
    csm::WarningList* warnings) const
 {
    // Image to ground with error propagation
-   // Use numerical partials
-
-   const double DELTA_IMAGE = 1.0;
-   const double DELTA_GROUND = _data.m_Gsd;
    csm::ImageCoord ip(image_pt.line, image_pt.samp);
 
    csm::EcefCoord gp = imageToGround(
       ip, height, desired_precision, achieved_precision, warnings);
 
-   // Compute numerical partials xyz wrt to lsh
-   ip.line = image_pt.line + DELTA_IMAGE;
-   ip.samp = image_pt.samp;
-   csm::EcefCoord gpl = imageToGround(ip, height, desired_precision);
-   double xpl = (gpl.x - gp.x) / DELTA_IMAGE;
-   double ypl = (gpl.y - gp.y) / DELTA_IMAGE;
-   double zpl = (gpl.z - gp.z) / DELTA_IMAGE;
-
-   ip.line = image_pt.line;
-   ip.samp = image_pt.samp + DELTA_IMAGE;
-   csm::EcefCoord gps = imageToGround(ip, height, desired_precision);
-   double xps = (gps.x - gp.x) / DELTA_IMAGE;
-   double yps = (gps.y - gp.y) / DELTA_IMAGE;
-   double zps = (gps.z - gp.z) / DELTA_IMAGE;
-
-   ip.line = image_pt.line;
-   ip.samp = image_pt.samp; // +DELTA_IMAGE;
-   csm::EcefCoord gph = imageToGround(ip, height + DELTA_GROUND, desired_precision);
-   double xph = (gph.x - gp.x) / DELTA_GROUND;
-   double yph = (gph.y - gp.y) / DELTA_GROUND;
-   double zph = (gph.z - gp.z) / DELTA_GROUND;
+   // Partials of the ground point with respect to line, sample and height,
+   // as the inverse of those of line, sample and height with respect to
+   // the ground point: the image partials at the viewing time, and the
+   // surface normal, along which the height grows
+   double prt[6];
+   computeGroundPartials(gp, getImageTime(ip), prt);
+   double latitude, h;
+   double longitude = atan2(gp.y, gp.x);
+   double normal[3];
+   if (_geodesy.toGeodetic(gp.x, gp.y, gp.z, latitude, h))
+   {
+      normal[0] = cos(latitude) * cos(longitude);
+      normal[1] = cos(latitude) * sin(longitude);
+      normal[2] = sin(latitude);
+   }
+   else
+   {
+      double a2 = _data.m_SemiMajorAxis * _data.m_SemiMajorAxis;
+      double b2 = _data.m_SemiMinorAxis * _data.m_SemiMinorAxis;
+      normal[0] = gp.x / a2;
+      normal[1] = gp.y / a2;
+      normal[2] = gp.z / b2;
+      double mag = sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                      + normal[2] * normal[2]);
+      normal[0] /= mag;
+      normal[1] /= mag;
+      normal[2] /= mag;
+   }
+   double m[9] = { prt[0], prt[1], prt[2],
+                   prt[3], prt[4], prt[5],
+                   normal[0], normal[1], normal[2] };
+   double det = determinant3x3(m);
+   double scale =
+      sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) *
+      sqrt(m[3] * m[3] + m[4] * m[4] + m[5] * m[5]);
+   double xpl, xps, xph, ypl, yps, yph, zpl, zps, zph;
+   if (fabs(det) > MIN_RELATIVE_DETERMINANT * scale)
+   {
+      xpl = (m[4] * m[8] - m[5] * m[7]) / det;
+      xps = (m[2] * m[7] - m[1] * m[8]) / det;
+      xph = (m[1] * m[5] - m[2] * m[4]) / det;
+      ypl = (m[5] * m[6] - m[3] * m[8]) / det;
+      yps = (m[0] * m[8] - m[2] * m[6]) / det;
+      yph = (m[2] * m[3] - m[0] * m[5]) / det;
+      zpl = (m[3] * m[7] - m[4] * m[6]) / det;
+      zps = (m[1] * m[6] - m[0] * m[7]) / det;
+      zph = (m[0] * m[4] - m[1] * m[3]) / det;
+   }
+   else
+   {
+      // The ray grazes the surface, or the partials are degenerate, so
+      // difference imageToGround instead
+      const double DELTA_IMAGE = 1.0;
+      const double DELTA_GROUND = _data.m_Gsd;
+
+      csm::EcefCoord gpl = imageToGround(
+         csm::ImageCoord(ip.line + DELTA_IMAGE, ip.samp), height,
+         desired_precision);
+      xpl = (gpl.x - gp.x) / DELTA_IMAGE;
+      ypl = (gpl.y - gp.y) / DELTA_IMAGE;
+      zpl = (gpl.z - gp.z) / DELTA_IMAGE;
+
+      csm::EcefCoord gps = imageToGround(
+         csm::ImageCoord(ip.line, ip.samp + DELTA_IMAGE), height,
+         desired_precision);
+      xps = (gps.x - gp.x) / DELTA_IMAGE;
+      yps = (gps.y - gp.y) / DELTA_IMAGE;
+      zps = (gps.z - gp.z) / DELTA_IMAGE;
+
+      csm::EcefCoord gph = imageToGround(
+         ip, height + DELTA_GROUND, desired_precision);
+      xph = (gph.x - gp.x) / DELTA_GROUND;
+      yph = (gph.y - gp.y) / DELTA_GROUND;
+      zph = (gph.z - gp.z) / DELTA_GROUND;
+   }
 
    // Convert sensor covariance to image space
    double sCov[4];
-   determineSensorCovarianceInImageSpace(gp, sCov);
+   if (!interpolateSensorCovariance(ip, height, sCov))
+   {
+      determineSensorCovarianceInImageSpace(gp, sCov);
+   }
 
    std::vector<double> unmod = getUnmodeledError(image_pt);
 
@@ -561,58 +1133,23 @@ csm::EcefCoordCovar UsgsAstroLsSensorModel::imageToGround(
 csm::EcefLocus UsgsAstroLsSensorModel::imageToProximateImagingLocus(
    const csm::ImageCoord& image_pt,
    const csm::EcefCoord& ground_pt,
-   double desired_precision,
+   double /* desired_precision */,
    double* achieved_precision,
-   csm::WarningList* warnings) const
-{
-   // Object ray unit direction near given ground location
-   const double DELTA_GROUND = _data.m_Gsd;
-
-   double x = ground_pt.x;
-   double y = ground_pt.y;
-   double z = ground_pt.z;
+   csm::WarningList* /* warnings */) const
+{
+   // Point of the image ray closest to the ground point, which needs no
+   // iteration
+   csm::EcefLocus locus = imageToRay(image_pt);
+   double scale =
+      (ground_pt.x - locus.point.x) * locus.direction.x +
+      (ground_pt.y - locus.point.y) * locus.direction.y +
+      (ground_pt.z - locus.point.z) * locus.direction.z;
+   locus.point.x += scale * locus.direction.x;
+   locus.point.y += scale * locus.direction.y;
+   locus.point.z += scale * locus.direction.z;
 
-   // Elevation at input ground point
-   double height, aPrec;
-   computeElevation(x, y, z, height, aPrec, desired_precision);
-
-   // Ground point on object ray with the same elevation
-   csm::EcefCoord gp1 = imageToGround(
-      image_pt, height, desired_precision, achieved_precision);
-
-   // Vector between 2 ground points above
-   double dx1 = x - gp1.x;
-   double dy1 = y - gp1.y;
-   double dz1 = z - gp1.z;
-
-   // Unit vector along object ray
-   csm::EcefCoord gp2 = imageToGround(
-      image_pt, height - DELTA_GROUND, desired_precision, achieved_precision);
-   double dx2 = gp2.x - gp1.x;
-   double dy2 = gp2.y - gp1.y;
-   double dz2 = gp2.z - gp1.z;
-   double mag2 = sqrt(dx2 * dx2 + dy2 * dy2 + dz2 * dz2);
-   dx2 /= mag2;
-   dy2 /= mag2;
-   dz2 /= mag2;
-
-   // Point on object ray perpendicular to input point
-
-   // Locus
-   csm::EcefLocus locus;
-   double scale = dx1 * dx2 + dy1 * dy2 + dz1 * dz2;
-   gp2.x = gp1.x + scale * dx2;
-   gp2.y = gp1.y + scale * dy2;
-   gp2.z = gp1.z + scale * dz2;
-
-   double hLocus;
-   computeElevation(gp2.x, gp2.y, gp2.z, hLocus, aPrec, desired_precision);
-   locus.point = imageToGround(
-      image_pt, hLocus, desired_precision, achieved_precision, warnings);
-
-   locus.direction.x = dx2;
-   locus.direction.y = dy2;
-   locus.direction.z = dz2;
+   if (achieved_precision)
+      *achieved_precision = 0.0;
 
    return locus;
 }
@@ -626,36 +1163,28 @@ csm::EcefLocus UsgsAstroLsSensorModel::imageToRemoteImagingLocus(
    double* achieved_precision,
    csm::WarningList* warnings) const
 {
-   // Object ray unit direction at exposure station
-   // Exposure station arbitrary for orthos, so set elevation to zero
-
-   // Set esposure station elevation to zero
-   double height = 0.0;
-   double GND_DELTA = _data.m_Gsd;
-   // Point on object ray at zero elevation
-   csm::EcefCoord gp1 = imageToGround(
-      image_pt, height, desired_precision, achieved_precision, warnings);
-
-   // Unit vector along object ray
-   csm::EcefCoord gp2 = imageToGround(
-      image_pt, height - GND_DELTA, desired_precision, achieved_precision, warnings);
-
-   double dx2, dy2, dz2;
-   dx2 = gp2.x - gp1.x;
-   dy2 = gp2.y - gp1.y;
-   dz2 = gp2.z - gp1.z;
-   double mag2 = sqrt(dx2 * dx2 + dy2 * dy2 + dz2 * dz2);
-   dx2 /= mag2;
-   dy2 /= mag2;
-   dz2 /= mag2;
-
-   // Locus
-   csm::EcefLocus locus;
-   locus.point = gp1;
-   locus.direction.x = dx2;
-   locus.direction.y = dy2;
-   locus.direction.z = dz2;
+   // Exposure station arbitrary for orthos, so the locus point is where
+   // the image ray reaches zero elevation
+   csm::EcefLocus locus = imageToRay(image_pt);
+
+   double x, y, z, aPrec;
+   losEllipsoidIntersect(
+      0.0, locus.point.x, locus.point.y, locus.point.z,
+      locus.direction.x, locus.direction.y, locus.direction.z,
+      x, y, z, aPrec, desired_precision);
+   locus.point = csm::EcefCoord(x, y, z);
+
+   if (achieved_precision)
+      *achieved_precision = aPrec;
 
+   if (warnings && (desired_precision > 0.0) && (aPrec > desired_precision))
+   {
+      warnings->push_back(
+         csm::Warning(
+            csm::Warning::PRECISION_NOT_MET,
+            "Desired precision not achieved.",
+            "UsgsAstroLsSensorModel::imageToRemoteImagingLocus()"));
+   }
    return locus;
 }
 
@@ -669,28 +1198,59 @@ csm::EcefLocus UsgsAstroLsSensorModel::imageToRemoteImagingLocus(
 std::vector<double> UsgsAstroLsSensorModel::computeGroundPartials(
    const csm::EcefCoord& ground_pt) const
 {
-   double GND_DELTA = _data.m_Gsd;
-   // Partial of line, sample wrt X, Y, Z
-   double x = ground_pt.x;
-   double y = ground_pt.y;
-   double z = ground_pt.z;
-
-   csm::ImageCoord ipB = groundToImage(ground_pt);
-   csm::ImageCoord ipX = groundToImage(csm::EcefCoord(x + GND_DELTA, y, z));
-   csm::ImageCoord ipY = groundToImage(csm::EcefCoord(x, y + GND_DELTA, z));
-   csm::ImageCoord ipZ = groundToImage(csm::EcefCoord(x, y, z + GND_DELTA));
+   // One solve for the viewing time, then the partials at that time
+   SearchHint hint;
+   csm::ImageCoord image_pt;
+   ProjectionStatus status = tryGroundToImage(
+      ground_pt, _no_adjustment, image_pt, 0.001, NULL, &hint);
+   if (status != PROJECTION_SUCCESS)
+   {
+      throwProjectionError(
+         status, "UsgsAstroLsSensorModel::computeGroundPartials");
+   }
 
    std::vector<double> partials(6, 0.0);
-   partials[0] = (ipX.line - ipB.line) / GND_DELTA;
-   partials[3] = (ipX.samp - ipB.samp) / GND_DELTA;
-   partials[1] = (ipY.line - ipB.line) / GND_DELTA;
-   partials[4] = (ipY.samp - ipB.samp) / GND_DELTA;
-   partials[2] = (ipZ.line - ipB.line) / GND_DELTA;
-   partials[5] = (ipZ.samp - ipB.samp) / GND_DELTA;
-
+   computeGroundPartials(ground_pt, hint.time, &partials[0]);
    return partials;
 }
 
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeGroundPartials (internal version)
+//***************************************************************************
+void UsgsAstroLsSensorModel::computeGroundPartials(
+   const csm::EcefCoord& ground_pt,
+   double                time,
+   double                partials[6]) const
+{
+   // Partials of the detector line and sample with respect to the time,
+   // by central differences over one line; the pixel is smooth in time,
+   // unlike in the ground point through the search
+   double sampCtr = _data.m_TotalSamples / 2.0;
+   double dt = fabs(getImageTime(csm::ImageCoord(_data.m_TotalLines, sampCtr))
+                  - getImageTime(csm::ImageCoord(0.0, sampCtr)))
+             / _data.m_TotalLines;
+   csm::ImageCoord before = computeViewingPixel(
+      time - dt, ground_pt, _no_adjustment);
+   csm::ImageCoord after = computeViewingPixel(
+      time + dt, ground_pt, _no_adjustment);
+   double lineRate = (after.line - before.line) / (2.0 * dt);
+   double sampRate = (after.samp - before.samp) / (2.0 * dt);
+   double imageLineRate = (_lineTimeTable.timeToLine(time + dt)
+                        - _lineTimeTable.timeToLine(time - dt)) / (2.0 * dt);
+
+   double pixel[6];
+   computeViewingPixel(time, ground_pt, _no_adjustment, pixel);
+
+   // The image line follows the viewing time, and the sample moves with
+   // the point both directly and through the time
+   for (int i = 0; i < 3; i++)
+   {
+      double dTime = -pixel[i] / lineRate;
+      partials[i] = imageLineRate * dTime;
+      partials[3 + i] = pixel[3 + i] + sampRate * dTime;
+   }
+}
+
 
 //***************************************************************************
 // UsgsAstroLsSensorModel::computeSensorPartials
@@ -728,8 +1288,27 @@ csm::RasterGM::SensorPartials UsgsAstroLsSensorModel::computeSensorPartials(
    std::vector<double> adj(UsgsAstroLsStateData::NUM_PARAMETERS, 0.0);
    adj[index] = DELTA;
 
-   csm::ImageCoord img1 = groundToImage(
-      ground_pt, adj, desired_precision, achieved_precision, warnings);
+   csm::ImageCoord img1;
+   double aPrec;
+   ProjectionStatus status = tryGroundToImage(
+      ground_pt, adj, img1, desired_precision, &aPrec);
+   if (status != PROJECTION_SUCCESS)
+   {
+      throwProjectionError(
+         status, "UsgsAstroLsSensorModel::computeSensorPartials");
+   }
+
+   if (achieved_precision)
+      *achieved_precision = aPrec;
+
+   if (warnings && (desired_precision > 0.0) && (aPrec > desired_precision))
+   {
+      warnings->push_back(
+         csm::Warning(
+            csm::Warning::PRECISION_NOT_MET,
+            "Desired precision not achieved.",
+            "UsgsAstroLsSensorModel::computeSensorPartials()"));
+   }
 
    double line_partial = (img1.line - image_pt.line) / DELTA;
    double sample_partial = (img1.samp - image_pt.samp) / DELTA;
@@ -780,6 +1359,148 @@ UsgsAstroLsSensorModel::computeAllSensorPartials(
    return partials;
 }
 
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeObservationPartials
+//***************************************************************************
+int UsgsAstroLsSensorModel::computeObservationPartials(
+   int                    n,
+   const csm::ImageCoord* image_pts,
+   const csm::EcefCoord*  ground_pts,
+   double*                residuals,
+   double*                sensor_partials,
+   int                    sensor_stride,
+   double*                ground_partials,
+   int                    ground_stride,
+   ProjectionStatus*      status,
+   csm::param::Set        pSet,
+   double                 desired_precision,
+   int                    num_threads) const
+{
+   const std::vector<int>& indices = getParameterSetIndices(pSet);
+   if (sensor_stride <= 0)
+      sensor_stride = indices.size();
+   if (ground_stride <= 0)
+      ground_stride = 3;
+
+   num_threads = UsgsAstroParallel::numThreads(
+      num_threads, n, MIN_OBSERVATIONS_PER_THREAD);
+
+   // Contiguous blocks of observations
+   std::vector<int> num_success(num_threads, 0);
+   UsgsAstroParallel::parallelFor(n, num_threads,
+      [&](int block, int first, int last)
+      {
+         num_success[block] = computeObservationPartials(
+            first, last, image_pts, ground_pts, indices,
+            residuals, sensor_partials, sensor_stride,
+            ground_partials, ground_stride, status, desired_precision);
+      });
+
+   int total = 0;
+   for (int t = 0; t < num_threads; t++)
+   {
+      total += num_success[t];
+   }
+   return total;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeObservationPartials (internal version)
+//***************************************************************************
+int UsgsAstroLsSensorModel::computeObservationPartials(
+   int                     first,
+   int                     last,
+   const csm::ImageCoord*  image_pts,
+   const csm::EcefCoord*   ground_pts,
+   const std::vector<int>& indices,
+   double*                 residuals,
+   double*                 sensor_partials,
+   int                     sensor_stride,
+   double*                 ground_partials,
+   int                     ground_stride,
+   ProjectionStatus*       status,
+   double                  desired_precision) const
+{
+   const double DELTA = _data.m_Gsd;
+   const int num = indices.size();
+   std::vector<double> adj(UsgsAstroLsStateData::NUM_PARAMETERS, 0.0);
+   int count = 0;
+   for (int i = first; i < last; i++)
+   {
+      double* line_sensor = sensor_partials
+                          ? sensor_partials + 2 * i * sensor_stride : NULL;
+      double* samp_sensor = sensor_partials
+                          ? line_sensor + sensor_stride : NULL;
+      double* line_ground = ground_partials
+                          ? ground_partials + 2 * i * ground_stride : NULL;
+      double* samp_ground = ground_partials
+                          ? line_ground + ground_stride : NULL;
+
+      // The solve of the observation itself gives the residual and the
+      // time and line resolution every perturbed solve starts from
+      const csm::EcefCoord& ground_pt = ground_pts[i];
+      SearchHint base;
+      csm::ImageCoord image_pt;
+      ProjectionStatus stat = tryGroundToImage(
+         ground_pt, _no_adjustment, image_pt, desired_precision, NULL,
+         &base);
+
+      for (int k = 0; k < num && stat == PROJECTION_SUCCESS; k++)
+      {
+         SearchHint hint = base;
+         csm::ImageCoord img1;
+         adj[indices[k]] = DELTA;
+         stat = tryGroundToImage(
+            ground_pt, adj, img1, desired_precision, NULL, &hint);
+         adj[indices[k]] = 0.0;
+         if (sensor_partials)
+         {
+            line_sensor[k] = (img1.line - image_pt.line) / DELTA;
+            samp_sensor[k] = (img1.samp - image_pt.samp) / DELTA;
+         }
+      }
+
+      if (ground_partials && stat == PROJECTION_SUCCESS)
+      {
+         double partials[6];
+         computeGroundPartials(ground_pt, base.time, partials);
+         std::copy(partials, partials + 3, line_ground);
+         std::copy(partials + 3, partials + 6, samp_ground);
+      }
+
+      if (stat == PROJECTION_SUCCESS)
+      {
+         if (residuals)
+         {
+            residuals[2 * i] = image_pts[i].line - image_pt.line;
+            residuals[2 * i + 1] = image_pts[i].samp - image_pt.samp;
+         }
+         count++;
+      }
+      else
+      {
+         if (residuals)
+         {
+            residuals[2 * i] = 0.0;
+            residuals[2 * i + 1] = 0.0;
+         }
+         if (sensor_partials)
+         {
+            std::fill(line_sensor, line_sensor + num, 0.0);
+            std::fill(samp_sensor, samp_sensor + num, 0.0);
+         }
+         if (ground_partials)
+         {
+            std::fill(line_ground, line_ground + 3, 0.0);
+            std::fill(samp_ground, samp_ground + 3, 0.0);
+         }
+      }
+      if (status)
+         status[i] = stat;
+   }
+   return count;
+}
+
 //***************************************************************************
 // UsgsAstroLsSensorModel::getParameterCovariance
 //***************************************************************************
@@ -815,6 +1536,14 @@ std::string UsgsAstroLsSensorModel::getTrajectoryIdentifier() const
    return _data.m_TrajectoryIdentifier;
 }
 
+//***************************************************************************
+// UsgsAstroLsSensorModel::getTrajectory
+//***************************************************************************
+const UsgsAstroLsTrajectory& UsgsAstroLsSensorModel::getTrajectory() const
+{
+   return *_trajectory;
+}
+
 //***************************************************************************
 // UsgsAstroLsSensorModel::getReferenceDateAndTime
 //***************************************************************************
@@ -847,16 +1576,7 @@ double UsgsAstroLsSensorModel::getImageTime(
 
    // These calculation assumes that the values in the integration time
    // vectors are in terms of ISIS' pixels
-   auto referenceLineIt = std::upper_bound(_data.m_IntTimeLines.begin(),
-                                           _data.m_IntTimeLines.end(),
-                                           lineUSGSFull);
-   if (referenceLineIt != _data.m_IntTimeLines.begin()) {
-      --referenceLineIt;
-   }
-   size_t referenceIndex = std::distance(_data.m_IntTimeLines.begin(), referenceLineIt);
-
-   double time = _data.m_IntTimeStartTimes[referenceIndex]
-      + _data.m_IntTimes[referenceIndex] * (lineUSGSFull - _data.m_IntTimeLines[referenceIndex]);
+   double time = _lineTimeTable.lineToTime(lineUSGSFull);
 
    return time;
 
@@ -913,6 +1633,58 @@ csm::EcefVector UsgsAstroLsSensorModel::getSensorVelocity(double time) const
 void UsgsAstroLsSensorModel::setParameterValue(int index, double value)
 {
    _data.m_ParameterVals[index] = value;
+   if (index == FOCAL_BIAS_INDEX && _useLookTable)
+   {
+      buildLookTable();
+   }
+   resetImageEnds();
+   resetSensorPartialsGrid();
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::applyParameterDeltas
+//***************************************************************************
+void UsgsAstroLsSensorModel::applyParameterDeltas(
+   const std::vector<double> &deltas)
+{
+   if (deltas.size() != (size_t)UsgsAstroLsStateData::NUM_PARAMETERS)
+   {
+      throw csm::Error(
+         csm::Error::INDEX_OUT_OF_RANGE,
+         "Expected one delta per adjustable parameter.",
+         "UsgsAstroLsSensorModel::applyParameterDeltas");
+   }
+
+   bool changed = false;
+   for (int i = 0; i < UsgsAstroLsStateData::NUM_PARAMETERS; i++)
+   {
+      if (deltas[i] != 0.0)
+      {
+         _data.m_ParameterVals[i] += deltas[i];
+         changed = true;
+      }
+   }
+
+   if (!changed)
+   {
+      return;
+   }
+
+   if (deltas[FOCAL_BIAS_INDEX] != 0.0 && _useLookTable)
+   {
+      buildLookTable();
+   }
+   resetImageEnds();
+   resetSensorPartialsGrid();
+
+   try
+   {
+      setLinearApproximation();
+   }
+   catch (...)
+   {
+      _linear = false;
+   }
 }
 
 //***************************************************************************
@@ -1062,7 +1834,9 @@ csm::ImageVector UsgsAstroLsSensorModel::getImageSize() const
 //***************************************************************************
 std::string UsgsAstroLsSensorModel::getModelState() const
 {
-   return _data.toJson();
+   UsgsAstroLsStateData state = _data;
+   _trajectory->toStateData(state);
+   return state.toJson();
 }
 
 //---------------------------------------------------------------------------
@@ -1178,109 +1952,513 @@ UsgsAstroLsSensorModel::getCorrelationModel() const
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::getUnmodeledCrossCovariance
+// UsgsAstroLsSensorModel::getUnmodeledCrossCovariance
+//***************************************************************************
+std::vector<double> UsgsAstroLsSensorModel::getUnmodeledCrossCovariance(
+   const csm::ImageCoord& pt1,
+   const csm::ImageCoord& pt2) const
+{
+   // No unmodeled error
+   return std::vector<double>(4, 0.0);
+}
+
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::getCollectionIdentifier
+//***************************************************************************
+std::string UsgsAstroLsSensorModel::getCollectionIdentifier() const
+{
+   return _data.m_CollectionIdentifier;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::hasShareableParameters
+//***************************************************************************
+bool UsgsAstroLsSensorModel::hasShareableParameters() const
+{
+   // Parameter sharing is not supported for this sensor
+   return false;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::isParameterShareable
+//***************************************************************************
+bool UsgsAstroLsSensorModel::isParameterShareable(int index) const
+{
+   // Parameter sharing is not supported for this sensor
+   return false;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::getParameterSharingCriteria
+//***************************************************************************
+csm::SharingCriteria UsgsAstroLsSensorModel::getParameterSharingCriteria(
+   int index) const
+{
+   // Parameter sharing is not supported for this sensor,
+   // all indices are out of range
+   throw csm::Error(
+      csm::Error::INDEX_OUT_OF_RANGE,
+      "Index out of range.",
+      "UsgsAstroLsSensorModel::getParameterSharingCriteria");
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::getSensorType
+//***************************************************************************
+std::string UsgsAstroLsSensorModel::getSensorType() const
+{
+   return CSM_SENSOR_TYPE_EO;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::getSensorMode
+//***************************************************************************
+std::string UsgsAstroLsSensorModel::getSensorMode() const
+{
+   return CSM_SENSOR_MODE_PB;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::getVersion
+//***************************************************************************
+csm::Version UsgsAstroLsSensorModel::getVersion() const
+{
+   return csm::Version(1, 0, 0);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::replaceModelState
+//***************************************************************************
+void UsgsAstroLsSensorModel::replaceModelState(const std::string& argState)
+{
+   set(argState);
+}
+
+
+csm::Ellipsoid UsgsAstroLsSensorModel::getEllipsoid() const
+{
+   return csm::Ellipsoid(_data.m_SemiMajorAxis, _data.m_SemiMinorAxis);
+}
+
+void UsgsAstroLsSensorModel::setEllipsoid(
+   const csm::Ellipsoid &ellipsoid)
+{
+   _data.m_SemiMajorAxis = ellipsoid.getSemiMajorRadius();
+   _data.m_SemiMinorAxis = ellipsoid.getSemiMinorRadius();
+   _geodesy = UsgsAstroGeodesy(_data.m_SemiMajorAxis, _data.m_SemiMinorAxis);
+   resetSensorPartialsGrid();
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::setIterativeGeodesy
+//***************************************************************************
+void UsgsAstroLsSensorModel::setIterativeGeodesy(bool iterative)
+{
+   _iterativeGeodesy = iterative;
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::setLookVectorTable
+//***************************************************************************
+void UsgsAstroLsSensorModel::setLookVectorTable(bool enable)
+{
+   _useLookTable = enable;
+   _lookTable.clear();
+   if (_useLookTable)
+   {
+      buildLookTable();
+   }
+}
+
+
+
+double UsgsAstroLsSensorModel::getValue(
+   int   index,
+   const std::vector<double> &adjustments) const
+{
+   return _data.m_ParameterVals[index] + adjustments[index];
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::bindKernels
+//***************************************************************************
+void UsgsAstroLsSensorModel::bindKernels()
+{
+   // Sensor position and velocity use 4th or 8th order Lagrange, the
+   // attitude drops to 4th when there are too few quaternions for 8th.
+   // The attitude comes straight from the trajectory as a rotation.
+   if (_data.m_PlatformFlag == 0)
+   {
+      _positionVelocityKernel = &UsgsAstroLsTrajectory::getPositionVelocity<4>;
+      _rotationKernel = &UsgsAstroLsTrajectory::getRotationMatrix<4>;
+   }
+   else
+   {
+      _positionVelocityKernel = &UsgsAstroLsTrajectory::getPositionVelocity<8>;
+      if (_trajectory->getNumQuaternions() < 6)
+         _rotationKernel = &UsgsAstroLsTrajectory::getRotationMatrix<4>;
+      else
+         _rotationKernel = &UsgsAstroLsTrajectory::getRotationMatrix<8>;
+   }
+
+   // The Hermite ephemeris replaces Lagrange when the state selects it
+   if (_data.m_EphemInterpFlag == 1)
+   {
+      _positionVelocityKernel =
+         &UsgsAstroLsTrajectory::getHermitePositionVelocity;
+   }
+
+   // Distortion along the detector only for the LRO NAC, radial otherwise
+   switch (_data.m_IkCode)
+   {
+   case -85610:
+   case -85600:
+      _distortion = UsgsAstroDistortion::create("TRANSVERSE",
+         std::vector<double>(1, _data.m_OpticalDistCoef[0]));
+      break;
+
+   default:
+      if (_data.m_OpticalDistCoef[0] != 0.0 ||
+         _data.m_OpticalDistCoef[1] != 0.0 ||
+         _data.m_OpticalDistCoef[2] != 0.0)
+      {
+         _distortion = UsgsAstroDistortion::create("RADIAL",
+            std::vector<double>(_data.m_OpticalDistCoef,
+                                _data.m_OpticalDistCoef + 3));
+      }
+      else
+      {
+         _distortion = UsgsAstroDistortion::create("NONE",
+            std::vector<double>());
+      }
+      break;
+   }
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeDetectorLook
+//***************************************************************************
+void UsgsAstroLsSensorModel::computeDetectorLook(
+   const double& sampleUSGSFull, // USGS image convention
+   const double& fractionalLine, // line offset from the pixel center
+   const double& focalBias,      // focal bias parameter value
+   double        losApl[3]) const // output look vector, boresight frame
+{
+   // Compute distorted image coordinates in mm
+
+   double isisDetSample = (sampleUSGSFull - 1.0)
+      * _data.m_DetectorSampleSumming + _data.m_StartingSample;
+   double m11 = _data.m_ITransL[1];
+   double m12 = _data.m_ITransL[2];
+   double m21 = _data.m_ITransS[1];
+   double m22 = _data.m_ITransS[2];
+   double t1 = fractionalLine + _data.m_DetectorLineOffset
+               - _data.m_DetectorLineOrigin - _data.m_ITransL[0];
+   double t2 = isisDetSample - _data.m_DetectorSampleOrigin - _data.m_ITransS[0];
+   double determinant = m11 * m22 - m12 * m21;
+   double p11 = m11 / determinant;
+   double p12 = -m12 / determinant;
+   double p21 = -m21 / determinant;
+   double p22 = m22 / determinant;
+   double isisNatFocalPlaneX = p11 * t1 + p12 * t2;
+   double isisNatFocalPlaneY = p21 * t1 + p22 * t2;
+
+   // Remove lens distortion
+   double isisFocalPlaneX, isisFocalPlaneY;
+   _distortion->undistort(isisNatFocalPlaneX, isisNatFocalPlaneY,
+      isisFocalPlaneX, isisFocalPlaneY);
+
+   // Define imaging ray in image space
+
+   double losIsis[3];
+   losIsis[0] = -isisFocalPlaneX * _data.m_IsisZDirection;
+   losIsis[1] = -isisFocalPlaneY * _data.m_IsisZDirection;
+   losIsis[2] = -_data.m_Focal * (1.0 - focalBias / _data.m_HalfSwath);
+   double isisMag = sqrt(losIsis[0] * losIsis[0]
+      + losIsis[1] * losIsis[1]
+      + losIsis[2] * losIsis[2]);
+   losIsis[0] /= isisMag;
+   losIsis[1] /= isisMag;
+   losIsis[2] /= isisMag;
+
+   // Apply boresight correction
+
+   losApl[0] =
+      _data.m_MountingMatrix[0] * losIsis[0]
+      + _data.m_MountingMatrix[1] * losIsis[1]
+      + _data.m_MountingMatrix[2] * losIsis[2];
+   losApl[1] =
+      _data.m_MountingMatrix[3] * losIsis[0]
+      + _data.m_MountingMatrix[4] * losIsis[1]
+      + _data.m_MountingMatrix[5] * losIsis[2];
+   losApl[2] =
+      _data.m_MountingMatrix[6] * losIsis[0]
+      + _data.m_MountingMatrix[7] * losIsis[1]
+      + _data.m_MountingMatrix[8] * losIsis[2];
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::buildLookTable
 //***************************************************************************
-std::vector<double> UsgsAstroLsSensorModel::getUnmodeledCrossCovariance(
-   const csm::ImageCoord& pt1,
-   const csm::ImageCoord& pt2) const
+void UsgsAstroLsSensorModel::buildLookTable()
 {
-   // No unmodeled error
-   return std::vector<double>(4, 0.0);
+   // Nodes at every whole USGS sample of the image from 0 through one past
+   // the last, offset into the full image by the sample offset as the
+   // looks are computed, so every sample of the image falls between two
+   // nodes.  Each node holds the look vector at the pixel center and its
+   // rate of change with the fractional line.
+   int numNodes = _data.m_TotalSamples + 2;
+   double focalBias = _data.m_ParameterVals[FOCAL_BIAS_INDEX];
+   _lookTable.resize(6 * numNodes);
+   for (int j = 0; j < numNodes; j++)
+   {
+      double* node = &_lookTable[6 * j];
+      double sampleUSGSFull = j + _data.m_OffsetSamples;
+      double before[3], after[3];
+      computeDetectorLook(sampleUSGSFull, 0.0, focalBias, node);
+      computeDetectorLook(sampleUSGSFull, -0.5, focalBias, before);
+      computeDetectorLook(sampleUSGSFull, 0.5, focalBias, after);
+      node[3] = after[0] - before[0];
+      node[4] = after[1] - before[1];
+      node[5] = after[2] - before[2];
+   }
 }
 
-
 //***************************************************************************
-// UsgsAstroLsSensorModel::getCollectionIdentifier
+// UsgsAstroLsSensorModel::buildImageEnds
 //***************************************************************************
-std::string UsgsAstroLsSensorModel::getCollectionIdentifier() const
+std::shared_ptr<const UsgsAstroLsSensorModel::ImageEnds>
+UsgsAstroLsSensorModel::buildImageEnds() const
 {
-   return _data.m_CollectionIdentifier;
+   // The times at which the line search starts
+   double sampCtr = _data.m_TotalSamples / 2.0;
+   std::shared_ptr<ImageEnds> ends = std::make_shared<ImageEnds>();
+   computeTimeOrientation(
+      getImageTime(csm::ImageCoord(0.0, sampCtr)),
+      _no_adjustment, ends->first);
+   computeTimeOrientation(
+      getImageTime(csm::ImageCoord(_data.m_TotalLines, sampCtr)),
+      _no_adjustment, ends->last);
+   return ends;
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::hasShareableParameters
+// UsgsAstroLsSensorModel::getImageEnds
 //***************************************************************************
-bool UsgsAstroLsSensorModel::hasShareableParameters() const
+std::shared_ptr<const UsgsAstroLsSensorModel::ImageEnds>
+UsgsAstroLsSensorModel::getImageEnds() const
 {
-   // Parameter sharing is not supported for this sensor
-   return false;
+   // Concurrent callers may both build the ends; they build the same ones.
+   std::shared_ptr<const ImageEnds> ends = std::atomic_load(&_imageEnds);
+   if (!ends)
+   {
+      ends = buildImageEnds();
+      std::atomic_store(&_imageEnds, ends);
+   }
+   return ends;
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::isParameterShareable
+// UsgsAstroLsSensorModel::resetImageEnds
 //***************************************************************************
-bool UsgsAstroLsSensorModel::isParameterShareable(int index) const
+void UsgsAstroLsSensorModel::resetImageEnds()
 {
-   // Parameter sharing is not supported for this sensor
-   return false;
+   std::atomic_store(&_imageEnds, std::shared_ptr<const ImageEnds>());
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::getParameterSharingCriteria
+// UsgsAstroLsSensorModel::buildSensorPartialsGrid
 //***************************************************************************
-csm::SharingCriteria UsgsAstroLsSensorModel::getParameterSharingCriteria(
-   int index) const
+std::shared_ptr<const std::vector<double> >
+UsgsAstroLsSensorModel::buildSensorPartialsGrid() const
 {
-   // Parameter sharing is not supported for this sensor,
-   // all indices are out of range
-   throw csm::Error(
-      csm::Error::INDEX_OUT_OF_RANGE,
-      "Index out of range.",
-      "UsgsAstroLsSensorModel::getParameterSharingCriteria");
-}
+   const int num = UsgsAstroLsStateData::NUM_PARAMETERS;
+   const int size = SENSOR_PARTIALS_GRID_SIZE;
+   int numHeights = _data.m_MaxElevation > _data.m_MinElevation ? 2 : 1;
+   int numNodes = numHeights * size * size;
 
-//***************************************************************************
-// UsgsAstroLsSensorModel::getSensorType
-//***************************************************************************
-std::string UsgsAstroLsSensorModel::getSensorType() const
-{
-   return CSM_SENSOR_TYPE_EO;
+   std::vector<int> indices(num);
+   for (int k = 0; k < num; k++)
+   {
+      indices[k] = k;
+   }
+
+   std::vector<csm::ImageCoord> imagePts(numNodes);
+   std::vector<csm::EcefCoord> groundPts(numNodes);
+   for (int k = 0; k < numHeights; k++)
+   {
+      double height = k == 0 ? _data.m_MinElevation : _data.m_MaxElevation;
+      for (int i = 0; i < size; i++)
+      {
+         for (int j = 0; j < size; j++)
+         {
+            int node = (k * size + i) * size + j;
+            imagePts[node] = csm::ImageCoord(
+               0.5 + i * (_data.m_TotalLines - 1.0) / (size - 1.0),
+               0.5 + j * (_data.m_TotalSamples - 1.0) / (size - 1.0));
+            if (tryImageToGround(imagePts[node], height, groundPts[node])
+                != PROJECTION_SUCCESS)
+            {
+               return std::make_shared<const std::vector<double> >();
+            }
+         }
+      }
+   }
+
+   std::vector<double> grid(2 * num * numNodes);
+   std::vector<ProjectionStatus> status(numNodes);
+   int numSuccess = computeObservationPartials(
+      0, numNodes, &imagePts[0], &groundPts[0], indices, NULL,
+      &grid[0], num, NULL, 0, &status[0], 0.001);
+   if (numSuccess < numNodes)
+   {
+      grid.clear();
+   }
+   return std::make_shared<const std::vector<double> >(grid);
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::getSensorMode
+// UsgsAstroLsSensorModel::getSensorPartialsGrid
 //***************************************************************************
-std::string UsgsAstroLsSensorModel::getSensorMode() const
+std::shared_ptr<const std::vector<double> >
+UsgsAstroLsSensorModel::getSensorPartialsGrid() const
 {
-   return CSM_SENSOR_MODE_PB;
+   // Concurrent callers may both build the grid; they build the same one.
+   std::shared_ptr<const std::vector<double> > grid =
+      std::atomic_load(&_sensorPartialsGrid);
+   if (!grid)
+   {
+      grid = buildSensorPartialsGrid();
+      std::atomic_store(&_sensorPartialsGrid, grid);
+   }
+   return grid;
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::getVersion
+// UsgsAstroLsSensorModel::resetSensorPartialsGrid
 //***************************************************************************
-csm::Version UsgsAstroLsSensorModel::getVersion() const
+void UsgsAstroLsSensorModel::resetSensorPartialsGrid()
 {
-   return csm::Version(1, 0, 0);
+   std::atomic_store(
+      &_sensorPartialsGrid, std::shared_ptr<const std::vector<double> >());
 }
 
 //***************************************************************************
-// UsgsAstroLsSensorModel::replaceModelState
+// UsgsAstroLsSensorModel::interpolateSensorCovariance
 //***************************************************************************
-void UsgsAstroLsSensorModel::replaceModelState(const std::string& argState)
+bool UsgsAstroLsSensorModel::interpolateSensorCovariance(
+   const csm::ImageCoord& image_pt,
+   double                 height,
+   double                 sensor_cov[4]) const
 {
-   set(argState);
-}
+   std::shared_ptr<const std::vector<double> > grid = getSensorPartialsGrid();
+   if (grid->empty())
+   {
+      return false;
+   }
 
+   // Trilinear interpolation, within the grid only; the caller computes
+   // the partials exactly elsewhere
+   const int num = UsgsAstroLsStateData::NUM_PARAMETERS;
+   const int size = SENSOR_PARTIALS_GRID_SIZE;
+   int numHeights = _data.m_MaxElevation > _data.m_MinElevation ? 2 : 1;
+   double u = (image_pt.line - 0.5) / (_data.m_TotalLines - 1.0) * (size - 1);
+   double v = (image_pt.samp - 0.5) / (_data.m_TotalSamples - 1.0) * (size - 1);
+   double w = numHeights == 2
+            ? (height - _data.m_MinElevation)
+              / (_data.m_MaxElevation - _data.m_MinElevation)
+            : 0.0;
+   if (!(u >= 0.0 && u <= size - 1.0 && v >= 0.0 && v <= size - 1.0 &&
+         w >= 0.0 && w <= 1.0) ||
+       (numHeights == 1 && height != _data.m_MinElevation))
+   {
+      return false;
+   }
+   int i = std::min(size - 2, (int)u);
+   int j = std::min(size - 2, (int)v);
+   u -= i;
+   v -= j;
 
-csm::Ellipsoid UsgsAstroLsSensorModel::getEllipsoid() const
-{
-   return csm::Ellipsoid(_data.m_SemiMajorAxis, _data.m_SemiMinorAxis);
-}
+   double partials[2 * UsgsAstroLsStateData::NUM_PARAMETERS] = { 0.0 };
+   for (int k = 0; k < numHeights; k++)
+   {
+      double wk = k == 0 ? (numHeights == 2 ? 1.0 - w : 1.0) : w;
+      for (int di = 0; di < 2; di++)
+      {
+         for (int dj = 0; dj < 2; dj++)
+         {
+            double weight = wk * (di ? u : 1.0 - u) * (dj ? v : 1.0 - v);
+            const double* node =
+               &(*grid)[2 * num * ((k * size + i + di) * size + j + dj)];
+            for (int p = 0; p < 2 * num; p++)
+            {
+               partials[p] += weight * node[p];
+            }
+         }
+      }
+   }
 
-void UsgsAstroLsSensorModel::setEllipsoid(
-   const csm::Ellipsoid &ellipsoid)
-{
-   _data.m_SemiMajorAxis = ellipsoid.getSemiMajorRadius();
-   _data.m_SemiMinorAxis = ellipsoid.getSemiMinorRadius();
+   const double* linePartials = partials;
+   const double* sampPartials = partials + num;
+   sensor_cov[0] = 0.0;
+   sensor_cov[1] = 0.0;
+   sensor_cov[2] = 0.0;
+   sensor_cov[3] = 0.0;
+   for (int p = 0; p < num; p++)
+   {
+      double lineCov = 0.0;
+      double sampCov = 0.0;
+      for (int q = 0; q < num; q++)
+      {
+         double covariance = _data.m_Covariance[num * p + q];
+         lineCov += covariance * linePartials[q];
+         sampCov += covariance * sampPartials[q];
+      }
+      sensor_cov[0] += linePartials[p] * lineCov;
+      sensor_cov[1] += sampPartials[p] * lineCov;
+      sensor_cov[2] += linePartials[p] * sampCov;
+      sensor_cov[3] += sampPartials[p] * sampCov;
+   }
+   return true;
 }
 
+//***************************************************************************
+// UsgsAstroLsSensorModel::interpolateLookTable
+//***************************************************************************
+bool UsgsAstroLsSensorModel::interpolateLookTable(
+   const double& sampleUSGSFull,
+   const double& fractionalLine,
+   double        losApl[3]) const
+{
+   // The table starts at the sample offset of the image
+   double sampleUSGS = sampleUSGSFull - _data.m_OffsetSamples;
+   double fndex = floor(sampleUSGS);
+   int numNodes = (int)_lookTable.size() / 6;
+   if (fndex < 0.0 || fndex > numNodes - 2)
+   {
+      return false;
+   }
 
+   int index = (int)fndex;
+   double w1 = sampleUSGS - fndex;
+   double w0 = 1.0 - w1;
+   const double* n0 = &_lookTable[6 * index];
+   const double* n1 = n0 + 6;
+   for (int k = 0; k < 3; k++)
+   {
+      losApl[k] = w0 * (n0[k] + fractionalLine * n0[k + 3])
+                + w1 * (n1[k] + fractionalLine * n1[k + 3]);
+   }
 
-double UsgsAstroLsSensorModel::getValue(
-   int   index,
-   const std::vector<double> &adjustments) const
-{
-   return _data.m_ParameterVals[index] + adjustments[index];
+   // Back to a unit vector, as computeDetectorLook gives
+   double mag = sqrt(losApl[0] * losApl[0]
+      + losApl[1] * losApl[1]
+      + losApl[2] * losApl[2]);
+   losApl[0] /= mag;
+   losApl[1] /= mag;
+   losApl[2] /= mag;
+   return true;
 }
 
 //***************************************************************************
@@ -1303,95 +2481,46 @@ void UsgsAstroLsSensorModel::losToEcf(
    //# private_func_description
    //  Computes image ray in ecf coordinate system.
 
-   // Compute adjusted sensor position and velocity
-
-   double time = getImageTime(csm::ImageCoord(line, sample));
-   getAdjSensorPosVel(time, adj, xc, yc, zc, vx, vy, vz);
-   // CSM image image convention: UL pixel center == (0.5, 0.5)
-   // USGS image convention: UL pixel center == (1.0, 1.0)
-
-   double sampleCSMFull = sample + _data.m_OffsetSamples;
-   double sampleUSGSFull = sampleCSMFull + 0.5;
-   double fractionalLine = line - floor(line) - 0.5;
-
-   // Compute distorted image coordinates in mm
-
-   double isisDetSample = (sampleUSGSFull - 1.0)
-      * _data.m_DetectorSampleSumming + _data.m_StartingSample;
-   double m11 = _data.m_ITransL[1];
-   double m12 = _data.m_ITransL[2];
-   double m21 = _data.m_ITransS[1];
-   double m22 = _data.m_ITransS[2];
-   double t1 = fractionalLine + _data.m_DetectorLineOffset
-               - _data.m_DetectorLineOrigin - _data.m_ITransL[0];
-   double t2 = isisDetSample - _data.m_DetectorSampleOrigin - _data.m_ITransS[0];
-   double determinant = m11 * m22 - m12 * m21;
-   double p11 = m11 / determinant;
-   double p12 = -m12 / determinant;
-   double p21 = -m21 / determinant;
-   double p22 = m22 / determinant;
-   double isisNatFocalPlaneX = p11 * t1 + p12 * t2;
-   double isisNatFocalPlaneY = p21 * t1 + p22 * t2;
-
-   // Remove lens distortion
-   double isisFocalPlaneX = isisNatFocalPlaneX;
-   double isisFocalPlaneY = isisNatFocalPlaneY;
-   switch (_data.m_IkCode)
-   {
-   case -85610:
-   case -85600:
-      isisFocalPlaneY = isisNatFocalPlaneY / (1.0 + _data.m_OpticalDistCoef[0]
-         * isisNatFocalPlaneY * isisNatFocalPlaneY);
-      break;
-
-   default:
-      if (_data.m_OpticalDistCoef[0] != 0.0 ||
-         _data.m_OpticalDistCoef[1] != 0.0 ||
-         _data.m_OpticalDistCoef[2] != 0.0)
-      {
-         double rr = isisNatFocalPlaneX * isisNatFocalPlaneX
-            + isisNatFocalPlaneY * isisNatFocalPlaneY;
-         if (rr > 1.0E-6)
-         {
-            double dr = _data.m_OpticalDistCoef[0] + (rr * (_data.m_OpticalDistCoef[1]
-               + rr * _data.m_OpticalDistCoef[2]));
-            isisFocalPlaneX = isisNatFocalPlaneX * (1.0 - dr);
-            isisFocalPlaneY = isisNatFocalPlaneY * (1.0 - dr);
-         }
-      }
-      break;
-   }
-
-   // Define imaging ray in image space
+   LineOrientation orientation;
+   computeLineOrientation(line, adj, orientation);
+   xc = orientation.position[0];
+   yc = orientation.position[1];
+   zc = orientation.position[2];
+   vx = orientation.velocity[0];
+   vy = orientation.velocity[1];
+   vz = orientation.velocity[2];
+   lineLosToEcf(orientation, line, sample, adj, xl, yl, zl);
+}
 
-   double losIsis[3];
-   losIsis[0] = -isisFocalPlaneX * _data.m_IsisZDirection;
-   losIsis[1] = -isisFocalPlaneY * _data.m_IsisZDirection;
-   losIsis[2] = -_data.m_Focal * (1.0 - getValue(15, adj) / _data.m_HalfSwath);
-   double isisMag = sqrt(losIsis[0] * losIsis[0]
-      + losIsis[1] * losIsis[1]
-      + losIsis[2] * losIsis[2]);
-   losIsis[0] /= isisMag;
-   losIsis[1] /= isisMag;
-   losIsis[2] /= isisMag;
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeLineOrientation
+//***************************************************************************
+void UsgsAstroLsSensorModel::computeLineOrientation(
+   const double& line,
+   const std::vector<double>& adj,
+   LineOrientation& orientation) const
+{
+   computeTimeOrientation(
+      getImageTime(csm::ImageCoord(line, 0.0)), adj, orientation);
+}
 
-   // Apply boresight correction
+//***************************************************************************
+// UsgsAstroLsSensorModel::computeTimeOrientation
+//***************************************************************************
+void UsgsAstroLsSensorModel::computeTimeOrientation(
+   const double& time,
+   const std::vector<double>& adj,
+   LineOrientation& orientation) const
+{
+   // Compute adjusted sensor position and velocity
 
-   double losApl[3];
-   losApl[0] =
-      _data.m_MountingMatrix[0] * losIsis[0]
-      + _data.m_MountingMatrix[1] * losIsis[1]
-      + _data.m_MountingMatrix[2] * losIsis[2];
-   losApl[1] =
-      _data.m_MountingMatrix[3] * losIsis[0]
-      + _data.m_MountingMatrix[4] * losIsis[1]
-      + _data.m_MountingMatrix[5] * losIsis[2];
-   losApl[2] =
-      _data.m_MountingMatrix[6] * losIsis[0]
-      + _data.m_MountingMatrix[7] * losIsis[1]
-      + _data.m_MountingMatrix[8] * losIsis[2];
+   orientation.time = time;
+   getAdjSensorPosVel(time, adj,
+      orientation.position[0], orientation.position[1],
+      orientation.position[2], orientation.velocity[0],
+      orientation.velocity[1], orientation.velocity[2]);
 
-   // Apply attitude correction
+   // Attitude correction
 
    double aTime = time - _data.m_T0Quat;
    double euler[3];
@@ -1409,7 +2538,7 @@ void UsgsAstroLsSensorModel::losToEcf(
    double sin_b = sin(euler[1]);
    double cos_c = cos(euler[2]);
    double sin_c = sin(euler[2]);
-   double plFromApl[9];
+   double* plFromApl = orientation.plFromApl;
    plFromApl[0] = cos_b * cos_c;
    plFromApl[1] = -cos_a * sin_c + sin_a * sin_b * cos_c;
    plFromApl[2] = sin_a * sin_c + cos_a * sin_b * cos_c;
@@ -1419,6 +2548,42 @@ void UsgsAstroLsSensorModel::losToEcf(
    plFromApl[6] = -sin_b;
    plFromApl[7] = sin_a * cos_b;
    plFromApl[8] = cos_a * cos_b;
+
+   // Rotation matrix from sensor quaternions
+
+   ((*_trajectory).*_rotationKernel)(time, orientation.ecfFromPl);
+}
+
+//***************************************************************************
+// UsgsAstroLsSensorModel::lineLosToEcf
+//***************************************************************************
+void UsgsAstroLsSensorModel::lineLosToEcf(
+   const LineOrientation& orientation,
+   const double& line,
+   const double& sample,
+   const std::vector<double>& adj,
+   double& xl,
+   double& yl,
+   double& zl) const
+{
+   // CSM image image convention: UL pixel center == (0.5, 0.5)
+   // USGS image convention: UL pixel center == (1.0, 1.0)
+
+   double sampleCSMFull = sample + _data.m_OffsetSamples;
+   double sampleUSGSFull = sampleCSMFull + 0.5;
+   double fractionalLine = line - floor(line) - 0.5;
+
+   double losApl[3];
+   if (_lookTable.empty() || adj[FOCAL_BIAS_INDEX] != 0.0 ||
+       !interpolateLookTable(sampleUSGSFull, fractionalLine, losApl))
+   {
+      computeDetectorLook(sampleUSGSFull, fractionalLine,
+                          getValue(FOCAL_BIAS_INDEX, adj), losApl);
+   }
+
+   // Apply attitude correction
+
+   const double* plFromApl = orientation.plFromApl;
    double losPl[3];
    losPl[0] = plFromApl[0] * losApl[0] + plFromApl[1] * losApl[1]
       + plFromApl[2] * losApl[2];
@@ -1429,31 +2594,7 @@ void UsgsAstroLsSensorModel::losToEcf(
 
    // Apply rotation matrix from sensor quaternions
 
-   int nOrder = 8;
-   if (_data.m_PlatformFlag == 0)
-      nOrder = 4;
-   int nOrderQuat = nOrder;
-   if (_data.m_NumQuaternions < 6 && nOrder == 8)
-      nOrderQuat = 4;
-   double q[4];
-   lagrangeInterp(
-      _data.m_NumQuaternions, &_data.m_Quaternions[0], _data.m_T0Quat, _data.m_DtQuat,
-      time, 4, nOrderQuat, q);
-   double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
-   q[0] /= norm;
-   q[1] /= norm;
-   q[2] /= norm;
-   q[3] /= norm;
-   double ecfFromPl[9];
-   ecfFromPl[0] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
-   ecfFromPl[1] = 2 * (q[0] * q[1] - q[2] * q[3]);
-   ecfFromPl[2] = 2 * (q[0] * q[2] + q[1] * q[3]);
-   ecfFromPl[3] = 2 * (q[0] * q[1] + q[2] * q[3]);
-   ecfFromPl[4] = -q[0] * q[0] + q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
-   ecfFromPl[5] = 2 * (q[1] * q[2] - q[0] * q[3]);
-   ecfFromPl[6] = 2 * (q[0] * q[2] - q[1] * q[3]);
-   ecfFromPl[7] = 2 * (q[1] * q[2] + q[0] * q[3]);
-   ecfFromPl[8] = -q[0] * q[0] - q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+   const double* ecfFromPl = orientation.ecfFromPl;
    xl = ecfFromPl[0] * losPl[0] + ecfFromPl[1] * losPl[1]
       + ecfFromPl[2] * losPl[2];
    yl = ecfFromPl[3] * losPl[0] + ecfFromPl[4] * losPl[1]
@@ -1515,136 +2656,6 @@ void UsgsAstroLsSensorModel::lightAberrationCorr(
    dzl = cfac * vz;
 }
 
-//***************************************************************************
-// UsgsAstroLsSensorModel::lagrangeInterp
-//***************************************************************************
-void UsgsAstroLsSensorModel::lagrangeInterp(
-   const int&     numTime,
-   const double*  valueArray,
-   const double&  startTime,
-   const double&  delTime,
-   const double&  time,
-   const int&     vectorLength,
-   const int&     i_order,
-   double*        valueVector) const
-{
-   // Lagrange interpolation for uniform post interval.
-   // Largest order possible is 8th. Points far away from
-   // data center are handled gracefully to avoid failure.
-
-   // Compute index
-
-   double fndex = (time - startTime) / delTime;
-   int    index = int(fndex);
-
-   //Time outside range
-   //printf("%f | %i\n", fndex, index);
-   //if (index < 0 || index >= numTime - 1) {
-   //    printf("TIME ISSUE\n");
-   // double d1 = fndex / (numTime - 1);
-   // double d0 = 1.0 - d1;
-   // int indx0 = vectorLength * (numTime - 1);
-   // for (int i = 0; i < vectorLength; i++)
-   // {
-   // valueVector[i] = d0 * valueArray[i] + d1 * valueArray[indx0 + i];
-   // }
-   // return;
-   //}
-
-   if (index < 0)
-   {
-      index = 0;
-   }
-   if (index > numTime - 2)
-   {
-      index = numTime - 2;
-   }
-
-   // Define order, max is 8
-
-   int order;
-   if (index >= 3 && index < numTime - 4) {
-      order = 8;
-   }
-   else if (index == 2 || index == numTime - 4) {
-      order = 6;
-   }
-   else if (index == 1 || index == numTime - 3) {
-      order = 4;
-   }
-   else if (index == 0 || index == numTime - 2) {
-      order = 2;
-   }
-   if (order > i_order) {
-      order = i_order;
-   }
-
-   // Compute interpolation coefficients
-   double tp3, tp2, tp1, tm1, tm2, tm3, tm4, d[8];
-   double tau = fndex - index;
-   if (order == 2) {
-      tm1 = tau - 1;
-      d[0] = -tm1;
-      d[1] = tau;
-   }
-   else if (order == 4) {
-      tp1 = tau + 1;
-      tm1 = tau - 1;
-      tm2 = tau - 2;
-      d[0] = -tau * tm1 * tm2 / 6.0;
-      d[1] = tp1 *       tm1 * tm2 / 2.0;
-      d[2] = -tp1 * tau *       tm2 / 2.0;
-      d[3] = tp1 * tau * tm1 / 6.0;
-   }
-   else if (order == 6) {
-      tp2 = tau + 2;
-      tp1 = tau + 1;
-      tm1 = tau - 1;
-      tm2 = tau - 2;
-      tm3 = tau - 3;
-      d[0] = -tp1 * tau * tm1 * tm2 * tm3 / 120.0;
-      d[1] = tp2 *       tau * tm1 * tm2 * tm3 / 24.0;
-      d[2] = -tp2 * tp1 *       tm1 * tm2 * tm3 / 12.0;
-      d[3] = tp2 * tp1 * tau *       tm2 * tm3 / 12.0;
-      d[4] = -tp2 * tp1 * tau * tm1 *       tm3 / 24.0;
-      d[5] = tp2 * tp1 * tau * tm1 * tm2 / 120.0;
-   }
-   else if (order == 8) {
-      tp3 = tau + 3;
-      tp2 = tau + 2;
-      tp1 = tau + 1;
-      tm1 = tau - 1;
-      tm2 = tau - 2;
-      tm3 = tau - 3;
-      tm4 = tau - 4;
-      // Why are the denominators hard coded, as it should be x[0] - x[i]
-      d[0] = -tp2 * tp1 * tau * tm1 * tm2 * tm3 * tm4 / 5040.0;
-      d[1] = tp3 *       tp1 * tau * tm1 * tm2 * tm3 * tm4 / 720.0;
-      d[2] = -tp3 * tp2 *       tau * tm1 * tm2 * tm3 * tm4 / 240.0;
-      d[3] = tp3 * tp2 * tp1 *       tm1 * tm2 * tm3 * tm4 / 144.0;
-      d[4] = -tp3 * tp2 * tp1 * tau *       tm2 * tm3 * tm4 / 144.0;
-      d[5] = tp3 * tp2 * tp1 * tau * tm1 *       tm3 * tm4 / 240.0;
-      d[6] = -tp3 * tp2 * tp1 * tau * tm1 * tm2 *       tm4 / 720.0;
-      d[7] = tp3 * tp2 * tp1 * tau * tm1 * tm2 * tm3 / 5040.0;
-   }
-
-   // Compute interpolated point
-   int    indx0 = index - order / 2 + 1;
-   for (int i = 0; i < vectorLength; i++)
-   {
-      valueVector[i] = 0.0;
-   }
-
-   for (int i = 0; i < order; i++)
-   {
-      int jndex = vectorLength * (indx0 + i);
-      for (int j = 0; j < vectorLength; j++)
-      {
-         valueVector[j] += d[i] * valueArray[jndex + j];
-      }
-   }
-}
-
 //***************************************************************************
 // UsgsAstroLsSensorModel::computeElevation
 //***************************************************************************
@@ -1656,6 +2667,14 @@ void UsgsAstroLsSensorModel::computeElevation(
    double&       achieved_precision,
    const double& desired_precision) const
 {
+   double latitude;
+   if (!_iterativeGeodesy &&
+       _geodesy.toGeodetic(x, y, z, latitude, height))
+   {
+      achieved_precision = 0.0;
+      return;
+   }
+
    // Compute elevation given xyz
    // Requires semi-major-axis and eccentricity-square
    const int MKTR = 10;
@@ -1710,7 +2729,7 @@ void UsgsAstroLsSensorModel::computeElevation(
 //***************************************************************************
 // UsgsAstroLsSensorModel::losEllipsoidIntersect
 //**************************************************************************
-void UsgsAstroLsSensorModel::losEllipsoidIntersect(
+bool UsgsAstroLsSensorModel::losEllipsoidIntersect(
    const double& height,
    const double& xc,
    const double& yc,
@@ -1728,6 +2747,15 @@ void UsgsAstroLsSensorModel::losEllipsoidIntersect(
    // with the ellipsoid.  All vectors are in earth-centered-fixed
    // coordinate system with origin at the center of the earth.
 
+   bool missed;
+   if (!_iterativeGeodesy &&
+       _geodesy.intersect(height, xc, yc, zc, xl, yl, zl, x, y, z,
+                          achieved_precision, desired_precision,
+                          &missed) >= 0)
+   {
+      return !missed;
+   }
+
    const int MKTR = 10;
 
    double ap, bp, k;
@@ -1749,7 +2777,8 @@ void UsgsAstroLsSensorModel::losEllipsoidIntersect(
    // zero means solving for a point on the ray nearest
    // the surface of the ellisoid.
 
-   if (0.0 > quadTerm)
+   missed = 0.0 > quadTerm;
+   if (missed)
    {
       quadTerm = 0.0;
    }
@@ -1786,6 +2815,7 @@ void UsgsAstroLsSensorModel::losEllipsoidIntersect(
    }
 
    achieved_precision = fabs(height - h);
+   return !missed;
 }
 
 //***************************************************************************
@@ -1906,15 +2936,9 @@ void UsgsAstroLsSensorModel::getAdjSensorPosVel(
    double&       vz) const
 {
    // Sensor position and velocity (4th or 8th order Lagrange).
-   int nOrder = 8;
-   if (_data.m_PlatformFlag == 0)
-      nOrder = 4;
    double sensPosNom[3];
-   lagrangeInterp(_data.m_NumEphem, &_data.m_EphemPts[0], _data.m_T0Ephem, _data.m_DtEphem,
-      time, 3, nOrder, sensPosNom);
    double sensVelNom[3];
-   lagrangeInterp(_data.m_NumEphem, &_data.m_EphemRates[0], _data.m_T0Ephem, _data.m_DtEphem,
-      time, 3, nOrder, sensVelNom);
+   ((*_trajectory).*_positionVelocityKernel)(time, sensPosNom, sensVelNom);
    // Compute rotation matrix from ICR to ECF
 
    double radialUnitVec[3];
@@ -1983,81 +3007,44 @@ void UsgsAstroLsSensorModel::getAdjSensorPosVel(
 csm::ImageCoord UsgsAstroLsSensorModel::computeViewingPixel(
    const double& time,
    const csm::EcefCoord& groundPoint,
-   const std::vector<double>& adj) const
+   const std::vector<double>& adj,
+   double* groundPartials) const
 {
    // Get the exterior orientation
-   double xc, yc, zc, vx, vy, vz;
-   getAdjSensorPosVel(time, adj, xc, yc, zc, vx, vy, vz);
+   LineOrientation orientation;
+   computeTimeOrientation(time, adj, orientation);
+   return computeViewingPixel(orientation, groundPoint, adj, groundPartials);
+}
 
+//***************************************************************************
+// UsgsAstroLineScannerSensorModel::computeViewingPixel (orientation)
+//***************************************************************************
+csm::ImageCoord UsgsAstroLsSensorModel::computeViewingPixel(
+   const LineOrientation& orientation,
+   const csm::EcefCoord& groundPoint,
+   const std::vector<double>& adj,
+   double* groundPartials) const
+{
    // Compute the look vector
-   double bodyLookX = groundPoint.x - xc;
-   double bodyLookY = groundPoint.y - yc;
-   double bodyLookZ = groundPoint.z - zc;
+   double bodyLookX = groundPoint.x - orientation.position[0];
+   double bodyLookY = groundPoint.y - orientation.position[1];
+   double bodyLookZ = groundPoint.z - orientation.position[2];
 
    // Rotate the look vector into the camera reference frame
-   int nOrder = 8;
-   if (_data.m_PlatformFlag == 0)
-      nOrder = 4;
-   int nOrderQuat = nOrder;
-   if (_data.m_NumQuaternions < 6 && nOrder == 8)
-      nOrderQuat = 4;
-   double q[4];
-   lagrangeInterp(
-      _data.m_NumQuaternions, &_data.m_Quaternions[0], _data.m_T0Quat, _data.m_DtQuat,
-      time, 4, nOrderQuat, q);
-   double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
-   // Divide by the negative norm for 0 through 2 to invert the quaternion
-   q[0] /= -norm;
-   q[1] /= -norm;
-   q[2] /= -norm;
-   q[3] /= norm;
-   double bodyToCamera[9];
-   bodyToCamera[0] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
-   bodyToCamera[1] = 2 * (q[0] * q[1] - q[2] * q[3]);
-   bodyToCamera[2] = 2 * (q[0] * q[2] + q[1] * q[3]);
-   bodyToCamera[3] = 2 * (q[0] * q[1] + q[2] * q[3]);
-   bodyToCamera[4] = -q[0] * q[0] + q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
-   bodyToCamera[5] = 2 * (q[1] * q[2] - q[0] * q[3]);
-   bodyToCamera[6] = 2 * (q[0] * q[2] - q[1] * q[3]);
-   bodyToCamera[7] = 2 * (q[1] * q[2] + q[0] * q[3]);
-   bodyToCamera[8] = -q[0] * q[0] - q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
-   double cameraLookX = bodyToCamera[0] * bodyLookX
-                      + bodyToCamera[1] * bodyLookY
-                      + bodyToCamera[2] * bodyLookZ;
-   double cameraLookY = bodyToCamera[3] * bodyLookX
-                      + bodyToCamera[4] * bodyLookY
-                      + bodyToCamera[5] * bodyLookZ;
-   double cameraLookZ = bodyToCamera[6] * bodyLookX
-                      + bodyToCamera[7] * bodyLookY
-                      + bodyToCamera[8] * bodyLookZ;
+   // The rotation is orthonormal, so its transpose is the inverse
+   const double* cameraToBody = orientation.ecfFromPl;
+   double cameraLookX = cameraToBody[0] * bodyLookX
+                      + cameraToBody[3] * bodyLookY
+                      + cameraToBody[6] * bodyLookZ;
+   double cameraLookY = cameraToBody[1] * bodyLookX
+                      + cameraToBody[4] * bodyLookY
+                      + cameraToBody[7] * bodyLookZ;
+   double cameraLookZ = cameraToBody[2] * bodyLookX
+                      + cameraToBody[5] * bodyLookY
+                      + cameraToBody[8] * bodyLookZ;
 
    // Invert the attitude correction
-   double aTime = time - _data.m_T0Quat;
-   double euler[3];
-   double nTime = aTime / _data.m_HalfTime;
-   double nTime2 = nTime * nTime;
-   euler[0] =
-      (getValue(6, adj) + getValue(9, adj)* nTime + getValue(12, adj)* nTime2) / _data.m_FlyingHeight;
-   euler[1] =
-      (getValue(7, adj) + getValue(10, adj)* nTime + getValue(13, adj)* nTime2) / _data.m_FlyingHeight;
-   euler[2] =
-      (getValue(8, adj) + getValue(11, adj)* nTime + getValue(14, adj)* nTime2) / _data.m_HalfSwath;
-   double cos_a = cos(euler[0]);
-   double sin_a = sin(euler[0]);
-   double cos_b = cos(euler[1]);
-   double sin_b = sin(euler[1]);
-   double cos_c = cos(euler[2]);
-   double sin_c = sin(euler[2]);
-   double attCorr[9];
-   attCorr[0] = cos_b * cos_c;
-   attCorr[1] = -cos_a * sin_c + sin_a * sin_b * cos_c;
-   attCorr[2] = sin_a * sin_c + cos_a * sin_b * cos_c;
-   attCorr[3] = cos_b * sin_c;
-   attCorr[4] = cos_a * cos_c + sin_a * sin_b * sin_c;
-   attCorr[5] = -sin_a * cos_c + cos_a * sin_b * sin_c;
-   attCorr[6] = -sin_b;
-   attCorr[7] = sin_a * cos_b;
-   attCorr[8] = cos_a * cos_b;
+   const double* attCorr = orientation.plFromApl;
    double adjustedLookX = attCorr[0] * cameraLookX
                         + attCorr[3] * cameraLookY
                         + attCorr[6] * cameraLookZ;
@@ -2079,15 +3066,19 @@ csm::ImageCoord UsgsAstroLsSensorModel::computeViewingPixel(
                          + _data.m_MountingMatrix[5] * adjustedLookY
                          + _data.m_MountingMatrix[8] * adjustedLookZ;
 
-   // Convert to focal plane coordinate
-   double lookScale = _data.m_Focal / correctedLookZ;
-   double focalX = correctedLookX * lookScale;
-   double focalY = correctedLookY * lookScale;
+   // Convert to focal plane coordinate, including the focal bias applied
+   // by losToEcf
+   double lookScale = _data.m_Focal
+                    * (1.0 - getValue(FOCAL_BIAS_INDEX, adj) / _data.m_HalfSwath)
+                    / (correctedLookZ * _data.m_IsisZDirection);
+   double undistortedFocalX = correctedLookX * lookScale;
+   double undistortedFocalY = correctedLookY * lookScale;
 
-   // TODO invert distortion here
-   // We probably only want to try and invert the distortion if we are
-   // reasonably close to the actual CCD because the distortion equations are
-   // sometimes only well behaved close to the CCD.
+   // Apply the lens distortion. Far from the detector the inverse leaves the
+   // coordinate undistorted, which is enough to steer the line search.
+   double focalX, focalY;
+   _distortion->distort(undistortedFocalX, undistortedFocalY,
+      focalX, focalY);
 
    // Convert to detector line and sample
    double detectorLine = _data.m_ITransL[0]
@@ -2102,6 +3093,43 @@ csm::ImageCoord UsgsAstroLsSensorModel::computeViewingPixel(
                - _data.m_OffsetLines + 0.5;
    double sample = (detectorSample + _data.m_DetectorSampleOrigin - _data.m_StartingSample)
                  / _data.m_DetectorSampleSumming - _data.m_OffsetSamples + 0.5;
+
+   if (groundPartials) {
+      // The ground point enters only through the look vector, so the
+      // partials follow each body axis through the rotations, the
+      // perspective division, the distortion and the detector transform
+      double jxx, jxy, jyx, jyy;
+      _distortion->jacobian(undistortedFocalX, undistortedFocalY,
+         jxx, jxy, jyx, jyy);
+      for (int i = 0; i < 3; i++) {
+         double camX = cameraToBody[3 * i];
+         double camY = cameraToBody[3 * i + 1];
+         double camZ = cameraToBody[3 * i + 2];
+         double adjX = attCorr[0] * camX + attCorr[3] * camY + attCorr[6] * camZ;
+         double adjY = attCorr[1] * camX + attCorr[4] * camY + attCorr[7] * camZ;
+         double adjZ = attCorr[2] * camX + attCorr[5] * camY + attCorr[8] * camZ;
+         double corX = _data.m_MountingMatrix[0] * adjX
+                     + _data.m_MountingMatrix[3] * adjY
+                     + _data.m_MountingMatrix[6] * adjZ;
+         double corY = _data.m_MountingMatrix[1] * adjX
+                     + _data.m_MountingMatrix[4] * adjY
+                     + _data.m_MountingMatrix[7] * adjZ;
+         double corZ = _data.m_MountingMatrix[2] * adjX
+                     + _data.m_MountingMatrix[5] * adjY
+                     + _data.m_MountingMatrix[8] * adjZ;
+         double dUndistortedX = lookScale * corX
+                              - undistortedFocalX * corZ / correctedLookZ;
+         double dUndistortedY = lookScale * corY
+                              - undistortedFocalY * corZ / correctedLookZ;
+         double dFocalX = jxx * dUndistortedX + jxy * dUndistortedY;
+         double dFocalY = jyx * dUndistortedX + jyy * dUndistortedY;
+         groundPartials[i] = _data.m_ITransL[1] * dFocalX
+                           + _data.m_ITransL[2] * dFocalY;
+         groundPartials[3 + i] = (_data.m_ITransS[1] * dFocalX
+                               + _data.m_ITransS[2] * dFocalY)
+                               / _data.m_DetectorSampleSumming;
+      }
+   }
    return csm::ImageCoord(line, sample);
 }
 
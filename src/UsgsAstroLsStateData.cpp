@@ -116,7 +116,8 @@ const std::string  UsgsAstroLsStateData::STATE_KEYWORD[] =
    "STA_HALF_SWATH",
    "STA_HALF_TIME",
    "STA_COVARIANCE",
-   "STA_IMAGE_FLIP_FLAG"
+   "STA_IMAGE_FLIP_FLAG",
+   "STA_EPHEM_INTERP_FLAG"
 };
 
 const int UsgsAstroLsStateData::NUM_PARAM_TYPES = 4;
@@ -160,6 +161,7 @@ std::string UsgsAstroLsStateData::toJson() const {
         {STATE_KEYWORD[STA_FOCAL], m_Focal},
         {STATE_KEYWORD[STA_ISIS_Z_DIRECTION], m_IsisZDirection},
         {STATE_KEYWORD[STA_IMAGE_FLIP_FLAG] , m_ImageFlipFlag},
+        {STATE_KEYWORD[STA_EPHEM_INTERP_FLAG], m_EphemInterpFlag},
         {STATE_KEYWORD[STA_REFERENCE_POINT_XYZ],
           {m_ReferencePointXyz.x,m_ReferencePointXyz.y, m_ReferencePointXyz.z}},
         {STATE_KEYWORD[STA_GSD], m_Gsd},
@@ -345,6 +347,7 @@ std::string UsgsAstroLsStateData::toString() const
    }
    state_stream << "\n";
    state_stream << STATE_KEYWORD[STA_IMAGE_FLIP_FLAG] << " " << m_ImageFlipFlag << "\n";  // 53
+   state_stream << STATE_KEYWORD[STA_EPHEM_INTERP_FLAG] << " " << m_EphemInterpFlag << "\n";  // 54
 //   state_stream << std::ends;
    return state_stream.str();
 }
@@ -411,6 +414,10 @@ void UsgsAstroLsStateData::setState(const std::string &stateString )
    m_HalfSwath = j["STA_HALF_SWATH"];
    m_HalfTime = j["STA_HALF_TIME"];
    m_ImageFlipFlag = j["STA_IMAGE_FLIP_FLAG"];
+   // Optional, states saved before it was added use Lagrange interpolation
+   if (j.find("STA_EPHEM_INTERP_FLAG") != j.end()) {
+     m_EphemInterpFlag = j["STA_EPHEM_INTERP_FLAG"];
+   }
    // Vector = is overloaded so explicit get with type required.
    m_EphemPts = j["STA_EPHEM_PTS"].get<std::vector<double>>();
    m_EphemRates = j["STA_EPHEM_RATES"].get<std::vector<double>>();
@@ -534,5 +541,6 @@ void UsgsAstroLsStateData::reset()
       m_Covariance[i * NUM_PARAMETERS + i] = 1.0;
    }
    m_ImageFlipFlag = 0;                     // 53
+   m_EphemInterpFlag = 0;                   // 54
 
 }
@@ -0,0 +1,445 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Immutable ephemeris and attitude of a line scanner platform, shared
+//    by all line scanner models built from the same orbit.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroLsTrajectory.h"
+#include "UsgsAstroLsStateData.h"
+
+#include <map>
+#include <math.h>
+#include <mutex>
+
+namespace
+{
+   // Live trajectories by identifier.  More than one trajectory can carry
+   // the same identifier when the support data of two images differ.
+   typedef std::multimap<std::string,
+                         std::weak_ptr<const UsgsAstroLsTrajectory> >
+      TrajectoryRegistry;
+
+   std::mutex         registryMutex;
+   TrajectoryRegistry registry;
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory Constructor
+//*****************************************************************************
+UsgsAstroLsTrajectory::UsgsAstroLsTrajectory(
+   const UsgsAstroLsStateData &state_data)
+:
+   m_Identifier(state_data.m_TrajectoryIdentifier),
+   m_DtEphem(state_data.m_DtEphem),
+   m_T0Ephem(state_data.m_T0Ephem),
+   m_DtQuat(state_data.m_DtQuat),
+   m_T0Quat(state_data.m_T0Quat),
+   m_NumEphem(state_data.m_NumEphem),
+   m_NumQuaternions(state_data.m_NumQuaternions),
+   m_EphemPts(state_data.m_EphemPts),
+   m_EphemRates(state_data.m_EphemRates),
+   m_Quaternions(state_data.m_Quaternions)
+{
+   buildEphemPolynomials();
+   buildQuatPolynomials(4, m_QuatPoly4);
+   buildQuatPolynomials(8, m_QuatPoly8);
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::share
+//*****************************************************************************
+std::shared_ptr<const UsgsAstroLsTrajectory> UsgsAstroLsTrajectory::share(
+   const UsgsAstroLsStateData &state_data)
+{
+   if (state_data.m_TrajectoryIdentifier.empty())
+   {
+      return std::make_shared<const UsgsAstroLsTrajectory>(state_data);
+   }
+
+   std::lock_guard<std::mutex> lock(registryMutex);
+
+   std::pair<TrajectoryRegistry::iterator, TrajectoryRegistry::iterator>
+      range = registry.equal_range(state_data.m_TrajectoryIdentifier);
+   TrajectoryRegistry::iterator it = range.first;
+   while (it != range.second)
+   {
+      std::shared_ptr<const UsgsAstroLsTrajectory> trajectory =
+         it->second.lock();
+      if (!trajectory)
+      {
+         // Drop entries whose models have all been destroyed
+         it = registry.erase(it);
+         continue;
+      }
+      if (trajectory->matches(state_data))
+      {
+         return trajectory;
+      }
+      ++it;
+   }
+
+   std::shared_ptr<const UsgsAstroLsTrajectory> trajectory =
+      std::make_shared<const UsgsAstroLsTrajectory>(state_data);
+   registry.insert(std::make_pair(state_data.m_TrajectoryIdentifier,
+      std::weak_ptr<const UsgsAstroLsTrajectory>(trajectory)));
+   return trajectory;
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::toStateData
+//*****************************************************************************
+void UsgsAstroLsTrajectory::toStateData(
+   UsgsAstroLsStateData &state_data) const
+{
+   state_data.m_DtEphem        = m_DtEphem;
+   state_data.m_T0Ephem        = m_T0Ephem;
+   state_data.m_DtQuat         = m_DtQuat;
+   state_data.m_T0Quat         = m_T0Quat;
+   state_data.m_NumEphem       = m_NumEphem;
+   state_data.m_NumQuaternions = m_NumQuaternions;
+   state_data.m_EphemPts       = m_EphemPts;
+   state_data.m_EphemRates     = m_EphemRates;
+   state_data.m_Quaternions    = m_Quaternions;
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::matches
+//*****************************************************************************
+bool UsgsAstroLsTrajectory::matches(
+   const UsgsAstroLsStateData &state_data) const
+{
+   return m_Identifier     == state_data.m_TrajectoryIdentifier &&
+          m_DtEphem        == state_data.m_DtEphem &&
+          m_T0Ephem        == state_data.m_T0Ephem &&
+          m_DtQuat         == state_data.m_DtQuat &&
+          m_T0Quat         == state_data.m_T0Quat &&
+          m_NumEphem       == state_data.m_NumEphem &&
+          m_NumQuaternions == state_data.m_NumQuaternions &&
+          m_EphemPts       == state_data.m_EphemPts &&
+          m_EphemRates     == state_data.m_EphemRates &&
+          m_Quaternions    == state_data.m_Quaternions;
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::buildEphemPolynomials
+//*****************************************************************************
+void UsgsAstroLsTrajectory::buildEphemPolynomials()
+{
+   int n = m_NumEphem;
+   if (n < 2 || (int)m_EphemPts.size() < 3 * n ||
+       (int)m_EphemRates.size() < 3 * n)
+   {
+      return;
+   }
+
+   // Accelerations at the posts from differences of the rates, fourth
+   // order central where there are enough posts and lower order toward
+   // the ends.
+   const double* v = &m_EphemRates[0];
+   std::vector<double> accel(3 * n);
+   for (int i = 0; i < n; i++)
+   {
+      for (int k = 0; k < 3; k++)
+      {
+         double a;
+         if (i >= 2 && i <= n - 3)
+         {
+            a = (v[3*(i-2)+k] - 8.0 * v[3*(i-1)+k]
+               + 8.0 * v[3*(i+1)+k] - v[3*(i+2)+k]) / 12.0;
+         }
+         else if (i >= 1 && i <= n - 2)
+         {
+            a = (v[3*(i+1)+k] - v[3*(i-1)+k]) / 2.0;
+         }
+         else if (n == 2)
+         {
+            a = v[3+k] - v[k];
+         }
+         else if (i == 0)
+         {
+            a = (-3.0 * v[k] + 4.0 * v[3+k] - v[6+k]) / 2.0;
+         }
+         else
+         {
+            a = (3.0 * v[3*i+k] - 4.0 * v[3*(i-1)+k]
+               + v[3*(i-2)+k]) / 2.0;
+         }
+         accel[3 * i + k] = a / m_DtEphem;
+      }
+   }
+
+   // Quintic Hermite in the fraction of the interval, with the rates and
+   // accelerations scaled to it.
+   double h = m_DtEphem;
+   m_EphemPoly.resize(3 * EPHEM_POLY_SIZE * (n - 1));
+   double* c = &m_EphemPoly[0];
+   for (int i = 0; i < n - 1; i++)
+   {
+      for (int k = 0; k < 3; k++, c += EPHEM_POLY_SIZE)
+      {
+         double p0 = m_EphemPts[3 * i + k];
+         double p1 = m_EphemPts[3 * (i + 1) + k];
+         double m0 = h * v[3 * i + k];
+         double m1 = h * v[3 * (i + 1) + k];
+         double a0 = h * h * accel[3 * i + k];
+         double a1 = h * h * accel[3 * (i + 1) + k];
+         double dp = p1 - p0;
+
+         c[0] = p0;
+         c[1] = m0;
+         c[2] = 0.5 * a0;
+         c[3] = 10.0 * dp - 6.0 * m0 - 4.0 * m1 - 1.5 * a0 + 0.5 * a1;
+         c[4] = -15.0 * dp + 8.0 * m0 + 7.0 * m1 + 1.5 * a0 - a1;
+         c[5] = 6.0 * dp - 3.0 * m0 - 3.0 * m1 - 0.5 * a0 + 0.5 * a1;
+
+         c[6] = c[1] / h;
+         c[7] = 2.0 * c[2] / h;
+         c[8] = 3.0 * c[3] / h;
+         c[9] = 4.0 * c[4] / h;
+         c[10] = 5.0 * c[5] / h;
+      }
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::buildQuatPolynomials
+//*****************************************************************************
+void UsgsAstroLsTrajectory::buildQuatPolynomials(
+   int                  maxOrder,
+   std::vector<double> &poly) const
+{
+   int n = m_NumQuaternions;
+   poly.clear();
+   if (n < 2 || (int)m_Quaternions.size() < 4 * n)
+   {
+      return;
+   }
+
+   std::vector<double> quats(m_Quaternions.begin(),
+                             m_Quaternions.begin() + 4 * n);
+   for (int i = 0; i < n; i++)
+   {
+      double* q = &quats[4 * i];
+      double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      if (norm > 0.0)
+      {
+         q[0] /= norm;
+         q[1] /= norm;
+         q[2] /= norm;
+         q[3] /= norm;
+      }
+   }
+
+   poly.assign(4 * QUAT_POLY_SIZE * (n - 1), 0.0);
+   for (int index = 0; index < n - 1; index++)
+   {
+      // Same order as lagrangeInterp, lowered where the posts would run
+      // past either end of the data
+      int order;
+      if (index >= 3 && index < n - 4) {
+         order = 8;
+      }
+      else if (index == 2 || index == n - 4) {
+         order = 6;
+      }
+      else if (index == 1 || index == n - 3) {
+         order = 4;
+      }
+      else {
+         order = 2;
+      }
+      if (order > maxOrder) {
+         order = maxOrder;
+      }
+      while (index - order / 2 + 1 < 0 || index + order / 2 > n - 1) {
+         order -= 2;
+      }
+      int indx0 = index - order / 2 + 1;
+
+      // Expand each Lagrange basis polynomial, with the posts at
+      // tau = -order / 2 + 1 ... order / 2, into powers of tau.
+      double* c = &poly[4 * QUAT_POLY_SIZE * index];
+      for (int j = 0; j < order; j++)
+      {
+         double basis[QUAT_POLY_SIZE] = { 1.0 };
+         int degree = 0;
+         double xj = j - order / 2 + 1;
+         for (int k = 0; k < order; k++)
+         {
+            if (k == j)
+            {
+               continue;
+            }
+            double xk = k - order / 2 + 1;
+            double denom = xj - xk;
+            degree++;
+            for (int m = degree; m >= 0; m--)
+            {
+               basis[m] = ((m > 0 ? basis[m - 1] : 0.0) - xk * basis[m]) / denom;
+            }
+         }
+         const double* q = &quats[4 * (indx0 + j)];
+         for (int comp = 0; comp < 4; comp++)
+         {
+            for (int m = 0; m < order; m++)
+            {
+               c[QUAT_POLY_SIZE * comp + m] += q[comp] * basis[m];
+            }
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::compareHermiteEphemeris
+//*****************************************************************************
+void UsgsAstroLsTrajectory::compareHermiteEphemeris(
+   int     samplesPerInterval,
+   double &maxPositionDifference,
+   double &maxVelocityDifference) const
+{
+   maxPositionDifference = 0.0;
+   maxVelocityDifference = 0.0;
+   if (samplesPerInterval < 1)
+   {
+      samplesPerInterval = 1;
+   }
+
+   int numSamples = (m_NumEphem - 1) * samplesPerInterval;
+   for (int i = 0; i <= numSamples; i++)
+   {
+      double time = m_T0Ephem + m_DtEphem * i / samplesPerInterval;
+      double pos[3], vel[3], hermitePos[3], hermiteVel[3];
+      getPositionVelocity(time, 8, pos, vel);
+      getHermitePositionVelocity(time, hermitePos, hermiteVel);
+      double dp = sqrt(
+         (pos[0] - hermitePos[0]) * (pos[0] - hermitePos[0]) +
+         (pos[1] - hermitePos[1]) * (pos[1] - hermitePos[1]) +
+         (pos[2] - hermitePos[2]) * (pos[2] - hermitePos[2]));
+      double dv = sqrt(
+         (vel[0] - hermiteVel[0]) * (vel[0] - hermiteVel[0]) +
+         (vel[1] - hermiteVel[1]) * (vel[1] - hermiteVel[1]) +
+         (vel[2] - hermiteVel[2]) * (vel[2] - hermiteVel[2]));
+      if (dp > maxPositionDifference)
+      {
+         maxPositionDifference = dp;
+      }
+      if (dv > maxVelocityDifference)
+      {
+         maxVelocityDifference = dv;
+      }
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getPositionVelocity
+//*****************************************************************************
+void UsgsAstroLsTrajectory::getPositionVelocity(
+   const double& time,
+   const int&    i_order,
+   double        position[3],
+   double        velocity[3]) const
+{
+   lagrangeInterp(m_NumEphem, &m_EphemPts[0], m_T0Ephem, m_DtEphem,
+      time, 3, i_order, position);
+   lagrangeInterp(m_NumEphem, &m_EphemRates[0], m_T0Ephem, m_DtEphem,
+      time, 3, i_order, velocity);
+}
+
+//*****************************************************************************
+// UsgsAstroLsTrajectory::getQuaternion
+//*****************************************************************************
+void UsgsAstroLsTrajectory::getQuaternion(
+   const double& time,
+   const int&    i_order,
+   double        quaternion[4]) const
+{
+   lagrangeInterp(m_NumQuaternions, &m_Quaternions[0], m_T0Quat, m_DtQuat,
+      time, 4, i_order, quaternion);
+}
+
+//***************************************************************************
+// UsgsAstroLsTrajectory::lagrangeInterp
+//***************************************************************************
+void UsgsAstroLsTrajectory::lagrangeInterp(
+   const int&     numTime,
+   const double*  valueArray,
+   const double&  startTime,
+   const double&  delTime,
+   const double&  time,
+   const int&     vectorLength,
+   const int&     i_order,
+   double*        valueVector)
+{
+   // Lagrange interpolation for uniform post interval.
+   // Largest order possible is 8th. Points far away from
+   // data center are handled gracefully to avoid failure.
+
+   // Compute index
+
+   double fndex = (time - startTime) / delTime;
+   int    index = int(fndex);
+
+   if (index < 0)
+   {
+      index = 0;
+   }
+   if (index > numTime - 2)
+   {
+      index = numTime - 2;
+   }
+
+   // Define order, max is 8
+
+   int order;
+   if (index >= 3 && index < numTime - 4) {
+      order = 8;
+   }
+   else if (index == 2 || index == numTime - 4) {
+      order = 6;
+   }
+   else if (index == 1 || index == numTime - 3) {
+      order = 4;
+   }
+   else if (index == 0 || index == numTime - 2) {
+      order = 2;
+   }
+   if (order > i_order) {
+      order = i_order;
+   }
+
+   // Compute interpolation coefficients
+   double d[8];
+   double tau = fndex - index;
+   if (order == 2) {
+      lagrangeWeights<2>(tau, d);
+   }
+   else if (order == 4) {
+      lagrangeWeights<4>(tau, d);
+   }
+   else if (order == 6) {
+      lagrangeWeights<6>(tau, d);
+   }
+   else if (order == 8) {
+      lagrangeWeights<8>(tau, d);
+   }
+
+   // Compute interpolated point
+   int    indx0 = index - order / 2 + 1;
+   for (int i = 0; i < vectorLength; i++)
+   {
+      valueVector[i] = 0.0;
+   }
+
+   for (int i = 0; i < order; i++)
+   {
+      int jndex = vectorLength * (indx0 + i);
+      for (int j = 0; j < vectorLength; j++)
+      {
+         valueVector[j] += d[i] * valueArray[jndex + j];
+      }
+   }
+}
@@ -0,0 +1,96 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Splitting of a batch into contiguous blocks run on several threads,
+//    for the batch methods of the sensor models and the rasters.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroParallel.h"
+
+#include <algorithm>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Runs one block, keeping any error for the calling thread
+//*****************************************************************************
+static void runBlock(
+   const UsgsAstroParallel::BlockWork &work,
+   int                                 block,
+   int                                 first,
+   int                                 last,
+   std::exception_ptr                 *error)
+{
+   try
+   {
+      work(block, first, last);
+   }
+   catch (...)
+   {
+      *error = std::current_exception();
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroParallel::numThreads
+//*****************************************************************************
+int UsgsAstroParallel::numThreads(
+   int numThreads,
+   int numItems,
+   int minItemsPerThread)
+{
+   if (numThreads <= 0)
+   {
+      numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+   }
+   return std::max(1, std::min(numThreads,
+      numItems / std::max(1, minItemsPerThread)));
+}
+
+//*****************************************************************************
+// UsgsAstroParallel::parallelFor
+//*****************************************************************************
+void UsgsAstroParallel::parallelFor(
+   int              numItems,
+   int              numBlocks,
+   const BlockWork &work)
+{
+   numBlocks = std::max(1, numBlocks);
+   std::vector<std::exception_ptr> errors(numBlocks);
+   std::vector<std::thread> threads;
+   threads.reserve(numBlocks - 1);
+   for (int b = 0; b < numBlocks; b++)
+   {
+      int first = (int)((long long)numItems * b / numBlocks);
+      int last = (int)((long long)numItems * (b + 1) / numBlocks);
+      if (b == numBlocks - 1)
+      {
+         runBlock(work, b, first, last, &errors[b]);
+         continue;
+      }
+      try
+      {
+         threads.push_back(std::thread(
+            runBlock, std::cref(work), b, first, last, &errors[b]));
+      }
+      catch (std::system_error &)
+      {
+         runBlock(work, b, first, last, &errors[b]);
+      }
+   }
+   for (size_t t = 0; t < threads.size(); t++)
+   {
+      threads[t].join();
+   }
+   for (int b = 0; b < numBlocks; b++)
+   {
+      if (errors[b])
+      {
+         std::rethrow_exception(errors[b]);
+      }
+   }
+}
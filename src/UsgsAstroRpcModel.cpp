@@ -0,0 +1,580 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Rational polynomial approximation of a rigorous sensor model.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroRpcModel.h"
+
+#include <Error.h>
+
+#include <algorithm>
+#include <math.h>
+
+// Smallest height range sampled, in meters.
+static const double MIN_HEIGHT_SPAN = 1000.0;
+
+// Passes of the fit reweighted by the previous denominator.
+static const int NUM_FIT_PASSES = 3;
+
+// Weight of the rows pulling every coefficient towards zero, which keeps
+// the solution unique when the grid does not determine all the terms.
+static const double RIDGE = 1.0e-7;
+
+// Newton iterations and residual, in pixels, for imageToGround.
+static const int MAX_ITERATIONS = 30;
+static const double IMAGE_TOLERANCE = 1.0e-6;
+
+static const double DEG_TO_RAD = 3.14159265358979323846 / 180.0;
+
+//*****************************************************************************
+// Polynomial terms in the RPC00B order, with L the longitude, P the
+// latitude and H the height
+//*****************************************************************************
+static void computeTerms(double p, double l, double h, double *t)
+{
+   t[0] = 1.0;
+   t[1] = l;
+   t[2] = p;
+   t[3] = h;
+   t[4] = l * p;
+   t[5] = l * h;
+   t[6] = p * h;
+   t[7] = l * l;
+   t[8] = p * p;
+   t[9] = h * h;
+   t[10] = p * l * h;
+   t[11] = l * l * l;
+   t[12] = l * p * p;
+   t[13] = l * h * h;
+   t[14] = l * l * p;
+   t[15] = p * p * p;
+   t[16] = p * h * h;
+   t[17] = l * l * h;
+   t[18] = p * p * h;
+   t[19] = h * h * h;
+}
+
+static void computeTermPartials(
+   double  p,
+   double  l,
+   double  h,
+   double *dp,
+   double *dl)
+{
+   for (int i = 0; i < UsgsAstroRpcModel::NUM_TERMS; i++)
+   {
+      dp[i] = 0.0;
+      dl[i] = 0.0;
+   }
+   dl[1] = 1.0;
+   dp[2] = 1.0;
+   dl[4] = p;
+   dp[4] = l;
+   dl[5] = h;
+   dp[6] = h;
+   dl[7] = 2.0 * l;
+   dp[8] = 2.0 * p;
+   dl[10] = p * h;
+   dp[10] = l * h;
+   dl[11] = 3.0 * l * l;
+   dl[12] = p * p;
+   dp[12] = 2.0 * l * p;
+   dl[13] = h * h;
+   dl[14] = 2.0 * l * p;
+   dp[14] = l * l;
+   dp[15] = 3.0 * p * p;
+   dp[16] = h * h;
+   dl[17] = 2.0 * l * h;
+   dp[18] = 2.0 * p * h;
+}
+
+static double evaluate(const double *c, const double *t)
+{
+   double sum = 0.0;
+   for (int i = 0; i < UsgsAstroRpcModel::NUM_TERMS; i++)
+   {
+      sum += c[i] * t[i];
+   }
+   return sum;
+}
+
+//*****************************************************************************
+// Least squares solution of the row major rows by cols system a x = b by
+// Householder reflections.  Overwrites a and b.
+//*****************************************************************************
+static void solveLeastSquares(
+   std::vector<double> &a,
+   std::vector<double> &b,
+   int                  rows,
+   int                  cols,
+   double              *x)
+{
+   std::vector<double> v(rows);
+   for (int k = 0; k < cols; k++)
+   {
+      double norm = 0.0;
+      for (int i = k; i < rows; i++)
+      {
+         norm += a[i * cols + k] * a[i * cols + k];
+      }
+      norm = sqrt(norm);
+      if (norm == 0.0)
+      {
+         continue;
+      }
+      double alpha = a[k * cols + k] > 0.0 ? -norm : norm;
+      double vv = 0.0;
+      for (int i = k; i < rows; i++)
+      {
+         v[i] = a[i * cols + k];
+      }
+      v[k] -= alpha;
+      for (int i = k; i < rows; i++)
+      {
+         vv += v[i] * v[i];
+      }
+      for (int j = k; j < cols; j++)
+      {
+         double s = 0.0;
+         for (int i = k; i < rows; i++)
+         {
+            s += v[i] * a[i * cols + j];
+         }
+         s *= 2.0 / vv;
+         for (int i = k; i < rows; i++)
+         {
+            a[i * cols + j] -= s * v[i];
+         }
+      }
+      double s = 0.0;
+      for (int i = k; i < rows; i++)
+      {
+         s += v[i] * b[i];
+      }
+      s *= 2.0 / vv;
+      for (int i = k; i < rows; i++)
+      {
+         b[i] -= s * v[i];
+      }
+   }
+
+   for (int k = cols - 1; k >= 0; k--)
+   {
+      double sum = b[k];
+      for (int j = k + 1; j < cols; j++)
+      {
+         sum -= a[k * cols + j] * x[j];
+      }
+      x[k] = a[k * cols + k] != 0.0 ? sum / a[k * cols + k] : 0.0;
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel Constructors
+//*****************************************************************************
+UsgsAstroRpcModel::UsgsAstroRpcModel(
+   const csm::RasterGM &model,
+   double               semiMajorAxis,
+   double               semiMinorAxis,
+   int                  gridSize,
+   int                  numHeights)
+:
+   m_Geodesy(semiMajorAxis, semiMinorAxis),
+   m_FitRms(0.0),
+   m_FitMax(0.0),
+   m_CheckRms(0.0),
+   m_CheckMax(0.0)
+{
+   if (gridSize < 4 || numHeights < 4)
+   {
+      throw csm::Error(
+         csm::Error::INVALID_USE,
+         "The fit needs at least four grid points and heights per axis",
+         "UsgsAstroRpcModel::UsgsAstroRpcModel");
+   }
+
+   std::pair<csm::ImageCoord, csm::ImageCoord> range =
+      model.getValidImageRange();
+   std::pair<double, double> heights = model.getValidHeightRange();
+   double minHeight = heights.first;
+   double maxHeight = heights.second;
+   if (maxHeight - minHeight < MIN_HEIGHT_SPAN)
+   {
+      double middle = (minHeight + maxHeight) / 2.0;
+      minHeight = middle - MIN_HEIGHT_SPAN / 2.0;
+      maxHeight = middle + MIN_HEIGHT_SPAN / 2.0;
+   }
+
+   m_Offsets[0] = (range.first.line + range.second.line) / 2.0;
+   m_Offsets[1] = (range.first.samp + range.second.samp) / 2.0;
+   m_Offsets[4] = (minHeight + maxHeight) / 2.0;
+   m_Scales[0] = (range.second.line - range.first.line) / 2.0;
+   m_Scales[1] = (range.second.samp - range.first.samp) / 2.0;
+   m_Scales[4] = (maxHeight - minHeight) / 2.0;
+
+   // The longitudes are taken about that of the image center, so that a
+   // footprint across the date line stays in one piece
+   csm::EcefCoord center = model.imageToGround(
+      csm::ImageCoord(m_Offsets[0], m_Offsets[1]), m_Offsets[4]);
+   m_Offsets[3] = atan2(center.y, center.x) / DEG_TO_RAD;
+   m_Offsets[2] = 0.0;
+   m_Scales[2] = 1.0;
+   m_Scales[3] = 1.0;
+
+   // Fit grid on the cell corners, check grid on the cell centers
+   std::vector<double> fitGround, fitImage, checkGround, checkImage;
+   for (int pass = 0; pass < 2; pass++)
+   {
+      int n = gridSize - pass;
+      int m = numHeights - pass;
+      double offset = 0.5 * pass;
+      std::vector<double> &ground = pass == 0 ? fitGround : checkGround;
+      std::vector<double> &image = pass == 0 ? fitImage : checkImage;
+      for (int k = 0; k < m; k++)
+      {
+         double height = minHeight
+                       + (k + offset) * (maxHeight - minHeight) / (numHeights - 1);
+         for (int i = 0; i < n; i++)
+         {
+            double line = range.first.line + (i + offset)
+                        * (range.second.line - range.first.line) / (gridSize - 1);
+            for (int j = 0; j < n; j++)
+            {
+               double samp = range.first.samp + (j + offset)
+                           * (range.second.samp - range.first.samp) / (gridSize - 1);
+               csm::EcefCoord groundPt = model.imageToGround(
+                  csm::ImageCoord(line, samp), height);
+               double latitude, longitude, h;
+               if (!normalize(groundPt, latitude, longitude, h))
+               {
+                  throw csm::Error(
+                     csm::Error::ALGORITHM,
+                     "No geodetic coordinates for the ellipsoid",
+                     "UsgsAstroRpcModel::UsgsAstroRpcModel");
+               }
+               ground.push_back(latitude);
+               ground.push_back(longitude);
+               ground.push_back(h);
+               image.push_back(line);
+               image.push_back(samp);
+            }
+         }
+      }
+   }
+
+   // Latitude and longitude normalization from the extent of the fit grid,
+   // which was sampled in degrees about the center longitude
+   for (int a = 0; a < 2; a++)
+   {
+      double lo = fitGround[a];
+      double hi = fitGround[a];
+      for (size_t i = a; i < fitGround.size(); i += 3)
+      {
+         lo = std::min(lo, fitGround[i]);
+         hi = std::max(hi, fitGround[i]);
+      }
+      double offset = (lo + hi) / 2.0;
+      double scale = hi > lo ? (hi - lo) / 2.0 : 1.0;
+      for (int g = 0; g < 2; g++)
+      {
+         std::vector<double> &ground = g == 0 ? fitGround : checkGround;
+         for (size_t i = a; i < ground.size(); i += 3)
+         {
+            ground[i] = (ground[i] - offset) / scale;
+         }
+      }
+      m_Offsets[2 + a] = offset;
+      m_Scales[2 + a] = scale;
+   }
+
+   // The denominators can put a pole between the grid points where the
+   // rigorous model is not smooth, so the ratios are kept only if they do
+   // better than plain polynomials at the check grid
+   for (int c = 0; c < 2; c++)
+   {
+      fitCoordinate(c, true, fitGround, fitImage);
+   }
+   residuals(checkGround, checkImage, m_CheckRms, m_CheckMax);
+
+   double rational[4 * NUM_TERMS];
+   std::copy(m_Coefficients, m_Coefficients + 4 * NUM_TERMS, rational);
+   double rationalRms = m_CheckRms;
+   double rationalMax = m_CheckMax;
+   for (int c = 0; c < 2; c++)
+   {
+      fitCoordinate(c, false, fitGround, fitImage);
+   }
+   residuals(checkGround, checkImage, m_CheckRms, m_CheckMax);
+   if (rationalMax < m_CheckMax)
+   {
+      std::copy(rational, rational + 4 * NUM_TERMS, m_Coefficients);
+      m_CheckRms = rationalRms;
+      m_CheckMax = rationalMax;
+   }
+   residuals(fitGround, fitImage, m_FitRms, m_FitMax);
+}
+
+UsgsAstroRpcModel::UsgsAstroRpcModel(
+   double        semiMajorAxis,
+   double        semiMinorAxis,
+   const double *offsets,
+   const double *scales,
+   const double *coefficients)
+:
+   m_Geodesy(semiMajorAxis, semiMinorAxis),
+   m_FitRms(0.0),
+   m_FitMax(0.0),
+   m_CheckRms(0.0),
+   m_CheckMax(0.0)
+{
+   for (int i = 0; i < 5; i++)
+   {
+      m_Offsets[i] = offsets[i];
+      m_Scales[i] = scales[i];
+   }
+   for (int i = 0; i < 4 * NUM_TERMS; i++)
+   {
+      m_Coefficients[i] = coefficients[i];
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::groundToImage
+//*****************************************************************************
+csm::ImageCoord UsgsAstroRpcModel::groundToImage(
+   const csm::EcefCoord &groundPt) const
+{
+   double p, l, h;
+   if (!normalize(groundPt, p, l, h))
+   {
+      throw csm::Error(
+         csm::Error::ALGORITHM,
+         "No geodetic coordinates for the ground point",
+         "UsgsAstroRpcModel::groundToImage");
+   }
+   p = (p - m_Offsets[2]) / m_Scales[2];
+   l = (l - m_Offsets[3]) / m_Scales[3];
+
+   double t[NUM_TERMS];
+   computeTerms(p, l, h, t);
+   const double *c = m_Coefficients;
+   return csm::ImageCoord(
+      m_Offsets[0] + m_Scales[0] * evaluate(c, t)
+                   / evaluate(c + NUM_TERMS, t),
+      m_Offsets[1] + m_Scales[1] * evaluate(c + 2 * NUM_TERMS, t)
+                   / evaluate(c + 3 * NUM_TERMS, t));
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::imageToGround
+//*****************************************************************************
+csm::EcefCoord UsgsAstroRpcModel::imageToGround(
+   const csm::ImageCoord &imagePt,
+   double                 height) const
+{
+   double line = (imagePt.line - m_Offsets[0]) / m_Scales[0];
+   double samp = (imagePt.samp - m_Offsets[1]) / m_Scales[1];
+   double h = (height - m_Offsets[4]) / m_Scales[4];
+   const double *c = m_Coefficients;
+
+   double p = 0.0;
+   double l = 0.0;
+   double error = 0.0;
+   for (int iter = 0; iter < MAX_ITERATIONS; iter++)
+   {
+      double t[NUM_TERMS], dp[NUM_TERMS], dl[NUM_TERMS];
+      computeTerms(p, l, h, t);
+      computeTermPartials(p, l, h, dp, dl);
+
+      // Ratios and their partials in latitude and longitude
+      double f[2], fp[2], fl[2];
+      for (int k = 0; k < 2; k++)
+      {
+         const double *num = c + 2 * k * NUM_TERMS;
+         const double *den = num + NUM_TERMS;
+         double n = evaluate(num, t);
+         double d = evaluate(den, t);
+         f[k] = n / d;
+         fp[k] = (evaluate(num, dp) - f[k] * evaluate(den, dp)) / d;
+         fl[k] = (evaluate(num, dl) - f[k] * evaluate(den, dl)) / d;
+      }
+      double rl = f[0] - line;
+      double rs = f[1] - samp;
+      error = sqrt(rl * rl * m_Scales[0] * m_Scales[0]
+                 + rs * rs * m_Scales[1] * m_Scales[1]);
+      if (error < IMAGE_TOLERANCE)
+      {
+         break;
+      }
+
+      double det = fp[0] * fl[1] - fl[0] * fp[1];
+      if (det == 0.0)
+      {
+         break;
+      }
+      p -= (fl[1] * rl - fl[0] * rs) / det;
+      l -= (fp[0] * rs - fp[1] * rl) / det;
+   }
+
+   if (!(error < 1000.0 * IMAGE_TOLERANCE))
+   {
+      throw csm::Error(
+         csm::Error::ALGORITHM,
+         "Did not converge",
+         "UsgsAstroRpcModel::imageToGround");
+   }
+
+   csm::EcefCoord groundPt;
+   m_Geodesy.fromGeodetic(
+      (m_Offsets[2] + m_Scales[2] * p) * DEG_TO_RAD,
+      (m_Offsets[3] + m_Scales[3] * l) * DEG_TO_RAD,
+      height,
+      groundPt.x, groundPt.y, groundPt.z);
+   return groundPt;
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::getValidImageRange
+//*****************************************************************************
+std::pair<csm::ImageCoord, csm::ImageCoord>
+UsgsAstroRpcModel::getValidImageRange() const
+{
+   return std::pair<csm::ImageCoord, csm::ImageCoord>(
+      csm::ImageCoord(m_Offsets[0] - m_Scales[0], m_Offsets[1] - m_Scales[1]),
+      csm::ImageCoord(m_Offsets[0] + m_Scales[0], m_Offsets[1] + m_Scales[1]));
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::getValidHeightRange
+//*****************************************************************************
+std::pair<double, double> UsgsAstroRpcModel::getValidHeightRange() const
+{
+   return std::pair<double, double>(
+      m_Offsets[4] - m_Scales[4], m_Offsets[4] + m_Scales[4]);
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::normalize
+//*****************************************************************************
+bool UsgsAstroRpcModel::normalize(
+   const csm::EcefCoord &groundPt,
+   double               &latitude,
+   double               &longitude,
+   double               &height) const
+{
+   double lat, h;
+   if (!m_Geodesy.toGeodetic(groundPt.x, groundPt.y, groundPt.z, lat, h))
+   {
+      return false;
+   }
+
+   latitude = lat / DEG_TO_RAD;
+   longitude = atan2(groundPt.y, groundPt.x) / DEG_TO_RAD;
+   if (longitude - m_Offsets[3] > 180.0)
+   {
+      longitude -= 360.0;
+   }
+   else if (longitude - m_Offsets[3] <= -180.0)
+   {
+      longitude += 360.0;
+   }
+   height = (h - m_Offsets[4]) / m_Scales[4];
+   return true;
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::fitCoordinate
+//*****************************************************************************
+void UsgsAstroRpcModel::fitCoordinate(
+   int                        coordinate,
+   bool                       rational,
+   const std::vector<double> &ground,
+   const std::vector<double> &image)
+{
+   // Unknowns are the numerator and the denominator without its constant
+   // term, which is one
+   const int cols = rational ? 2 * NUM_TERMS - 1 : NUM_TERMS;
+   int n = (int)ground.size() / 3;
+   int rows = n + cols;
+   double *num = m_Coefficients + 2 * coordinate * NUM_TERMS;
+   double *den = num + NUM_TERMS;
+
+   std::vector<double> weights(n, 1.0);
+   for (int pass = 0; pass < (rational ? NUM_FIT_PASSES : 1); pass++)
+   {
+      std::vector<double> a(rows * cols, 0.0);
+      std::vector<double> b(rows, 0.0);
+      for (int i = 0; i < n; i++)
+      {
+         double t[NUM_TERMS];
+         computeTerms(ground[3 * i], ground[3 * i + 1], ground[3 * i + 2], t);
+         double r = (image[2 * i + coordinate] - m_Offsets[coordinate])
+                  / m_Scales[coordinate];
+         double *row = &a[i * cols];
+         for (int k = 0; k < NUM_TERMS; k++)
+         {
+            row[k] = weights[i] * t[k];
+         }
+         for (int k = 1; k < cols - NUM_TERMS + 1; k++)
+         {
+            row[NUM_TERMS + k - 1] = -weights[i] * r * t[k];
+         }
+         b[i] = weights[i] * r;
+      }
+      for (int k = 0; k < cols; k++)
+      {
+         a[(n + k) * cols + k] = RIDGE;
+      }
+
+      double x[2 * NUM_TERMS - 1];
+      solveLeastSquares(a, b, rows, cols, x);
+      den[0] = 1.0;
+      for (int k = 0; k < NUM_TERMS; k++)
+      {
+         num[k] = x[k];
+      }
+      for (int k = 1; k < NUM_TERMS; k++)
+      {
+         den[k] = rational ? x[NUM_TERMS + k - 1] : 0.0;
+      }
+
+      for (int i = 0; i < n; i++)
+      {
+         double t[NUM_TERMS];
+         computeTerms(ground[3 * i], ground[3 * i + 1], ground[3 * i + 2], t);
+         double d = evaluate(den, t);
+         weights[i] = d != 0.0 ? 1.0 / fabs(d) : 1.0;
+      }
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroRpcModel::residuals
+//*****************************************************************************
+void UsgsAstroRpcModel::residuals(
+   const std::vector<double> &ground,
+   const std::vector<double> &image,
+   double                    &rms,
+   double                    &max) const
+{
+   int n = (int)ground.size() / 3;
+   double sum = 0.0;
+   max = 0.0;
+   for (int i = 0; i < n; i++)
+   {
+      double t[NUM_TERMS];
+      computeTerms(ground[3 * i], ground[3 * i + 1], ground[3 * i + 2], t);
+      const double *c = m_Coefficients;
+      double dl = m_Offsets[0] + m_Scales[0] * evaluate(c, t)
+                / evaluate(c + NUM_TERMS, t) - image[2 * i];
+      double ds = m_Offsets[1] + m_Scales[1] * evaluate(c + 2 * NUM_TERMS, t)
+                / evaluate(c + 3 * NUM_TERMS, t) - image[2 * i + 1];
+      double d2 = dl * dl + ds * ds;
+      sum += d2;
+      max = std::max(max, sqrt(d2));
+   }
+   rms = n > 0 ? sqrt(sum / n) : 0.0;
+}
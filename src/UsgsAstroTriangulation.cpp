@@ -0,0 +1,260 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Least squares intersection of the rays of several images of a ground
+//    point, for the frame and line scanner sensor models.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroTriangulation.h"
+#include "UsgsAstroFrameSensorModel.h"
+#include "UsgsAstroLsSensorModel.h"
+#include "UsgsAstroParallel.h"
+
+#include <Error.h>
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+// Smallest determinant of the normal matrix, relative to the cube of its
+// mean eigenvalue, for the rays to count as intersecting.
+static const double MIN_RELATIVE_DETERMINANT = 1.0e-12;
+
+// Matches per thread below which the batch uses fewer threads.
+static const int MIN_MATCHES_PER_THREAD = 256;
+
+//*****************************************************************************
+// UsgsAstroTriangulation::getRay
+//*****************************************************************************
+csm::EcefLocus UsgsAstroTriangulation::getRay(
+   const csm::RasterGM   &model,
+   const csm::ImageCoord &imagePt)
+{
+   const UsgsAstroLsSensorModel *ls =
+      dynamic_cast<const UsgsAstroLsSensorModel *>(&model);
+   if (ls)
+   {
+      return ls->imageToRay(imagePt);
+   }
+   const UsgsAstroFrameSensorModel *frame =
+      dynamic_cast<const UsgsAstroFrameSensorModel *>(&model);
+   if (frame)
+   {
+      return frame->imageToRay(imagePt);
+   }
+
+   // The remote locus point may be anywhere along the ray, so it is moved
+   // to the sensor
+   csm::EcefLocus ray = model.imageToRemoteImagingLocus(imagePt);
+   ray.point = model.getSensorPosition(imagePt);
+   return ray;
+}
+
+//*****************************************************************************
+// UsgsAstroTriangulation::triangulate
+//*****************************************************************************
+bool UsgsAstroTriangulation::triangulate(
+   int                numObservations,
+   const Observation *observations,
+   csm::EcefCoord    &groundPt,
+   double            *covariance,
+   double            *residuals)
+{
+   if (numObservations < 2)
+   {
+      return false;
+   }
+
+   // Ray and angle subtended by the measurement standard deviation of each
+   // observation, the latter from the ray of the next sample
+   std::vector<double> rays(7 * numObservations);
+   for (int i = 0; i < numObservations; i++)
+   {
+      const Observation &obs = observations[i];
+      if (!obs.model)
+      {
+         return false;
+      }
+      csm::EcefLocus ray = getRay(*obs.model, obs.imagePt);
+      csm::EcefLocus next = getRay(
+         *obs.model, csm::ImageCoord(obs.imagePt.line, obs.imagePt.samp + 1.0));
+      double dx = next.direction.x - ray.direction.x;
+      double dy = next.direction.y - ray.direction.y;
+      double dz = next.direction.z - ray.direction.z;
+      double *r = &rays[7 * i];
+      r[0] = ray.point.x;
+      r[1] = ray.point.y;
+      r[2] = ray.point.z;
+      r[3] = ray.direction.x;
+      r[4] = ray.direction.y;
+      r[5] = ray.direction.z;
+      r[6] = sqrt(dx * dx + dy * dy + dz * dz)
+           * (obs.sigma > 0.0 ? obs.sigma : 1.0);
+      if (!(r[6] > 0.0))
+      {
+         return false;
+      }
+   }
+
+   // The weights need the distance along each ray to the point, so the
+   // first pass weighs by the angles alone
+   double x[3];
+   double inverse[9];
+   for (int pass = 0; pass < 2; pass++)
+   {
+      double n[9] = { 0.0 };
+      double b[3] = { 0.0 };
+      for (int i = 0; i < numObservations; i++)
+      {
+         const double *r = &rays[7 * i];
+         const double *d = r + 3;
+         double range = 1.0;
+         if (pass == 1)
+         {
+            range = fabs((x[0] - r[0]) * d[0] + (x[1] - r[1]) * d[1]
+                       + (x[2] - r[2]) * d[2]);
+            range = std::max(range, 1.0);
+         }
+         double w = 1.0 / (range * range * r[6] * r[6]);
+
+         // Projection across the ray
+         double p[9];
+         for (int j = 0; j < 3; j++)
+         {
+            for (int k = 0; k < 3; k++)
+            {
+               p[3 * j + k] = (j == k ? 1.0 : 0.0) - d[j] * d[k];
+            }
+         }
+         for (int j = 0; j < 3; j++)
+         {
+            for (int k = 0; k < 3; k++)
+            {
+               n[3 * j + k] += w * p[3 * j + k];
+               b[j] += w * p[3 * j + k] * r[k];
+            }
+         }
+      }
+
+      inverse[0] = n[4] * n[8] - n[5] * n[7];
+      inverse[1] = n[2] * n[7] - n[1] * n[8];
+      inverse[2] = n[1] * n[5] - n[2] * n[4];
+      inverse[3] = n[5] * n[6] - n[3] * n[8];
+      inverse[4] = n[0] * n[8] - n[2] * n[6];
+      inverse[5] = n[2] * n[3] - n[0] * n[5];
+      inverse[6] = n[3] * n[7] - n[4] * n[6];
+      inverse[7] = n[1] * n[6] - n[0] * n[7];
+      inverse[8] = n[0] * n[4] - n[1] * n[3];
+      double det = n[0] * inverse[0] + n[1] * inverse[3] + n[2] * inverse[6];
+      double mean = (n[0] + n[4] + n[8]) / 3.0;
+      if (!(det > MIN_RELATIVE_DETERMINANT * mean * mean * mean))
+      {
+         return false;
+      }
+      for (int j = 0; j < 9; j++)
+      {
+         inverse[j] /= det;
+      }
+      for (int j = 0; j < 3; j++)
+      {
+         x[j] = inverse[3 * j] * b[0] + inverse[3 * j + 1] * b[1]
+              + inverse[3 * j + 2] * b[2];
+      }
+   }
+
+   groundPt = csm::EcefCoord(x[0], x[1], x[2]);
+   if (covariance)
+   {
+      std::copy(inverse, inverse + 9, covariance);
+   }
+   if (residuals)
+   {
+      for (int i = 0; i < numObservations; i++)
+      {
+         const double *r = &rays[7 * i];
+         const double *d = r + 3;
+         double v[3] = { x[0] - r[0], x[1] - r[1], x[2] - r[2] };
+         double along = v[0] * d[0] + v[1] * d[1] + v[2] * d[2];
+         v[0] -= along * d[0];
+         v[1] -= along * d[1];
+         v[2] -= along * d[2];
+         residuals[i] = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+      }
+   }
+   return true;
+}
+
+//*****************************************************************************
+// Triangulates the matches from first up to last, returning the number of
+// valid ones
+//*****************************************************************************
+static int triangulateMatches(
+   int                                        first,
+   int                                        last,
+   const int                                 *matchStart,
+   const UsgsAstroTriangulation::Observation *observations,
+   csm::EcefCoord                            *groundPts,
+   double                                    *covariances,
+   double                                    *residuals,
+   bool                                      *valid)
+{
+   int count = 0;
+   for (int i = first; i < last; i++)
+   {
+      int start = matchStart[i];
+      bool ok;
+      try
+      {
+         ok = UsgsAstroTriangulation::triangulate(
+            matchStart[i + 1] - start, observations + start, groundPts[i],
+            covariances ? covariances + 9 * i : NULL,
+            residuals ? residuals + start : NULL);
+      }
+      catch (csm::Error &)
+      {
+         ok = false;
+      }
+      if (valid)
+      {
+         valid[i] = ok;
+      }
+      if (ok)
+      {
+         count++;
+      }
+   }
+   return count;
+}
+
+int UsgsAstroTriangulation::triangulate(
+   int                numMatches,
+   const int         *matchStart,
+   const Observation *observations,
+   csm::EcefCoord    *groundPts,
+   double            *covariances,
+   double            *residuals,
+   bool              *valid,
+   int                numThreads)
+{
+   numThreads = UsgsAstroParallel::numThreads(
+      numThreads, numMatches, MIN_MATCHES_PER_THREAD);
+
+   // Contiguous blocks of matches
+   std::vector<int> numValid(numThreads, 0);
+   UsgsAstroParallel::parallelFor(numMatches, numThreads,
+      [&](int block, int first, int last)
+      {
+         numValid[block] = triangulateMatches(
+            first, last, matchStart, observations, groundPts, covariances,
+            residuals, valid);
+      });
+
+   int total = 0;
+   for (int t = 0; t < numThreads; t++)
+   {
+      total += numValid[t];
+   }
+   return total;
+}
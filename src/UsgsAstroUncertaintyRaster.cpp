@@ -0,0 +1,373 @@
+//----------------------------------------------------------------------------
+//
+//  Description:
+//    Raster of the ground covariance of every pixel of an image region,
+//    for models that implement the covariance form of imageToGround.
+//
+//-----------------------------------------------------------------------------
+#define USGSASTROLINESCANNER_LIBRARY
+
+#include "UsgsAstroUncertaintyRaster.h"
+#include "UsgsAstroParallel.h"
+
+#include <Error.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Pixels along each side of a tile.
+static const int TILE_SIZE = 64;
+
+// Covariance entries kept per pixel, and their row and column.
+static const int NUM_ENTRIES = 6;
+static const int ENTRY_ROW[NUM_ENTRIES] = { 0, 0, 0, 1, 1, 2 };
+static const int ENTRY_COLUMN[NUM_ENTRIES] = { 0, 1, 2, 1, 2, 2 };
+static const int DIAGONAL_ENTRY[3] = { 0, 3, 5 };
+
+//*****************************************************************************
+// Adaptive interpolation of the covariance over one tile
+//*****************************************************************************
+namespace
+{
+
+struct Node
+{
+   bool   valid;
+   double covariance[NUM_ENTRIES];
+};
+
+class TileRefiner
+{
+public:
+
+   TileRefiner(
+      const csm::RasterGM &model,
+      double               height,
+      double               heightVariance,
+      double               tolerance,
+      const double        *imageCovariance,
+      double               firstLine,
+      double               firstSample,
+      double               spacing,
+      int                  numSamples,
+      double              *covariances)
+   :
+      m_Model(model),
+      m_Height(height),
+      m_HeightVariance(heightVariance),
+      m_Tolerance(tolerance),
+      m_ImageCovariance(imageCovariance),
+      m_FirstLine(firstLine),
+      m_FirstSample(firstSample),
+      m_Spacing(spacing),
+      m_NumSamples(numSamples),
+      m_Covariances(covariances),
+      m_RowEnd(0),
+      m_ColumnEnd(0),
+      m_ErrorBound(0.0),
+      m_NumEvaluations(0)
+   {}
+
+   // Starts a tile, of which only the pixels before row rowEnd and column
+   // columnEnd are written.  The next tiles write the others.
+   void startTile(int rowEnd, int columnEnd)
+   {
+      m_Nodes.clear();
+      m_RowEnd = rowEnd;
+      m_ColumnEnd = columnEnd;
+   }
+
+   // Fills the pixels from row ra and column ca up to row rb and column
+   // cb, both included.
+   void refine(int ra, int ca, int rb, int cb);
+
+   double getErrorBound() const { return m_ErrorBound; }
+   int getNumEvaluations() const { return m_NumEvaluations; }
+
+private:
+
+   // Returns the rigorous covariance of a pixel, evaluating it once.
+   const Node &node(int r, int c);
+
+   // Interpolates the corners of a cell at fractions u along the rows and
+   // v along the columns.
+   static void interpolate(
+      const Node *corners[4],
+      double      u,
+      double      v,
+      double      covariance[NUM_ENTRIES]);
+
+   // Writes a covariance, or NaN for none, to a pixel.
+   void write(int r, int c, const double *covariance);
+
+   const csm::RasterGM &m_Model;
+   double               m_Height;
+   double               m_HeightVariance;
+   double               m_Tolerance;
+   const double        *m_ImageCovariance;
+   double               m_FirstLine;
+   double               m_FirstSample;
+   double               m_Spacing;
+   int                  m_NumSamples;
+   double              *m_Covariances;
+   int                  m_RowEnd;
+   int                  m_ColumnEnd;
+   double               m_ErrorBound;
+   int                  m_NumEvaluations;
+   std::map<long long, Node> m_Nodes;
+};
+
+const Node &TileRefiner::node(int r, int c)
+{
+   long long key = (long long)r * (m_NumSamples + 1) + c;
+   std::map<long long, Node>::iterator it = m_Nodes.find(key);
+   if (it != m_Nodes.end())
+   {
+      return it->second;
+   }
+
+   Node &result = m_Nodes[key];
+   result.valid = false;
+   m_NumEvaluations++;
+   csm::ImageCoordCovar imagePt(
+      m_FirstLine + r * m_Spacing, m_FirstSample + c * m_Spacing);
+   std::copy(m_ImageCovariance, m_ImageCovariance + 4, imagePt.covariance);
+   try
+   {
+      csm::EcefCoordCovar groundPt =
+         m_Model.imageToGround(imagePt, m_Height, m_HeightVariance);
+      for (int k = 0; k < NUM_ENTRIES; k++)
+      {
+         result.covariance[k] =
+            groundPt.covariance[3 * ENTRY_ROW[k] + ENTRY_COLUMN[k]];
+      }
+      result.valid = true;
+   }
+   catch (csm::Error &)
+   {
+   }
+   return result;
+}
+
+void TileRefiner::interpolate(
+   const Node *corners[4],
+   double      u,
+   double      v,
+   double      covariance[NUM_ENTRIES])
+{
+   double w[4] = { (1.0 - u) * (1.0 - v), (1.0 - u) * v,
+                   u * (1.0 - v), u * v };
+   for (int k = 0; k < NUM_ENTRIES; k++)
+   {
+      covariance[k] = w[0] * corners[0]->covariance[k]
+                    + w[1] * corners[1]->covariance[k]
+                    + w[2] * corners[2]->covariance[k]
+                    + w[3] * corners[3]->covariance[k];
+   }
+}
+
+void TileRefiner::write(int r, int c, const double *covariance)
+{
+   if (r >= m_RowEnd || c >= m_ColumnEnd)
+   {
+      return;
+   }
+   double *pixel = m_Covariances + NUM_ENTRIES * ((long long)r * m_NumSamples + c);
+   for (int k = 0; k < NUM_ENTRIES; k++)
+   {
+      pixel[k] = covariance
+               ? covariance[k] : std::numeric_limits<double>::quiet_NaN();
+   }
+}
+
+void TileRefiner::refine(int ra, int ca, int rb, int cb)
+{
+   const Node *corners[4] =
+      { &node(ra, ca), &node(ra, cb), &node(rb, ca), &node(rb, cb) };
+   bool valid = corners[0]->valid && corners[1]->valid
+             && corners[2]->valid && corners[3]->valid;
+
+   // Cells of single pixels and their neighbours hold only corners
+   if (rb - ra <= 1 && cb - ca <= 1)
+   {
+      for (int r = ra; r <= rb; r++)
+      {
+         for (int c = ca; c <= cb; c++)
+         {
+            const Node &pixel = node(r, c);
+            write(r, c, pixel.valid ? pixel.covariance : NULL);
+         }
+      }
+      return;
+   }
+
+   int rm = (ra + rb) / 2;
+   int cm = (ca + cb) / 2;
+   if (valid)
+   {
+      const Node &center = node(rm, cm);
+      double interpolated[NUM_ENTRIES];
+      interpolate(corners,
+                  rb > ra ? (rm - ra) / (double)(rb - ra) : 0.0,
+                  cb > ca ? (cm - ca) / (double)(cb - ca) : 0.0,
+                  interpolated);
+      double deviation = 0.0;
+      if (center.valid)
+      {
+         for (int k = 0; k < NUM_ENTRIES; k++)
+         {
+            double scale = sqrt(
+               center.covariance[DIAGONAL_ENTRY[ENTRY_ROW[k]]] *
+               center.covariance[DIAGONAL_ENTRY[ENTRY_COLUMN[k]]]);
+            double difference = fabs(interpolated[k] - center.covariance[k]);
+            deviation = std::max(deviation,
+               scale > 0.0 ? difference / scale : difference);
+         }
+      }
+      if (center.valid && deviation <= m_Tolerance)
+      {
+         m_ErrorBound = std::max(m_ErrorBound, deviation);
+         double covariance[NUM_ENTRIES];
+         for (int r = ra; r <= rb; r++)
+         {
+            for (int c = ca; c <= cb; c++)
+            {
+               interpolate(corners,
+                           rb > ra ? (r - ra) / (double)(rb - ra) : 0.0,
+                           cb > ca ? (c - ca) / (double)(cb - ca) : 0.0,
+                           covariance);
+               write(r, c, covariance);
+            }
+         }
+         return;
+      }
+   }
+
+   // Split across the dimensions longer than a pixel
+   if (rb - ra <= 1)
+   {
+      refine(ra, ca, rb, cm);
+      refine(ra, cm, rb, cb);
+   }
+   else if (cb - ca <= 1)
+   {
+      refine(ra, ca, rm, cb);
+      refine(rm, ca, rb, cb);
+   }
+   else
+   {
+      refine(ra, ca, rm, cm);
+      refine(ra, cm, rm, cb);
+      refine(rm, ca, rb, cm);
+      refine(rm, cm, rb, cb);
+   }
+}
+
+}
+
+//*****************************************************************************
+// UsgsAstroUncertaintyRaster Constructor
+//*****************************************************************************
+UsgsAstroUncertaintyRaster::UsgsAstroUncertaintyRaster(
+   const csm::RasterGM &model,
+   double               height,
+   double               heightVariance,
+   double               tolerance,
+   const double        *imageCovariance)
+:
+   m_Model(&model),
+   m_Height(height),
+   m_HeightVariance(heightVariance),
+   m_Tolerance(tolerance),
+   m_ErrorBound(0.0),
+   m_NumEvaluations(0)
+{
+   for (int k = 0; k < 4; k++)
+   {
+      m_ImageCovariance[k] = imageCovariance ? imageCovariance[k] : 0.0;
+   }
+}
+
+//*****************************************************************************
+// UsgsAstroUncertaintyRaster::compute
+//*****************************************************************************
+int UsgsAstroUncertaintyRaster::compute(
+   double  firstLine,
+   double  firstSample,
+   double  spacing,
+   int     numLines,
+   int     numSamples,
+   double *covariances,
+   int     numThreads)
+{
+   m_ErrorBound = 0.0;
+   m_NumEvaluations = 0;
+   if (numLines <= 0 || numSamples <= 0)
+   {
+      return 0;
+   }
+
+   // Tiles evaluate their last row and column, shared with the next ones,
+   // but leave them to the next ones to write
+   int tileRows = std::max(1, (numLines - 1 + TILE_SIZE - 1) / TILE_SIZE);
+   int tileColumns = std::max(1, (numSamples - 1 + TILE_SIZE - 1) / TILE_SIZE);
+   int numTiles = tileRows * tileColumns;
+   numThreads = UsgsAstroParallel::numThreads(numThreads, numTiles, 1);
+
+   // Threads take the next tile as they finish one, since the tiles that
+   // need refining take longer, so each block is one thread
+   std::atomic<int> nextTile(0);
+   std::vector<double> errorBounds(numThreads, 0.0);
+   std::vector<int> numEvaluations(numThreads, 0);
+   UsgsAstroParallel::parallelFor(numThreads, numThreads,
+      [&](int t, int, int)
+      {
+         TileRefiner refiner(
+            *m_Model, m_Height, m_HeightVariance, m_Tolerance,
+            m_ImageCovariance, firstLine, firstSample, spacing, numSamples,
+            covariances);
+         try
+         {
+            for (int tile = nextTile++; tile < numTiles; tile = nextTile++)
+            {
+               int ra = (tile / tileColumns) * TILE_SIZE;
+               int ca = (tile % tileColumns) * TILE_SIZE;
+               bool lastRow = ra + TILE_SIZE >= numLines - 1;
+               bool lastColumn = ca + TILE_SIZE >= numSamples - 1;
+               refiner.startTile(lastRow ? numLines : ra + TILE_SIZE,
+                                 lastColumn ? numSamples : ca + TILE_SIZE);
+               refiner.refine(ra, ca, std::min(numLines - 1, ra + TILE_SIZE),
+                              std::min(numSamples - 1, ca + TILE_SIZE));
+            }
+         }
+         catch (...)
+         {
+            // Errors other than failed evaluations go to the calling
+            // thread, with the other threads stopped at their tiles
+            nextTile = numTiles;
+            throw;
+         }
+         errorBounds[t] = refiner.getErrorBound();
+         numEvaluations[t] = refiner.getNumEvaluations();
+      });
+
+   for (int t = 0; t < numThreads; t++)
+   {
+      m_ErrorBound = std::max(m_ErrorBound, errorBounds[t]);
+      m_NumEvaluations += numEvaluations[t];
+   }
+
+   int numValid = 0;
+   for (long long i = 0; i < (long long)numLines * numSamples; i++)
+   {
+      if (!std::isnan(covariances[NUM_ENTRIES * i]))
+      {
+         numValid++;
+      }
+   }
+   return numValid;
+}
@@ -1,8 +1,27 @@
+#include "UsgsAstroBackplanes.h"
+#include "UsgsAstroDistortion.h"
+#include "UsgsAstroEpipolarCurve.h"
 #include "UsgsAstroFramePlugin.h"
+#include "UsgsAstroFrameSensorModel.h"
+#include "UsgsAstroGeodesy.h"
+#include "UsgsAstroLsLineTimeTable.h"
+#include "UsgsAstroLsSensorModel.h"
+#include "UsgsAstroLsStateData.h"
+#include "UsgsAstroLsTrajectory.h"
+#include "UsgsAstroParallel.h"
+#include "UsgsAstroRpcModel.h"
+#include "UsgsAstroTriangulation.h"
+#include "UsgsAstroUncertaintyRaster.h"
+
+#include <Error.h>
 
 #include <json/json.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <math.h>
+#include <memory>
+#include <stdexcept>
 
 #include <gtest/gtest.h>
 
@@ -23,6 +42,108 @@ class FrameIsdTest : public ::testing::Test {
    }
 };
 
+// Nadir pushbroom of 5000 lines and samples, 300 km above a Mars sized
+// ellipsoid on a circular orbit, with the boresight frame along track,
+// across track and up.
+class LsSyntheticTest : public ::testing::Test {
+   protected:
+
+      UsgsAstroLsStateData state;
+      UsgsAstroLsSensorModel model;
+
+   virtual void SetUp() {
+      state.m_TotalLines = 5000;
+      state.m_TotalSamples = 5000;
+      state.m_SemiMajorAxis = 3396190.0;
+      state.m_SemiMinorAxis = 3376200.0;
+      state.m_Focal = 350.0;
+      state.m_TrajectoryIdentifier = "SYNTHETIC_ORBIT";
+      state.m_IntTimeLines.assign(1, 1.0);
+      state.m_IntTimeStartTimes.assign(1, -5.0);
+      state.m_IntTimes.assign(1, 0.002);
+
+      state.m_T0Ephem = -30.0;
+      state.m_DtEphem = 1.0;
+      state.m_NumEphem = 61;
+      for (int i = 0; i < state.m_NumEphem; i++) {
+         double p[3], v[3];
+         orbit(state.m_T0Ephem + i * state.m_DtEphem, p, v);
+         state.m_EphemPts.insert(state.m_EphemPts.end(), p, p + 3);
+         state.m_EphemRates.insert(state.m_EphemRates.end(), v, v + 3);
+      }
+
+      state.m_T0Quat = -10.0;
+      state.m_DtQuat = 0.1;
+      state.m_NumQuaternions = 201;
+      for (int i = 0; i < state.m_NumQuaternions; i++) {
+         double p[3], v[3];
+         orbit(state.m_T0Quat + i * state.m_DtQuat, p, v);
+         double rp = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+         double rv = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+         double up[3] = { p[0] / rp, p[1] / rp, p[2] / rp };
+         double along[3] = { v[0] / rv, v[1] / rv, v[2] / rv };
+         double across[3] = { up[1] * along[2] - up[2] * along[1],
+                              up[2] * along[0] - up[0] * along[2],
+                              up[0] * along[1] - up[1] * along[0] };
+         double r[9] = { along[0], across[0], up[0],
+                         along[1], across[1], up[1],
+                         along[2], across[2], up[2] };
+         double q[4];
+         toQuaternion(r, q);
+         state.m_Quaternions.insert(state.m_Quaternions.end(), q, q + 4);
+      }
+      model.set(state);
+   }
+
+   // Position and velocity on the orbit at a time.
+   static void orbit(double t, double p[3], double v[3]) {
+      double r = 3396190.0 + 300000.0;
+      double inclination = 1.2;
+      double rate = 2.0 * M_PI / 6000.0;
+      double c = cos(rate * t + 0.3);
+      double s = sin(rate * t + 0.3);
+      p[0] = r * c;
+      p[1] = r * s * cos(inclination);
+      p[2] = r * s * sin(inclination);
+      v[0] = -r * rate * s;
+      v[1] = r * rate * c * cos(inclination);
+      v[2] = r * rate * c * sin(inclination);
+   }
+
+   // Quaternion, scalar last, of a rotation matrix.
+   static void toQuaternion(const double r[9], double q[4]) {
+      double trace = r[0] + r[4] + r[8];
+      if (trace > 0.0) {
+         double s = 2.0 * sqrt(trace + 1.0);
+         q[0] = (r[7] - r[5]) / s;
+         q[1] = (r[2] - r[6]) / s;
+         q[2] = (r[3] - r[1]) / s;
+         q[3] = 0.25 * s;
+      }
+      else if (r[0] > r[4] && r[0] > r[8]) {
+         double s = 2.0 * sqrt(1.0 + r[0] - r[4] - r[8]);
+         q[0] = 0.25 * s;
+         q[1] = (r[1] + r[3]) / s;
+         q[2] = (r[2] + r[6]) / s;
+         q[3] = (r[7] - r[5]) / s;
+      }
+      else if (r[4] > r[8]) {
+         double s = 2.0 * sqrt(1.0 + r[4] - r[0] - r[8]);
+         q[0] = (r[1] + r[3]) / s;
+         q[1] = 0.25 * s;
+         q[2] = (r[5] + r[7]) / s;
+         q[3] = (r[2] - r[6]) / s;
+      }
+      else {
+         double s = 2.0 * sqrt(1.0 + r[8] - r[0] - r[4]);
+         q[0] = (r[2] + r[6]) / s;
+         q[1] = (r[5] + r[7]) / s;
+         q[2] = 0.25 * s;
+         q[3] = (r[3] - r[1]) / s;
+      }
+   }
+};
+
 TEST(FramePluginTests, PluginName) {
    UsgsAstroFramePlugin testPlugin;
    EXPECT_EQ("UsgsAstroFramePluginCSM", testPlugin.getPluginName());;
@@ -85,6 +206,1677 @@ TEST(FramePluginTests, MissingStateValue) {
                "USGS_ASTRO_FRAME_SENSOR_MODEL"));
 } */
 
+TEST(LsTrajectoryTests, FixedOrderMatchesVariableOrder) {
+   UsgsAstroLsStateData state;
+   state.m_NumEphem = 20;
+   state.m_T0Ephem = -10.0;
+   state.m_DtEphem = 1.0;
+   for (int i = 0; i < 3 * state.m_NumEphem; i++) {
+      state.m_EphemPts.push_back(3.0e6 * sin(0.01 * i + 0.3));
+      state.m_EphemRates.push_back(3.0e3 * cos(0.01 * i + 0.3));
+   }
+   UsgsAstroLsTrajectory trajectory(state);
+
+   // Walk through both ends, where the fixed order kernels fall back.
+   for (double time = -11.0; time < 11.0; time += 0.137) {
+      double pos[3], vel[3], fixedPos[3], fixedVel[3];
+      trajectory.getPositionVelocity(time, 8, pos, vel);
+      trajectory.getPositionVelocity<8>(time, fixedPos, fixedVel);
+      for (int i = 0; i < 3; i++) {
+         EXPECT_DOUBLE_EQ(pos[i], fixedPos[i]);
+         EXPECT_DOUBLE_EQ(vel[i], fixedVel[i]);
+      }
+      trajectory.getPositionVelocity(time, 4, pos, vel);
+      trajectory.getPositionVelocity<4>(time, fixedPos, fixedVel);
+      for (int i = 0; i < 3; i++) {
+         EXPECT_DOUBLE_EQ(pos[i], fixedPos[i]);
+         EXPECT_DOUBLE_EQ(vel[i], fixedVel[i]);
+      }
+   }
+}
+
+TEST(LsTrajectoryTests, HermiteEphemeris) {
+   // Circular orbit 400 km above Mars, posts every second
+   double radius = 3.79e6;
+   double rate = 1.0e-3;
+   UsgsAstroLsStateData state;
+   state.m_NumEphem = 300;
+   state.m_T0Ephem = -150.0;
+   state.m_DtEphem = 1.0;
+   for (int i = 0; i < state.m_NumEphem; i++) {
+      double angle = rate * (state.m_T0Ephem + i * state.m_DtEphem);
+      state.m_EphemPts.push_back(radius * cos(angle));
+      state.m_EphemPts.push_back(radius * sin(angle));
+      state.m_EphemPts.push_back(0.0);
+      state.m_EphemRates.push_back(-radius * rate * sin(angle));
+      state.m_EphemRates.push_back(radius * rate * cos(angle));
+      state.m_EphemRates.push_back(0.0);
+   }
+   UsgsAstroLsTrajectory trajectory(state);
+
+   // The accelerations are differenced to lower order at the two posts
+   // nearest each end, which makes the intervals there less accurate
+   double maxInterior = 0.0, maxEnds = 0.0;
+   for (double time = -150.0; time <= 149.0; time += 0.37) {
+      double pos[3], vel[3];
+      trajectory.getHermitePositionVelocity(time, pos, vel);
+      EXPECT_NEAR(-radius * rate * sin(rate * time), vel[0], 1.0e-6);
+      EXPECT_NEAR(radius * rate * cos(rate * time), vel[1], 1.0e-6);
+      double error = std::hypot(pos[0] - radius * cos(rate * time),
+                                pos[1] - radius * sin(rate * time));
+      if (time > -148.0 && time < 147.0) {
+         maxInterior = std::max(maxInterior, error);
+      }
+      else {
+         maxEnds = std::max(maxEnds, error);
+      }
+   }
+   EXPECT_LT(maxInterior, 2.0e-9);
+   EXPECT_LT(maxEnds, 1.0e-7);
+}
+
+TEST(LsTrajectoryTests, RotationMatchesQuaternion) {
+   UsgsAstroLsStateData state;
+   state.m_NumQuaternions = 12;
+   state.m_T0Quat = -3.0;
+   state.m_DtQuat = 0.5;
+   for (int i = 0; i < state.m_NumQuaternions; i++) {
+      double angle = 0.05 * i;
+      double q[4] = {0.1 * sin(angle), 0.2 * cos(angle),
+                     0.3 * sin(2.0 * angle), 0.9};
+      double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      for (int k = 0; k < 4; k++) {
+         state.m_Quaternions.push_back(q[k] / norm);
+      }
+   }
+   UsgsAstroLsTrajectory trajectory(state);
+
+   for (double time = -3.5; time < 3.5; time += 0.0731) {
+      double q[4], rotation[9];
+      trajectory.getQuaternion(time, 8, q);
+      trajectory.getRotationMatrix<8>(time, rotation);
+      double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      for (int i = 0; i < 4; i++) {
+         q[i] /= norm;
+      }
+      EXPECT_NEAR(q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3],
+                  rotation[0], 1.0e-12);
+      EXPECT_NEAR(2 * (q[1] * q[2] - q[0] * q[3]), rotation[5], 1.0e-12);
+      EXPECT_NEAR(2 * (q[0] * q[2] - q[1] * q[3]), rotation[6], 1.0e-12);
+
+      // Orthonormal without normalizing the quaternion
+      for (int i = 0; i < 3; i++) {
+         for (int j = 0; j < 3; j++) {
+            double dot = rotation[i] * rotation[j]
+                       + rotation[i + 3] * rotation[j + 3]
+                       + rotation[i + 6] * rotation[j + 6];
+            EXPECT_NEAR(i == j ? 1.0 : 0.0, dot, 1.0e-12);
+         }
+      }
+   }
+}
+
+TEST(GeodesyTests, HeightAndIntersection) {
+   double a = 3396190.0;
+   double b = 3376200.0;
+   double e2 = 1.0 - b * b / (a * a);
+   UsgsAstroGeodesy geodesy(a, b);
+
+   for (double lat = -1.5; lat <= 1.5; lat += 0.25) {
+      for (double height = -8000.0; height <= 400000.0; height += 51000.0) {
+         double n = a / sqrt(1.0 - e2 * sin(lat) * sin(lat));
+         double x = (n + height) * cos(lat) * cos(0.7);
+         double y = (n + height) * cos(lat) * sin(0.7);
+         double z = (n * (1.0 - e2) + height) * sin(lat);
+         double computedLat, computedHeight;
+         ASSERT_TRUE(geodesy.toGeodetic(x, y, z, computedLat, computedHeight));
+         EXPECT_NEAR(lat, computedLat, 1.0e-12);
+         EXPECT_NEAR(height, computedHeight, 1.0e-6);
+      }
+   }
+
+   // Oblique ray from orbit down to 2 km above the ellipsoid
+   double xc = 3.0e6, yc = 1.0e6, zc = 2.0e6;
+   double xl = -0.8, yl = -0.1, zl = -0.45;
+   double x, y, z, achieved, height, lat;
+   int steps = geodesy.intersect(2000.0, xc, yc, zc, xl, yl, zl, x, y, z,
+                                 achieved, 0.001);
+   EXPECT_GE(steps, 0);
+   EXPECT_LE(steps, 2);
+   EXPECT_LT(achieved, 0.001);
+   ASSERT_TRUE(geodesy.toGeodetic(x, y, z, lat, height));
+   EXPECT_NEAR(2000.0, height, 0.001);
+}
+
+TEST(DistortionTests, InverseAndJacobian) {
+   std::vector<double> taylor(20, 0.0);
+   taylor[1] = 1.0;
+   taylor[6] = 1.0e-4;
+   taylor[12] = 1.0;
+   taylor[14] = 2.0e-5;
+   std::vector<std::shared_ptr<const UsgsAstroDistortion>> models = {
+      UsgsAstroDistortion::create("NONE", std::vector<double>()),
+      UsgsAstroDistortion::create("RADIAL", {1.0e-4, 2.0e-5, 1.0e-8}),
+      UsgsAstroDistortion::create("TAYLOR", taylor),
+      UsgsAstroDistortion::create("TRANSVERSE", {1.0e-4})
+   };
+
+   for (auto &model : models) {
+      for (double ux = -12.0; ux <= 12.0; ux += 3.0) {
+         double uy = 0.5 * ux + 1.0;
+         double dx, dy, rx, ry;
+         model->distort(ux, uy, dx, dy);
+         model->undistort(dx, dy, rx, ry);
+         EXPECT_NEAR(ux, rx, 1.0e-5);
+         EXPECT_NEAR(uy, ry, 1.0e-5);
+
+         double Jxx, Jxy, Jyx, Jyy;
+         model->jacobian(ux, uy, Jxx, Jxy, Jyx, Jyy);
+         double h = 1.0e-4;
+         double dx1, dy1, dx2, dy2;
+         model->distort(ux + h, uy, dx1, dy1);
+         model->distort(ux - h, uy, dx2, dy2);
+         EXPECT_NEAR(Jxx, (dx1 - dx2) / (2 * h), 1.0e-6);
+         EXPECT_NEAR(Jyx, (dy1 - dy2) / (2 * h), 1.0e-6);
+         model->distort(ux, uy + h, dx1, dy1);
+         model->distort(ux, uy - h, dx2, dy2);
+         EXPECT_NEAR(Jxy, (dx1 - dx2) / (2 * h), 1.0e-6);
+         EXPECT_NEAR(Jyy, (dy1 - dy2) / (2 * h), 1.0e-6);
+      }
+   }
+}
+
+TEST(DistortionTests, UnknownModel) {
+   EXPECT_FALSE(UsgsAstroDistortion::isRegistered("NOT_A_MODEL"));
+   EXPECT_THROW(UsgsAstroDistortion::create("NOT_A_MODEL", std::vector<double>()),
+                csm::Error);
+}
+
+TEST(LsLineTimeTableTests, MatchesSearch) {
+   // Synthetic variable line rate image with 10000 segments of uneven
+   // lengths and integration times.
+   std::vector<double> lines, startTimes, intTimes;
+   double line = 1.0, time = 100.0;
+   for (int i = 0; i < 10000; i++) {
+      lines.push_back(line);
+      startTimes.push_back(time);
+      intTimes.push_back(1.0e-3 * (1.0 + 0.5 * sin(0.37 * i)));
+      double length = 1 + (i * 7919) % 53;
+      line += length;
+      time += length * intTimes.back();
+   }
+   UsgsAstroLsLineTimeTable table(lines, startTimes, intTimes);
+
+   for (double l = -10.0; l < line + 10.0; l += 3.3) {
+      int expected = std::max(0, (int)(std::upper_bound(lines.begin(),
+         lines.end(), l) - lines.begin()) - 1);
+      ASSERT_EQ(expected, table.getLineSegment(l));
+      double t = table.lineToTime(l);
+      EXPECT_DOUBLE_EQ(startTimes[expected]
+         + intTimes[expected] * (l - lines[expected]), t);
+   }
+   for (int i = 0; i < 10000; i++) {
+      EXPECT_EQ(i, table.getTimeSegment(startTimes[i]));
+      EXPECT_NEAR(lines[i] + 0.25,
+                  table.timeToLine(startTimes[i] + 0.25 * intTimes[i]),
+                  1.0e-9);
+   }
+}
+
+TEST(RpcModelTests, RestoredRoundTrip) {
+   double offsets[5] = { 500.0, 400.0, 16.2, 6.4, 0.0 };
+   double scales[5] = { 500.0, 400.0, 0.4, 0.4, 8000.0 };
+   double coefficients[4 * UsgsAstroRpcModel::NUM_TERMS] = { 0.0 };
+   double *lineNum = coefficients;
+   double *lineDen = lineNum + UsgsAstroRpcModel::NUM_TERMS;
+   double *sampNum = lineDen + UsgsAstroRpcModel::NUM_TERMS;
+   double *sampDen = sampNum + UsgsAstroRpcModel::NUM_TERMS;
+   lineNum[2] = -1.0;
+   lineNum[3] = 0.01;
+   lineNum[5] = 0.02;
+   lineDen[0] = 1.0;
+   lineDen[1] = 0.01;
+   sampNum[1] = 1.0;
+   sampNum[8] = 0.05;
+   sampDen[0] = 1.0;
+   sampDen[3] = 0.01;
+   UsgsAstroRpcModel rpc(3396190.0, 3376200.0, offsets, scales, coefficients);
+
+   for (double line = 0.0; line <= 1000.0; line += 125.0) {
+      for (double samp = 0.0; samp <= 800.0; samp += 100.0) {
+         csm::EcefCoord ground = rpc.imageToGround(
+            csm::ImageCoord(line, samp), 1500.0);
+         csm::ImageCoord image = rpc.groundToImage(ground);
+         EXPECT_NEAR(line, image.line, 1.0e-6);
+         EXPECT_NEAR(samp, image.samp, 1.0e-6);
+      }
+   }
+
+   csm::EcefCoord center = rpc.imageToGround(csm::ImageCoord(500.0, 400.0), 0.0);
+   EXPECT_NEAR(6.4, atan2(center.y, center.x) * 180.0 / 3.14159265358979323846,
+               1.0e-9);
+}
+
+TEST(ParallelTests, BlocksCoverItemsAndRethrow) {
+   EXPECT_EQ(1, UsgsAstroParallel::numThreads(8, 100, 64));
+   EXPECT_EQ(3, UsgsAstroParallel::numThreads(3, 1000, 64));
+   EXPECT_GE(UsgsAstroParallel::numThreads(0, 1000000, 1), 1);
+
+   // Every item is in exactly one block, the sizes differing by one
+   std::vector<int> counts(1000, 0);
+   std::vector<int> sizes(7, 0);
+   UsgsAstroParallel::parallelFor(1000, 7,
+      [&](int block, int first, int last) {
+         sizes[block] = last - first;
+         for (int i = first; i < last; i++) {
+            counts[i]++;
+         }
+      });
+   EXPECT_EQ(1000, (int)std::count(counts.begin(), counts.end(), 1));
+   EXPECT_LE(*std::max_element(sizes.begin(), sizes.end())
+             - *std::min_element(sizes.begin(), sizes.end()), 1);
+
+   // An error on a worker thread reaches the calling thread once the
+   // other blocks have finished
+   std::fill(counts.begin(), counts.end(), 0);
+   EXPECT_THROW(
+      UsgsAstroParallel::parallelFor(1000, 7,
+         [&](int block, int first, int last) {
+            if (block == 2) {
+               throw std::runtime_error("block 2");
+            }
+            for (int i = first; i < last; i++) {
+               counts[i]++;
+            }
+         }),
+      std::runtime_error);
+   EXPECT_EQ(1000 - sizes[2],
+             (int)std::count(counts.begin(), counts.end(), 1));
+}
+
+TEST(EpipolarCurveTests, WithinTolerance) {
+   // Vertical ray onto a sphere, projected to a line quadratic in height,
+   // and not viewed above 9 km
+   double r = 3396190.0;
+   csm::EcefLocus ray(r + 400000.0, 0.0, 0.0, -1.0, 0.0, 0.0);
+   UsgsAstroEpipolarCurve::Projector project =
+      [r](const csm::EcefCoord &ground, csm::ImageCoord &image) {
+         double height = ground.x - r;
+         image.line = 1.0e-5 * height * height;
+         image.samp = 0.01 * height;
+         return height < 9000.0;
+      };
+   UsgsAstroEpipolarCurve curve(ray, r, r, -2000.0, 10000.0, 0.1, project);
+
+   const std::vector<UsgsAstroEpipolarCurve::Vertex> &vertices =
+      curve.getVertices();
+   ASSERT_GE(vertices.size(), 3u);
+   EXPECT_EQ(-2000.0, vertices.front().height);
+   EXPECT_EQ(10000.0, vertices.back().height);
+   EXPECT_FALSE(vertices.back().valid);
+   EXPECT_LE(curve.getErrorBound(), 0.1);
+
+   for (double height = -2000.0; height <= 10000.0; height += 50.0) {
+      csm::ImageCoord image;
+      bool inside = curve.interpolate(height, image);
+      if (height <= 7000.0) {
+         ASSERT_TRUE(inside);
+         EXPECT_NEAR(1.0e-5 * height * height, image.line, 0.1);
+         EXPECT_NEAR(0.01 * height, image.samp, 1.0e-9);
+      }
+      else if (height > 9000.0) {
+         EXPECT_FALSE(inside);
+      }
+   }
+}
+
+TEST(EpipolarCurveTests, GapNotInterpolated) {
+   // The projection of the WithinTolerance test, not viewed between 2 and
+   // 3 km, in the middle of the start interval from 1 to 4 km
+   double r = 3396190.0;
+   csm::EcefLocus ray(r + 400000.0, 0.0, 0.0, -1.0, 0.0, 0.0);
+   UsgsAstroEpipolarCurve::Projector project =
+      [r](const csm::EcefCoord &ground, csm::ImageCoord &image) {
+         double height = ground.x - r;
+         image.line = 1.0e-5 * height * height;
+         image.samp = 0.01 * height;
+         return height < 2000.0 || height > 3000.0;
+      };
+   UsgsAstroEpipolarCurve curve(ray, r, r, -2000.0, 10000.0, 0.1, project);
+   EXPECT_LE(curve.getErrorBound(), 0.1);
+
+   for (double height = -2000.0; height <= 10000.0; height += 50.0) {
+      csm::ImageCoord image;
+      bool inside = curve.interpolate(height, image);
+      if (height <= 1000.0 || height > 4000.0) {
+         ASSERT_TRUE(inside);
+         EXPECT_NEAR(1.0e-5 * height * height, image.line, 0.1);
+         EXPECT_NEAR(0.01 * height, image.samp, 1.0e-9);
+      }
+      else if (height >= 2000.0 && height <= 3000.0) {
+         EXPECT_FALSE(inside);
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, GroundToImageBeyondSampleEdges) {
+   // Off the sample edges but within the image lines, the ground point is
+   // viewed and projects
+   csm::ImageCoord imagePt(2500.5, 5600.0);
+   csm::EcefCoord groundPt = model.imageToGround(imagePt, 0.0);
+   EXPECT_TRUE(model.isPossiblyVisible(groundPt));
+
+   csm::ImageCoord result = model.groundToImage(groundPt);
+   EXPECT_NEAR(imagePt.line, result.line, 1.0e-3);
+   EXPECT_NEAR(imagePt.samp, result.samp, 1.0e-3);
+   EXPECT_NO_THROW(model.computeGroundPartials(groundPt));
+
+   // Off either end of the image lines it is not, whatever the sample
+   csm::EcefCoord before =
+      model.imageToGround(csm::ImageCoord(-200.5, 5600.0), 0.0);
+   EXPECT_FALSE(model.isPossiblyVisible(before));
+   EXPECT_THROW(model.groundToImage(before), csm::Error);
+   EXPECT_THROW(model.computeGroundPartials(before), csm::Error);
+   csm::EcefCoord after =
+      model.imageToGround(csm::ImageCoord(5200.5, 1200.5), 0.0);
+   EXPECT_FALSE(model.isPossiblyVisible(after));
+   EXPECT_THROW(model.groundToImage(after), csm::Error);
+
+   // Across and beyond the image it agrees with the status of the search
+   for (double line = -1000.5; line < 6000.0; line += 137.0) {
+      for (double samp = -3000.5; samp < 8000.0; samp += 1100.0) {
+         csm::EcefCoord pt =
+            model.imageToGround(csm::ImageCoord(line, samp), 500.0);
+         csm::ImageCoord projected;
+         bool viewed = model.tryGroundToImage(pt, projected)
+                       != UsgsAstroLsSensorModel::PROJECTION_NOT_VIEWED;
+         EXPECT_EQ(viewed, model.isPossiblyVisible(pt))
+            << "line " << line << ", sample " << samp;
+         EXPECT_EQ(line > 0.0 && line < 5000.0, viewed)
+            << "line " << line << ", sample " << samp;
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, UncertaintyRasterMatchesDense) {
+   state.m_FlyingHeight = 300000.0;
+   state.m_HalfSwath = 20000.0;
+   state.m_HalfTime = 10.0;
+   for (int i = 0; i < 16; i++) {
+      state.m_Covariance[i * 16 + i] = 25.0;
+   }
+   model.set(state);
+
+   // Several tiles each way, so that tiles share edges across threads
+   int numLines = 130;
+   int numSamples = 70;
+   double spacing = 35.0;
+   double tolerance = 0.01;
+   double imageCovariance[4] = { 0.25, 0.0, 0.0, 0.25 };
+   UsgsAstroUncertaintyRaster raster(
+      model, 500.0, 100.0, tolerance, imageCovariance);
+   std::vector<double> single(6 * numLines * numSamples);
+   std::vector<double> threaded(6 * numLines * numSamples);
+   EXPECT_EQ(numLines * numSamples, raster.compute(
+      0.5, 0.5, spacing, numLines, numSamples, &single[0], 1));
+   EXPECT_LT(raster.getNumEvaluations(), numLines * numSamples);
+   raster.compute(0.5, 0.5, spacing, numLines, numSamples, &threaded[0], 3);
+   EXPECT_EQ(single, threaded);
+
+   const int entries[6] = { 0, 1, 2, 4, 5, 8 };
+   double maxDeviation = 0.0;
+   for (int r = 0; r < numLines; r++) {
+      for (int c = 0; c < numSamples; c++) {
+         csm::ImageCoordCovar imagePt(0.5 + r * spacing, 0.5 + c * spacing);
+         std::copy(imageCovariance, imageCovariance + 4, imagePt.covariance);
+         csm::EcefCoordCovar groundPt =
+            model.imageToGround(imagePt, 500.0, 100.0);
+         const double *pixel = &single[6 * (r * numSamples + c)];
+         for (int k = 0; k < 6; k++) {
+            int i = entries[k] / 3;
+            int j = entries[k] % 3;
+            double scale = sqrt(groundPt.covariance[4 * i] *
+                                groundPt.covariance[4 * j]);
+            maxDeviation = std::max(maxDeviation,
+               fabs(pixel[k] - groundPt.covariance[entries[k]]) / scale);
+         }
+      }
+   }
+   EXPECT_LE(maxDeviation, tolerance);
+}
+
+TEST(FrameRayGridTests, MatchesExactUndistortion) {
+   // 1024 pixels square, 0.01 mm each, behind a 50 mm lens 100 km above a
+   // 1000 km sphere, with about 30 pixels of cubic distortion in the corners
+   UsgsAstroFrameSensorModel defaultModel;
+   json state = json::parse(defaultModel.getModelState());
+   state["m_focal_length_model"] = { "0", "50", "0" };
+   state["m_radii"] = { "1000000", "1000000", "0" };
+   state["m_radii[0]"] = "1000000";
+   state["m_radii[1]"] = "1000000";
+   state["m_image_lines"] = 1024;
+   state["m_image_samples"] = 1024;
+   state["m_ccdCenter"] = { 512.5, 512.5 };
+   state["m_transX"] = { 0.0, 0.01, 0.0 };
+   state["m_transY"] = { 0.0, 0.0, 0.01 };
+   state["m_odtX"] = { 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.001, 0.0, -0.001, 0.0 };
+   state["m_odtY"] = { 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.001, 0.0, -0.001 };
+   state["m_currentParameterValue"] = { 0.0, 0.0, -1100000.0, 0.0, 0.0, 0.0 };
+
+   UsgsAstroFrameSensorModel gridModel;
+   gridModel.replaceModelState(state.dump());
+   UsgsAstroFrameSensorModel exactModel;
+   exactModel.replaceModelState(state.dump());
+   exactModel.setRayGrid(false);
+   EXPECT_LE(gridModel.getRayGridError(), 1.0e-4);
+
+   // Pixels are 20 m on the ground, so 1.0e-4 pixels is 2 mm
+   for (double line = 0.3; line < 1024.0; line += 37.7) {
+      for (double samp = 0.6; samp < 1024.0; samp += 41.3) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefCoord grid = gridModel.imageToGround(imagePt, 0.0);
+         csm::EcefCoord exact = exactModel.imageToGround(imagePt, 0.0);
+         EXPECT_NEAR(exact.x, grid.x, 2.0e-3);
+         EXPECT_NEAR(exact.y, grid.y, 2.0e-3);
+         EXPECT_NEAR(exact.z, grid.z, 2.0e-3);
+      }
+   }
+
+   // Folded beyond the corners, which no grid follows
+   state["m_odtX"] = { 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.004, 0.0, -0.004, 0.0 };
+   state["m_odtY"] = { 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.004, 0.0, -0.004 };
+   gridModel.replaceModelState(state.dump());
+   exactModel.replaceModelState(state.dump());
+   EXPECT_EQ(0.0, gridModel.getRayGridError());
+   for (double line = 0.3; line < 1024.0; line += 97.7) {
+      csm::ImageCoord imagePt(line, 1023.0 - line);
+      csm::EcefCoord grid = gridModel.imageToGround(imagePt, 0.0);
+      csm::EcefCoord exact = exactModel.imageToGround(imagePt, 0.0);
+      EXPECT_EQ(exact.x, grid.x);
+      EXPECT_EQ(exact.y, grid.y);
+      EXPECT_EQ(exact.z, grid.z);
+   }
+}
+
+TEST_F(LsSyntheticTest, LookVectorTableMatchesComputed) {
+   // A sample offset into the detector and radial distortion, with the
+   // samples beyond the right edge of the image tabulated too
+   state.m_OffsetSamples = 1000.0;
+   state.m_OpticalDistCoef[0] = 1.0e-5;
+   model.set(state);
+   UsgsAstroLsSensorModel tableModel;
+   tableModel.set(state);
+   tableModel.setLookVectorTable(true);
+
+   double maxAngle = 0.0;
+   for (double line = 0.5; line < 5000.0; line += 497.3) {
+      for (double samp = 0.0; samp <= 5000.0; samp += 123.7) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefLocus computed = model.imageToRemoteImagingLocus(imagePt);
+         csm::EcefLocus table = tableModel.imageToRemoteImagingLocus(imagePt);
+         const csm::EcefVector &a = computed.direction;
+         const csm::EcefVector &b = table.direction;
+         double cross[3] = { a.y * b.z - a.z * b.y,
+                             a.z * b.x - a.x * b.z,
+                             a.x * b.y - a.y * b.x };
+         EXPECT_NEAR(1.0, b.x * b.x + b.y * b.y + b.z * b.z, 1.0e-12);
+         maxAngle = std::max(maxAngle, sqrt(cross[0] * cross[0]
+            + cross[1] * cross[1] + cross[2] * cross[2]));
+      }
+   }
+   // A pixel is about 1.8e-5 radians
+   EXPECT_LT(maxAngle, 1.0e-9);
+}
+
+TEST_F(LsSyntheticTest, ParameterDeltasSize) {
+   EXPECT_THROW(model.applyParameterDeltas(std::vector<double>(15, 0.0)),
+                csm::Error);
+   EXPECT_NO_THROW(model.applyParameterDeltas(std::vector<double>(16, 0.0)));
+
+   UsgsAstroFrameSensorModel frameModel;
+   EXPECT_THROW(frameModel.applyParameterDeltas(std::vector<double>(3, 0.0)),
+                csm::Error);
+   EXPECT_NO_THROW(
+      frameModel.applyParameterDeltas(std::vector<double>(6, 0.0)));
+}
+
+TEST_F(LsSyntheticTest, RpcModelMatchesGroundToImage) {
+   state.m_MinElevation = -2000.0;
+   state.m_MaxElevation = 2000.0;
+   model.set(state);
+   UsgsAstroRpcModel rpc = model.computeRpcModel();
+   EXPECT_LT(rpc.getFitMaxResidual(), 0.5);
+   EXPECT_LT(rpc.getCheckMaxResidual(), 0.5);
+
+   // Off both fit grids and between the fit heights, both ways
+   for (double line = 13.7; line < 5000.0; line += 411.9) {
+      for (double samp = 29.3; samp < 5000.0; samp += 389.1) {
+         for (double height = -1700.0; height <= 1700.0; height += 1100.0) {
+            csm::EcefCoord groundPt =
+               model.imageToGround(csm::ImageCoord(line, samp), height);
+            csm::ImageCoord rigorous = model.groundToImage(groundPt);
+            csm::ImageCoord approx = rpc.groundToImage(groundPt);
+            EXPECT_NEAR(rigorous.line, approx.line, 0.5);
+            EXPECT_NEAR(rigorous.samp, approx.samp, 0.5);
+
+            csm::ImageCoord back =
+               model.groundToImage(rpc.imageToGround(rigorous, height));
+            EXPECT_NEAR(rigorous.line, back.line, 0.5);
+            EXPECT_NEAR(rigorous.samp, back.samp, 0.5);
+         }
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, TriangulateTwoImages) {
+   // The same pass moved 20 km across track, for a stereo angle of about
+   // 0.07 radians
+   UsgsAstroLsSensorModel moved;
+   moved.set(state);
+   moved.setParameterValue(1, 20000.0);
+
+   csm::ImageCoord imagePt(2400.3, 600.7);
+   csm::EcefCoord groundPt = model.imageToGround(imagePt, 500.0);
+   UsgsAstroTriangulation::Observation observations[2] = {
+      { &model, imagePt, 0.5 },
+      { &moved, moved.groundToImage(groundPt), 0.5 }
+   };
+   csm::EcefCoord point;
+   double covariance[9];
+   double residuals[2];
+   ASSERT_TRUE(UsgsAstroTriangulation::triangulate(
+      2, observations, point, covariance, residuals));
+   EXPECT_NEAR(groundPt.x, point.x, 0.25);
+   EXPECT_NEAR(groundPt.y, point.y, 0.25);
+   EXPECT_NEAR(groundPt.z, point.z, 0.25);
+   EXPECT_LT(residuals[0], 0.25);
+   EXPECT_LT(residuals[1], 0.25);
+
+   // Two lines off in one image, so that the rays miss by about 11 m.  The
+   // point is on the shortest segment between them, and the residuals are
+   // its distances from them.
+   observations[1].imagePt.line += 2.0;
+   ASSERT_TRUE(UsgsAstroTriangulation::triangulate(
+      2, observations, point, covariance, residuals));
+   csm::EcefLocus rays[2];
+   for (int i = 0; i < 2; i++) {
+      rays[i] = UsgsAstroTriangulation::getRay(
+         *observations[i].model, observations[i].imagePt);
+   }
+   const csm::EcefVector &d0 = rays[0].direction;
+   const csm::EcefVector &d1 = rays[1].direction;
+   double normal[3] = { d0.y * d1.z - d0.z * d1.y,
+                        d0.z * d1.x - d0.x * d1.z,
+                        d0.x * d1.y - d0.y * d1.x };
+   double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                      + normal[2] * normal[2]);
+   double miss = fabs((rays[1].point.x - rays[0].point.x) * normal[0]
+                    + (rays[1].point.y - rays[0].point.y) * normal[1]
+                    + (rays[1].point.z - rays[0].point.z) * normal[2])
+               / length;
+   EXPECT_GT(miss, 8.0);
+   EXPECT_NEAR(miss, residuals[0] + residuals[1], 1.0e-3);
+   for (int i = 0; i < 2; i++) {
+      const csm::EcefLocus &ray = rays[i];
+      double v[3] = { point.x - ray.point.x,
+                      point.y - ray.point.y,
+                      point.z - ray.point.z };
+      double along = v[0] * ray.direction.x + v[1] * ray.direction.y
+                   + v[2] * ray.direction.z;
+      double across[3] = { v[0] - along * ray.direction.x,
+                           v[1] - along * ray.direction.y,
+                           v[2] - along * ray.direction.z };
+      EXPECT_NEAR(sqrt(across[0] * across[0] + across[1] * across[1]
+                     + across[2] * across[2]), residuals[i], 1.0e-6);
+   }
+}
+
+// Angle in degrees between two vectors.
+static double angleBetween(const double a[3], const double b[3]) {
+   double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+   double aLength = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+   double bLength = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+   return acos(dot / (aLength * bLength)) * 180.0 / M_PI;
+}
+
+TEST_F(LsSyntheticTest, BackplanesMatchModel) {
+   double height = 300.0;
+   csm::EcefCoord sun(2.0e11, -1.0e11, 5.0e10);
+   UsgsAstroBackplanes backplanes(
+      model, state.m_SemiMajorAxis, state.m_SemiMinorAxis, height);
+
+   // Enough lines for three threads
+   int numLines = 30;
+   int numSamples = 20;
+   double firstLine = 100.5;
+   double firstSample = 40.5;
+   double spacing = 150.0;
+   int numPixels = numLines * numSamples;
+   std::vector<double> values(UsgsAstroBackplanes::NUM_PLANES * numPixels);
+   double *planes[UsgsAstroBackplanes::NUM_PLANES];
+   for (int p = 0; p < UsgsAstroBackplanes::NUM_PLANES; p++) {
+      planes[p] = &values[p * numPixels];
+   }
+
+   // Without a sun position the line scanner has no illumination
+   ASSERT_EQ(numPixels, backplanes.compute(
+      firstLine, firstSample, spacing, numLines, numSamples, planes, 3));
+   for (int pixel = 0; pixel < numPixels; pixel++) {
+      EXPECT_TRUE(std::isnan(planes[UsgsAstroBackplanes::INCIDENCE][pixel]));
+      EXPECT_TRUE(std::isnan(planes[UsgsAstroBackplanes::PHASE][pixel]));
+   }
+
+   backplanes.setSunPosition(sun);
+   ASSERT_EQ(numPixels, backplanes.compute(
+      firstLine, firstSample, spacing, numLines, numSamples, planes, 3));
+   UsgsAstroGeodesy geodesy(state.m_SemiMajorAxis, state.m_SemiMinorAxis);
+   for (int r = 0; r < numLines; r++) {
+      for (int c = 0; c < numSamples; c++) {
+         int pixel = r * numSamples + c;
+         double value[UsgsAstroBackplanes::NUM_PLANES];
+         for (int p = 0; p < UsgsAstroBackplanes::NUM_PLANES; p++) {
+            value[p] = planes[p][pixel];
+         }
+         csm::ImageCoord imagePt(firstLine + r * spacing,
+                                 firstSample + c * spacing);
+         csm::EcefCoord ground = model.imageToGround(imagePt, height);
+         EXPECT_NEAR(ground.x, value[UsgsAstroBackplanes::GROUND_X], 1.0e-3);
+         EXPECT_NEAR(ground.y, value[UsgsAstroBackplanes::GROUND_Y], 1.0e-3);
+         EXPECT_NEAR(ground.z, value[UsgsAstroBackplanes::GROUND_Z], 1.0e-3);
+         EXPECT_NEAR(height, value[UsgsAstroBackplanes::HEIGHT], 1.0e-3);
+
+         double latitude = value[UsgsAstroBackplanes::LATITUDE] * M_PI / 180.0;
+         double longitude =
+            value[UsgsAstroBackplanes::LONGITUDE] * M_PI / 180.0;
+         double geodetic[3];
+         geodesy.fromGeodetic(latitude, longitude, height,
+                              geodetic[0], geodetic[1], geodetic[2]);
+         EXPECT_NEAR(ground.x, geodetic[0], 1.0e-3);
+         EXPECT_NEAR(ground.y, geodetic[1], 1.0e-3);
+         EXPECT_NEAR(ground.z, geodetic[2], 1.0e-3);
+
+         // The normal is that of the ellipsoid, the gradient of its
+         // equation
+         double a2 = state.m_SemiMajorAxis * state.m_SemiMajorAxis;
+         double b2 = state.m_SemiMinorAxis * state.m_SemiMinorAxis;
+         double normal[3] = { ground.x / a2, ground.y / a2, ground.z / b2 };
+         double normalLength = sqrt(normal[0] * normal[0]
+            + normal[1] * normal[1] + normal[2] * normal[2]);
+         EXPECT_NEAR(normal[0] / normalLength,
+                     value[UsgsAstroBackplanes::NORMAL_X], 1.0e-6);
+         EXPECT_NEAR(normal[1] / normalLength,
+                     value[UsgsAstroBackplanes::NORMAL_Y], 1.0e-6);
+         EXPECT_NEAR(normal[2] / normalLength,
+                     value[UsgsAstroBackplanes::NORMAL_Z], 1.0e-6);
+
+         csm::EcefCoord sensor = model.getSensorPosition(imagePt);
+         double toSensor[3] = { sensor.x - ground.x,
+                                sensor.y - ground.y,
+                                sensor.z - ground.z };
+         double toSun[3] = { sun.x - ground.x,
+                             sun.y - ground.y,
+                             sun.z - ground.z };
+         EXPECT_NEAR(angleBetween(normal, toSensor),
+                     value[UsgsAstroBackplanes::EMISSION], 1.0e-4);
+         EXPECT_NEAR(angleBetween(normal, toSun),
+                     value[UsgsAstroBackplanes::INCIDENCE], 1.0e-4);
+         EXPECT_NEAR(angleBetween(toSensor, toSun),
+                     value[UsgsAstroBackplanes::PHASE], 1.0e-4);
+
+         // The ground step to the next pixel, across the line of sight
+         csm::EcefCoord next = model.imageToGround(
+            csm::ImageCoord(imagePt.line, imagePt.samp + spacing), height);
+         double step[3] = { next.x - ground.x,
+                            next.y - ground.y,
+                            next.z - ground.z };
+         double range = sqrt(toSensor[0] * toSensor[0]
+            + toSensor[1] * toSensor[1] + toSensor[2] * toSensor[2]);
+         double along = (step[0] * toSensor[0] + step[1] * toSensor[1]
+                       + step[2] * toSensor[2]) / range;
+         double across = sqrt(step[0] * step[0] + step[1] * step[1]
+                            + step[2] * step[2] - along * along);
+         EXPECT_NEAR(across / spacing,
+                     value[UsgsAstroBackplanes::RESOLUTION], 1.0e-3);
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, GroundCovarianceMatchesNumeric) {
+   // No sensor covariance, so that only the image and height variances
+   // propagate
+   state.m_FlyingHeight = 300000.0;
+   state.m_HalfSwath = 20000.0;
+   state.m_HalfTime = 10.0;
+   state.m_Covariance.assign(16 * 16, 0.0);
+   model.set(state);
+
+   double height = 400.0;
+   double heightVariance = 100.0;
+   for (double line = 300.5; line < 5000.0; line += 1100.0) {
+      for (double samp = 200.5; samp < 5000.0; samp += 1150.0) {
+         csm::ImageCoordCovar imagePt;
+         imagePt.line = line;
+         imagePt.samp = samp;
+         imagePt.covariance[0] = 0.5;
+         imagePt.covariance[1] = 0.1;
+         imagePt.covariance[2] = 0.1;
+         imagePt.covariance[3] = 0.3;
+         csm::EcefCoordCovar result =
+            model.imageToGround(imagePt, height, heightVariance);
+
+         // Central differences of imageToGround in line, sample and
+         // height, as columns
+         double delta[3] = { 0.5, 0.5, 5.0 };
+         double partials[9];
+         for (int k = 0; k < 3; k++) {
+            csm::EcefCoord ends[2];
+            for (int e = 0; e < 2; e++) {
+               double step = e ? delta[k] : -delta[k];
+               ends[e] = model.imageToGround(
+                  csm::ImageCoord(line + (k == 0 ? step : 0.0),
+                                  samp + (k == 1 ? step : 0.0)),
+                  height + (k == 2 ? step : 0.0));
+            }
+            partials[k] = (ends[1].x - ends[0].x) / (2.0 * delta[k]);
+            partials[3 + k] = (ends[1].y - ends[0].y) / (2.0 * delta[k]);
+            partials[6 + k] = (ends[1].z - ends[0].z) / (2.0 * delta[k]);
+         }
+
+         std::vector<double> unmodeled = model.getUnmodeledError(imagePt);
+         double input[9] = {
+            imagePt.covariance[0] + unmodeled[0],
+            imagePt.covariance[1] + unmodeled[1], 0.0,
+            imagePt.covariance[2] + unmodeled[2],
+            imagePt.covariance[3] + unmodeled[3], 0.0,
+            0.0, 0.0, heightVariance };
+         double largest = 0.0;
+         double expected[9];
+         for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+               double sum = 0.0;
+               for (int a = 0; a < 3; a++) {
+                  for (int b = 0; b < 3; b++) {
+                     sum += partials[3 * i + a] * input[3 * a + b]
+                          * partials[3 * j + b];
+                  }
+               }
+               expected[3 * i + j] = sum;
+               largest = std::max(largest, fabs(sum));
+            }
+         }
+         for (int i = 0; i < 9; i++) {
+            EXPECT_NEAR(expected[i], result.covariance[i], 1.0e-4 * largest);
+         }
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, ObservationPartialsMatchDifferences) {
+   state.m_FlyingHeight = 300000.0;
+   state.m_HalfSwath = 20000.0;
+   state.m_HalfTime = 10.0;
+   model.set(state);
+
+   const int numObservations = 4;
+   csm::ImageCoord imagePts[numObservations] = {
+      csm::ImageCoord(500.5, 700.5), csm::ImageCoord(1900.2, 4100.7),
+      csm::ImageCoord(3300.9, 2500.1), csm::ImageCoord(4600.4, 300.3) };
+   csm::EcefCoord groundPts[numObservations];
+   csm::ImageCoord measured[numObservations];
+   for (int i = 0; i < numObservations; i++) {
+      groundPts[i] = model.imageToGround(imagePts[i], 250.0 * i);
+      measured[i] = csm::ImageCoord(imagePts[i].line + 0.25,
+                                    imagePts[i].samp - 0.5);
+   }
+
+   int numParameters = model.getNumParameters();
+   std::vector<double> residuals(2 * numObservations);
+   std::vector<double> partials(2 * numObservations * numParameters);
+   UsgsAstroLsSensorModel::ProjectionStatus status[numObservations];
+   ASSERT_EQ(numObservations, model.computeObservationPartials(
+      numObservations, measured, groundPts, &residuals[0], &partials[0], 0,
+      NULL, 0, status, csm::param::VALID, 1.0e-6, 1));
+   for (int i = 0; i < numObservations; i++) {
+      csm::ImageCoord computed = model.groundToImage(groundPts[i], 1.0e-6);
+      EXPECT_NEAR(measured[i].line - computed.line, residuals[2 * i], 1.0e-5);
+      EXPECT_NEAR(measured[i].samp - computed.samp, residuals[2 * i + 1],
+                  1.0e-5);
+   }
+
+   // Central differences of groundToImage over a meter, or a meter per
+   // second, of each parameter
+   for (int p = 0; p < numParameters; p++) {
+      UsgsAstroLsSensorModel plus;
+      plus.set(state);
+      plus.setParameterValue(p, 1.0);
+      UsgsAstroLsSensorModel minus;
+      minus.set(state);
+      minus.setParameterValue(p, -1.0);
+      for (int i = 0; i < numObservations; i++) {
+         csm::ImageCoord ahead = plus.groundToImage(groundPts[i], 1.0e-8);
+         csm::ImageCoord behind = minus.groundToImage(groundPts[i], 1.0e-8);
+         double line = (ahead.line - behind.line) / 2.0;
+         double samp = (ahead.samp - behind.samp) / 2.0;
+         double tolerance =
+            1.0e-3 * std::max(fabs(line), fabs(samp)) + 1.0e-6;
+         EXPECT_NEAR(line, partials[(2 * i) * numParameters + p], tolerance)
+            << "parameter " << p << " observation " << i;
+         EXPECT_NEAR(samp, partials[(2 * i + 1) * numParameters + p],
+                     tolerance)
+            << "parameter " << p << " observation " << i;
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, GroundPartialsMatchDifferences) {
+   double delta = 1.0;
+   for (double line = 250.5; line < 5000.0; line += 1150.0) {
+      for (double samp = 150.5; samp < 5000.0; samp += 1210.0) {
+         csm::EcefCoord groundPt =
+            model.imageToGround(csm::ImageCoord(line, samp), 800.0);
+         std::vector<double> partials = model.computeGroundPartials(groundPt);
+         ASSERT_EQ(6u, partials.size());
+
+         // Central differences over a meter along each axis, columns x,
+         // y and z of the line row then the sample row
+         for (int k = 0; k < 3; k++) {
+            csm::EcefCoord ahead = groundPt;
+            csm::EcefCoord behind = groundPt;
+            double *aheadAxis[3] = { &ahead.x, &ahead.y, &ahead.z };
+            double *behindAxis[3] = { &behind.x, &behind.y, &behind.z };
+            *aheadAxis[k] += delta;
+            *behindAxis[k] -= delta;
+            csm::ImageCoord aheadPt = model.groundToImage(ahead, 1.0e-8);
+            csm::ImageCoord behindPt = model.groundToImage(behind, 1.0e-8);
+            double linePartial = (aheadPt.line - behindPt.line) / (2.0 * delta);
+            double sampPartial = (aheadPt.samp - behindPt.samp) / (2.0 * delta);
+            EXPECT_NEAR(linePartial, partials[k], 1.0e-6);
+            EXPECT_NEAR(sampPartial, partials[3 + k], 1.0e-6);
+         }
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, HintedGroundToImageMatchesUnhinted) {
+   for (double line = 250.5; line < 5000.0; line += 1150.0) {
+      for (double samp = 150.5; samp < 5000.0; samp += 1210.0) {
+         csm::EcefCoord groundPt =
+            model.imageToGround(csm::ImageCoord(line, samp), 800.0);
+         csm::ImageCoord expected = model.groundToImage(groundPt, 1.0e-6);
+
+         // A hint near the point, a stale one thousands of lines away and
+         // hints off either end of the image, which are not used
+         double hintLines[4] = { line + 3.0, fmod(line + 2700.0, 5000.0),
+                                 -100.0, 5100.0 };
+         bool expectUsed[4] = { true, true, false, false };
+         for (int h = 0; h < 4; h++) {
+            bool hintUsed = !expectUsed[h];
+            csm::ImageCoord imagePt = model.groundToImage(
+               groundPt, csm::ImageCoord(hintLines[h], samp), 20.0,
+               &hintUsed, 1.0e-6);
+            EXPECT_EQ(expectUsed[h], hintUsed);
+            EXPECT_NEAR(expected.line, imagePt.line, 1.0e-3);
+            EXPECT_NEAR(expected.samp, imagePt.samp, 1.0e-3);
+         }
+
+         // A time hint a few seconds off, within the image
+         double hintTime = model.getImageTime(expected)
+                         + (line < 2500.0 ? 4.0 : -4.0);
+         csm::ImageCoord imagePt;
+         bool hintUsed = false;
+         EXPECT_EQ(UsgsAstroLsSensorModel::PROJECTION_SUCCESS,
+                   model.tryGroundToImageNearTime(
+                      groundPt, hintTime, 0.05, imagePt, &hintUsed, 1.0e-6));
+         EXPECT_TRUE(hintUsed);
+         EXPECT_NEAR(expected.line, imagePt.line, 1.0e-3);
+         EXPECT_NEAR(expected.samp, imagePt.samp, 1.0e-3);
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, TrajectorySharedAndRestored) {
+   // A second model of the same orbit shares the trajectory, one with
+   // different support data under the same identifier does not
+   UsgsAstroLsSensorModel sameOrbit;
+   sameOrbit.set(state);
+   EXPECT_EQ(&model.getTrajectory(), &sameOrbit.getTrajectory());
+
+   UsgsAstroLsStateData changed = state;
+   changed.m_Quaternions[0] += 1.0e-9;
+   UsgsAstroLsSensorModel changedOrbit;
+   changedOrbit.set(changed);
+   EXPECT_NE(&model.getTrajectory(), &changedOrbit.getTrajectory());
+
+   // The state carries the ephemeris and attitude the model released, to
+   // the 15 significant digits the JSON writer keeps
+   UsgsAstroLsStateData restored(model.getModelState());
+   EXPECT_EQ(state.m_TrajectoryIdentifier, restored.m_TrajectoryIdentifier);
+   EXPECT_EQ(state.m_NumEphem, restored.m_NumEphem);
+   EXPECT_EQ(state.m_T0Ephem, restored.m_T0Ephem);
+   EXPECT_EQ(state.m_DtEphem, restored.m_DtEphem);
+   EXPECT_EQ(state.m_NumQuaternions, restored.m_NumQuaternions);
+   EXPECT_EQ(state.m_T0Quat, restored.m_T0Quat);
+   EXPECT_EQ(state.m_DtQuat, restored.m_DtQuat);
+   ASSERT_EQ(state.m_EphemPts.size(), restored.m_EphemPts.size());
+   ASSERT_EQ(state.m_EphemRates.size(), restored.m_EphemRates.size());
+   ASSERT_EQ(state.m_Quaternions.size(), restored.m_Quaternions.size());
+   for (size_t i = 0; i < state.m_EphemPts.size(); i++) {
+      EXPECT_NEAR(state.m_EphemPts[i], restored.m_EphemPts[i], 1.0e-8);
+      EXPECT_NEAR(state.m_EphemRates[i], restored.m_EphemRates[i], 1.0e-11);
+   }
+   for (size_t i = 0; i < state.m_Quaternions.size(); i++) {
+      EXPECT_NEAR(state.m_Quaternions[i], restored.m_Quaternions[i], 1.0e-14);
+   }
+
+   // Models restored from one state share its trajectory
+   std::string modelState = model.getModelState();
+   UsgsAstroLsSensorModel first, second;
+   first.replaceModelState(modelState);
+   second.replaceModelState(modelState);
+   EXPECT_EQ(&first.getTrajectory(), &second.getTrajectory());
+   EXPECT_EQ(modelState, first.getModelState());
+}
+
+TEST_F(LsSyntheticTest, DistortedRoundTrip) {
+   // Radial distortion of 3.5% at the detector ends, about 90 pixels, and
+   // transverse distortion of 5.6%, the LRO NAC form
+   UsgsAstroLsStateData radial = state;
+   radial.m_IkCode = 0;
+   radial.m_OpticalDistCoef[1] = 1.0e-4;
+   radial.m_OpticalDistCoef[2] = 1.0e-7;
+   UsgsAstroLsStateData transverse = state;
+   transverse.m_IkCode = -85600;
+   transverse.m_OpticalDistCoef[0] = 2.0e-4;
+   UsgsAstroLsStateData distorted[2] = { radial, transverse };
+
+   for (int m = 0; m < 2; m++) {
+      UsgsAstroLsSensorModel distortedModel;
+      distortedModel.set(distorted[m]);
+      for (double line = 0.5; line < 5000.0; line += 1110.0) {
+         for (double samp = 0.5; samp < 5000.0; samp += 499.9) {
+            csm::ImageCoord imagePt(line, samp);
+            csm::EcefCoord groundPt =
+               distortedModel.imageToGround(imagePt, 500.0);
+            csm::ImageCoord result = distortedModel.groundToImage(groundPt);
+            EXPECT_NEAR(imagePt.line, result.line, 1.0e-3);
+            EXPECT_NEAR(imagePt.samp, result.samp, 1.0e-3);
+         }
+      }
+
+      // The distortion moves the detector ends by tens of pixels
+      csm::EcefCoord edge =
+         distortedModel.imageToGround(csm::ImageCoord(2500.5, 0.5), 500.0);
+      EXPECT_GT(fabs(model.groundToImage(edge).samp - 0.5), 50.0);
+   }
+}
+
+TEST_F(LsSyntheticTest, ParameterDeltasMatchParameterValues) {
+   // Two rounds of deltas to every parameter, the focal bias rebuilding
+   // the look vector table, against the same values set one at a time
+   model.setLookVectorTable(true);
+   UsgsAstroLsSensorModel setModel;
+   setModel.set(state);
+   setModel.setLookVectorTable(true);
+   UsgsAstroLsSensorModel original;
+   original.set(state);
+
+   for (int round = 1; round <= 2; round++) {
+      std::vector<double> deltas(16);
+      for (int i = 0; i < 16; i++) {
+         deltas[i] = 0.3 * round * (i % 3 + 1) * (i % 2 ? -1.0 : 1.0);
+      }
+      model.applyParameterDeltas(deltas);
+      for (int i = 0; i < 16; i++) {
+         setModel.setParameterValue(
+            i, setModel.getParameterValue(i) + deltas[i]);
+      }
+   }
+
+   for (double line = 250.5; line < 5000.0; line += 1110.0) {
+      for (double samp = 250.5; samp < 5000.0; samp += 1110.0) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefCoord applied = model.imageToGround(imagePt, 0.0);
+         csm::EcefCoord set = setModel.imageToGround(imagePt, 0.0);
+         EXPECT_NEAR(set.x, applied.x, 1.0e-6);
+         EXPECT_NEAR(set.y, applied.y, 1.0e-6);
+         EXPECT_NEAR(set.z, applied.z, 1.0e-6);
+
+         csm::ImageCoord appliedPt = model.groundToImage(applied, 1.0e-8);
+         csm::ImageCoord setPt = setModel.groundToImage(applied, 1.0e-8);
+         EXPECT_NEAR(setPt.line, appliedPt.line, 1.0e-6);
+         EXPECT_NEAR(setPt.samp, appliedPt.samp, 1.0e-6);
+
+         // and the deltas moved the point by pixels
+         csm::ImageCoord originalPt = original.groundToImage(applied);
+         EXPECT_GT(fabs(originalPt.line - line) + fabs(originalPt.samp - samp),
+                   1.0);
+      }
+   }
+}
+
+TEST(FrameParameterDeltasTests, MatchParameterValues) {
+   // 1024 pixels square, 0.01 mm each, behind a 50 mm lens 100 km above a
+   // 1000 km sphere
+   UsgsAstroFrameSensorModel defaultModel;
+   json state = json::parse(defaultModel.getModelState());
+   state["m_focal_length_model"] = { "0", "50", "0" };
+   state["m_radii"] = { "1000000", "1000000", "0" };
+   state["m_radii[0]"] = "1000000";
+   state["m_radii[1]"] = "1000000";
+   state["m_image_lines"] = 1024;
+   state["m_image_samples"] = 1024;
+   state["m_ccdCenter"] = { 512.5, 512.5 };
+   state["m_transX"] = { 0.0, 0.01, 0.0 };
+   state["m_transY"] = { 0.0, 0.0, 0.01 };
+   state["m_odtX"] = { 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.001, 0.0, -0.001, 0.0 };
+   state["m_odtY"] = { 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -0.001, 0.0, -0.001 };
+   state["m_currentParameterValue"] = { 0.0, 0.0, -1100000.0, 0.0, 0.0, 0.0 };
+
+   UsgsAstroFrameSensorModel appliedModel;
+   appliedModel.replaceModelState(state.dump());
+   UsgsAstroFrameSensorModel setModel;
+   setModel.replaceModelState(state.dump());
+
+   // Position in meters and angles in radians, so the rotation changes
+   double deltas[6] = { 30.0, -20.0, 10.0, 2.0e-4, -3.0e-4, 1.0e-3 };
+   appliedModel.applyParameterDeltas(std::vector<double>(deltas, deltas + 6));
+   std::vector<double> values(6);
+   for (int i = 0; i < 6; i++) {
+      values[i] = setModel.getParameterValue(i) + deltas[i];
+      setModel.setParameterValue(i, values[i]);
+   }
+
+   // A model loaded with the adjusted values has a fresh rotation
+   state["m_currentParameterValue"] = values;
+   UsgsAstroFrameSensorModel loadedModel;
+   loadedModel.replaceModelState(state.dump());
+
+   for (double line = 0.5; line < 1024.0; line += 127.3) {
+      for (double samp = 0.5; samp < 1024.0; samp += 131.9) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefCoord applied = appliedModel.imageToGround(imagePt, 0.0);
+         csm::EcefCoord set = setModel.imageToGround(imagePt, 0.0);
+         csm::EcefCoord loaded = loadedModel.imageToGround(imagePt, 0.0);
+         EXPECT_NEAR(loaded.x, applied.x, 1.0e-6);
+         EXPECT_NEAR(loaded.y, applied.y, 1.0e-6);
+         EXPECT_NEAR(loaded.z, applied.z, 1.0e-6);
+         EXPECT_NEAR(loaded.x, set.x, 1.0e-6);
+         EXPECT_NEAR(loaded.y, set.y, 1.0e-6);
+         EXPECT_NEAR(loaded.z, set.z, 1.0e-6);
+      }
+   }
+}
+
+TEST_F(LsSyntheticTest, HermiteMatchesLagrange) {
+   // Away from the ends of the ephemeris, where 8th order Lagrange keeps
+   // its full order, the two agree to far below a millimeter
+   const UsgsAstroLsTrajectory &trajectory = model.getTrajectory();
+   for (double time = -25.0; time <= 25.0; time += 0.173) {
+      double pos[3], vel[3], hermitePos[3], hermiteVel[3];
+      trajectory.getPositionVelocity<8>(time, pos, vel);
+      trajectory.getHermitePositionVelocity(time, hermitePos, hermiteVel);
+      for (int k = 0; k < 3; k++) {
+         EXPECT_NEAR(pos[k], hermitePos[k], 1.0e-6);
+         EXPECT_NEAR(vel[k], hermiteVel[k], 1.0e-7);
+      }
+   }
+
+   // Over the whole ephemeris the difference is the error of the lower
+   // order Lagrange interpolation at the ends, under a meter here
+   double maxPosition, maxVelocity;
+   trajectory.compareHermiteEphemeris(10, maxPosition, maxVelocity);
+   EXPECT_GT(maxPosition, 0.0);
+   EXPECT_LT(maxPosition, 1.0);
+   EXPECT_LT(maxVelocity, 1.0e-2);
+
+   // The state switch selects the Hermite ephemeris for the model
+   state.m_EphemInterpFlag = 1;
+   UsgsAstroLsSensorModel hermiteModel;
+   hermiteModel.set(state);
+   bool differs = false;
+   for (double line = 0.5; line < 5000.0; line += 997.0) {
+      for (double samp = 0.5; samp < 5000.0; samp += 997.0) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefCoord position = model.getSensorPosition(imagePt);
+         csm::EcefCoord hermitePosition =
+            hermiteModel.getSensorPosition(imagePt);
+         EXPECT_NEAR(position.x, hermitePosition.x, 1.0e-6);
+         EXPECT_NEAR(position.y, hermitePosition.y, 1.0e-6);
+         EXPECT_NEAR(position.z, hermitePosition.z, 1.0e-6);
+         differs = differs || position.x != hermitePosition.x;
+
+         csm::EcefCoord groundPt = model.imageToGround(imagePt, 0.0);
+         csm::ImageCoord expected = model.groundToImage(groundPt, 1.0e-8);
+         csm::ImageCoord result = hermiteModel.groundToImage(groundPt, 1.0e-8);
+         EXPECT_NEAR(expected.line, result.line, 1.0e-6);
+         EXPECT_NEAR(expected.samp, result.samp, 1.0e-6);
+      }
+   }
+   EXPECT_TRUE(differs);
+}
+
+TEST_F(LsSyntheticTest, GeodesyMatchesIterative) {
+   UsgsAstroLsSensorModel iterativeModel;
+   iterativeModel.set(state);
+   iterativeModel.setIterativeGeodesy(true);
+
+   for (double height = -5000.0; height <= 20000.0; height += 12500.0) {
+      for (double line = 0.5; line < 5000.0; line += 1110.0) {
+         for (double samp = 0.5; samp < 5000.0; samp += 1110.0) {
+            csm::ImageCoord imagePt(line, samp);
+            csm::EcefCoord closed = model.imageToGround(imagePt, height, 1.0e-6);
+            csm::EcefCoord iterative =
+               iterativeModel.imageToGround(imagePt, height, 1.0e-6);
+            EXPECT_NEAR(iterative.x, closed.x, 1.0e-4);
+            EXPECT_NEAR(iterative.y, closed.y, 1.0e-4);
+            EXPECT_NEAR(iterative.z, closed.z, 1.0e-4);
+
+            csm::ImageCoord closedPt = model.groundToImage(closed, 1.0e-8);
+            csm::ImageCoord iterativePt =
+               iterativeModel.groundToImage(closed, 1.0e-8);
+            EXPECT_NEAR(iterativePt.line, closedPt.line, 1.0e-6);
+            EXPECT_NEAR(iterativePt.samp, closedPt.samp, 1.0e-6);
+         }
+      }
+   }
+
+   // The closed form declines near the body center and for a prolate
+   // ellipsoid, where the model falls back to the iterative computation
+   UsgsAstroGeodesy geodesy(state.m_SemiMajorAxis, state.m_SemiMinorAxis);
+   double latitude, height;
+   EXPECT_FALSE(geodesy.toGeodetic(1000.0, 0.0, 500.0, latitude, height));
+   EXPECT_FALSE(geodesy.toGeodetic(0.0, 0.0, 10.0, latitude, height));
+
+   state.m_SemiMajorAxis = 3376200.0;
+   state.m_SemiMinorAxis = 3396190.0;
+   UsgsAstroGeodesy prolate(state.m_SemiMajorAxis, state.m_SemiMinorAxis);
+   EXPECT_FALSE(prolate.toGeodetic(3.0e6, 1.0e6, 1.0e6, latitude, height));
+   double x, y, z, achieved;
+   EXPECT_EQ(-1, prolate.intersect(0.0, 3.0e6, 1.0e6, 2.0e6, -0.8, -0.1,
+                                   -0.45, x, y, z, achieved, 0.001));
+
+   model.set(state);
+   iterativeModel.set(state);
+   for (double line = 0.5; line < 5000.0; line += 1110.0) {
+      for (double samp = 0.5; samp < 5000.0; samp += 1110.0) {
+         csm::ImageCoord imagePt(line, samp);
+         csm::EcefCoord closed = model.imageToGround(imagePt, 1000.0);
+         csm::EcefCoord iterative =
+            iterativeModel.imageToGround(imagePt, 1000.0);
+         EXPECT_EQ(iterative.x, closed.x);
+         EXPECT_EQ(iterative.y, closed.y);
+         EXPECT_EQ(iterative.z, closed.z);
+
+         csm::ImageCoord result = model.groundToImage(closed);
+         EXPECT_NEAR(line, result.line, 1.0e-3);
+         EXPECT_NEAR(samp, result.samp, 1.0e-3);
+      }
+   }
+}
+
+TEST(FrameBatchTests, MatchesScalarAtEveryKernel) {
+   // The ray grid test camera with quadratic distortion terms as well
+   UsgsAstroFrameSensorModel defaultModel;
+   json state = json::parse(defaultModel.getModelState());
+   state["m_focal_length_model"] = { "0", "50", "0" };
+   state["m_radii"] = { "1000000", "1000000", "0" };
+   state["m_radii[0]"] = "1000000";
+   state["m_radii[1]"] = "1000000";
+   state["m_image_lines"] = 1024;
+   state["m_image_samples"] = 1024;
+   state["m_ccdCenter"] = { 512.5, 512.5 };
+   state["m_transX"] = { 0.0, 0.01, 0.0 };
+   state["m_transY"] = { 0.0, 0.0, 0.01 };
+   state["m_iTransS"] = { 0.0, 100.0, 0.0 };
+   state["m_iTransL"] = { 0.0, 0.0, 100.0 };
+   state["m_odtX"] = { 0.0, 1.0, 0.0, 0.0005, 0.0, 0.0, -0.001, 0.0, -0.001, 0.0 };
+   state["m_odtY"] = { 0.0, 0.0, 1.0, 0.0, 0.0005, 0.0, 0.0, -0.001, 0.0, -0.001 };
+   state["m_currentParameterValue"] = { 0.0, 0.0, -1100000.0, 0.0, 0.0, 0.0 };
+   UsgsAstroFrameSensorModel model;
+   model.replaceModelState(state.dump());
+
+   // More points than one pass of the batch, which is 256
+   const int maxPoints = 599;
+   std::vector<double> x, y, z;
+   for (int i = 0; i < maxPoints + 100; i++) {
+      csm::ImageCoord imagePt(1.5 + 1.4 * i, 1021.5 - 1.3 * i);
+      csm::EcefCoord groundPt = model.imageToGround(imagePt, 0.0);
+      x.push_back(groundPt.x);
+      y.push_back(groundPt.y);
+      z.push_back(groundPt.z);
+   }
+
+   const UsgsAstroFrameSensorModel::BatchKernel kernels[] = {
+      UsgsAstroFrameSensorModel::BATCH_KERNEL_SCALAR,
+      UsgsAstroFrameSensorModel::BATCH_KERNEL_AVX2,
+      UsgsAstroFrameSensorModel::BATCH_KERNEL_AVX512,
+      UsgsAstroFrameSensorModel::BATCH_KERNEL_AUTO
+   };
+   const int counts[] = { 1, 3, 5, 7, 9, 13, 17, 263, maxPoints };
+   const int numCounts = sizeof(counts) / sizeof(counts[0]);
+   EXPECT_TRUE(model.setBatchKernel(UsgsAstroFrameSensorModel::BATCH_KERNEL_SCALAR));
+   for (UsgsAstroFrameSensorModel::BatchKernel kernel : kernels) {
+      // Kernels the processor lacks are not selected
+      if (!model.setBatchKernel(kernel)) {
+         continue;
+      }
+      // Each batch starts at a different point, so that no point is
+      // projected where the previous batch left it
+      for (int c = 0; c < numCounts; c++) {
+         int n = counts[c];
+         int first = 11 * c;
+         std::vector<double> line(n), sample(n);
+         model.groundToImage(n, &x[first], &y[first], &z[first],
+                             &line[0], &sample[0]);
+         for (int i = 0; i < n; i++) {
+            csm::ImageCoord imagePt = model.groundToImage(
+               csm::EcefCoord(x[first + i], y[first + i], z[first + i]));
+            EXPECT_NEAR(imagePt.line, line[i], 1.0e-9)
+               << "kernel " << kernel << ", " << n << " points, point " << i;
+            EXPECT_NEAR(imagePt.samp, sample[i], 1.0e-9)
+               << "kernel " << kernel << ", " << n << " points, point " << i;
+         }
+      }
+   }
+}
+
+
+TEST_F(LsSyntheticTest, TryProjectionsReportStatus) {
+   // Within the image both forms agree with the throwing projections
+   csm::ImageCoord imagePt(1250.5, 3100.5);
+   csm::EcefCoord groundPt;
+   ASSERT_EQ(UsgsAstroLsSensorModel::PROJECTION_SUCCESS,
+             model.tryImageToGround(imagePt, 800.0, groundPt));
+   csm::EcefCoord expectedGround = model.imageToGround(imagePt, 800.0);
+   EXPECT_NEAR(expectedGround.x, groundPt.x, 1.0e-6);
+   EXPECT_NEAR(expectedGround.y, groundPt.y, 1.0e-6);
+   EXPECT_NEAR(expectedGround.z, groundPt.z, 1.0e-6);
+
+   csm::ImageCoord projected;
+   ASSERT_EQ(UsgsAstroLsSensorModel::PROJECTION_SUCCESS,
+             model.tryGroundToImage(groundPt, projected, 1.0e-6));
+   csm::ImageCoord expectedImage = model.groundToImage(groundPt, 1.0e-6);
+   EXPECT_DOUBLE_EQ(expectedImage.line, projected.line);
+   EXPECT_DOUBLE_EQ(expectedImage.samp, projected.samp);
+   EXPECT_NEAR(imagePt.line, projected.line, 1.0e-3);
+   EXPECT_NEAR(imagePt.samp, projected.samp, 1.0e-3);
+
+   // A sample far beyond the edge looks about 87 degrees off nadir, past
+   // the horizon 300 km above Mars, and misses the planet
+   csm::ImageCoord offBody(1250.5, 1.0e6);
+   EXPECT_EQ(UsgsAstroLsSensorModel::PROJECTION_MISSED,
+             model.tryImageToGround(offBody, 0.0, groundPt));
+   expectedGround = model.imageToGround(offBody, 0.0);
+   EXPECT_NEAR(expectedGround.x, groundPt.x, 1.0e-6);
+   EXPECT_NEAR(expectedGround.y, groundPt.y, 1.0e-6);
+   EXPECT_NEAR(expectedGround.z, groundPt.z, 1.0e-6);
+
+   // A point imaged a thousand lines before the first is not viewed
+   csm::EcefCoord beforeImage =
+      model.imageToGround(csm::ImageCoord(-1000.5, 2500.5), 0.0);
+   EXPECT_EQ(UsgsAstroLsSensorModel::PROJECTION_NOT_VIEWED,
+             model.tryGroundToImage(beforeImage, projected));
+   EXPECT_THROW(model.groundToImage(beforeImage), csm::Error);
+
+   // The array form matches the scalar form point by point, viewed or not
+   std::vector<double> x, y, z;
+   for (double line = -1500.5; line < 6500.0; line += 700.0) {
+      csm::EcefCoord pt =
+         model.imageToGround(csm::ImageCoord(line, 0.37 * line + 900.5), 300.0);
+      x.push_back(pt.x);
+      y.push_back(pt.y);
+      z.push_back(pt.z);
+   }
+   int n = x.size();
+   std::vector<double> lines(n), samples(n);
+   std::vector<UsgsAstroLsSensorModel::ProjectionStatus> status(n);
+   model.groundToImage(n, &x[0], &y[0], &z[0], &lines[0], &samples[0],
+                       &status[0], 1.0e-6);
+   int viewed = 0;
+   for (int i = 0; i < n; i++) {
+      UsgsAstroLsSensorModel::ProjectionStatus expected =
+         model.tryGroundToImage(csm::EcefCoord(x[i], y[i], z[i]), projected,
+                                1.0e-6);
+      EXPECT_EQ(expected, status[i]) << "point " << i;
+      if (expected == UsgsAstroLsSensorModel::PROJECTION_SUCCESS) {
+         viewed++;
+         EXPECT_DOUBLE_EQ(projected.line, lines[i]) << "point " << i;
+         EXPECT_DOUBLE_EQ(projected.samp, samples[i]) << "point " << i;
+      }
+   }
+   EXPECT_GT(viewed, 0);
+   EXPECT_LT(viewed, n);
+}
+
+
+TEST_F(LsSyntheticTest, FootprintContainsImage) {
+   // Whether a ground point is inside a closed polygon, by the crossings
+   // of a ray in the plane across the direction to the point
+   auto inside = [](const std::vector<csm::EcefCoord>& polygon,
+                    const csm::EcefCoord& pt) {
+      double r = sqrt(pt.x * pt.x + pt.y * pt.y + pt.z * pt.z);
+      double up[3] = { pt.x / r, pt.y / r, pt.z / r };
+      double east[3] = { -up[1], up[0], 0.0 };
+      double e = sqrt(east[0] * east[0] + east[1] * east[1]);
+      east[0] /= e;
+      east[1] /= e;
+      double north[3] = { up[1] * east[2] - up[2] * east[1],
+                          up[2] * east[0] - up[0] * east[2],
+                          up[0] * east[1] - up[1] * east[0] };
+      bool in = false;
+      for (size_t i = 0; i + 1 < polygon.size(); i++) {
+         const csm::EcefCoord& a = polygon[i];
+         const csm::EcefCoord& b = polygon[i + 1];
+         double ax = east[0] * (a.x - pt.x) + east[1] * (a.y - pt.y)
+                   + east[2] * (a.z - pt.z);
+         double ay = north[0] * (a.x - pt.x) + north[1] * (a.y - pt.y)
+                   + north[2] * (a.z - pt.z);
+         double bx = east[0] * (b.x - pt.x) + east[1] * (b.y - pt.y)
+                   + east[2] * (b.z - pt.z);
+         double by = north[0] * (b.x - pt.x) + north[1] * (b.y - pt.y)
+                   + north[2] * (b.z - pt.z);
+         if ((ay > 0.0) != (by > 0.0) &&
+             ax + (bx - ax) * (0.0 - ay) / (by - ay) > 0.0) {
+            in = !in;
+         }
+      }
+      return in;
+   };
+
+   UsgsAstroFootprint footprint = model.computeFootprint(-1000.0, 2000.0, 1.0);
+   const std::vector<csm::EcefCoord>& polygon = footprint.getPolygon();
+   ASSERT_GT(polygon.size(), 16u);
+   EXPECT_EQ(polygon.front().x, polygon.back().x);
+   EXPECT_EQ(polygon.front().y, polygon.back().y);
+   EXPECT_EQ(polygon.front().z, polygon.back().z);
+   for (double line = 50.5; line < 5000.0; line += 700.0) {
+      for (double samp = 50.5; samp < 5000.0; samp += 700.0) {
+         for (double height = -1000.0; height <= 2000.0; height += 1500.0) {
+            csm::EcefCoord groundPt =
+               model.imageToGround(csm::ImageCoord(line, samp), height);
+            EXPECT_TRUE(inside(polygon, groundPt))
+               << "line " << line << ", sample " << samp
+               << ", height " << height;
+         }
+      }
+   }
+
+   // A short lens sees past the limb on both sides, where the corner rays
+   // miss the planet
+   state.m_Focal = 5.0;
+   state.m_IkCode = 0;
+   model.set(state);
+   csm::EcefCoord groundPt;
+   ASSERT_EQ(UsgsAstroLsSensorModel::PROJECTION_MISSED,
+             model.tryImageToGround(csm::ImageCoord(0.0, 0.0), 0.0, groundPt));
+   ASSERT_EQ(UsgsAstroLsSensorModel::PROJECTION_MISSED,
+             model.tryImageToGround(csm::ImageCoord(0.0, 5000.0), 0.0,
+                                    groundPt));
+
+   footprint = model.computeFootprint(0.0, 0.0, 10.0);
+   const std::vector<csm::EcefCoord>& limbPolygon = footprint.getPolygon();
+   ASSERT_GT(limbPolygon.size(), 4u);
+   EXPECT_EQ(limbPolygon.front().x, limbPolygon.back().x);
+   EXPECT_EQ(limbPolygon.front().y, limbPolygon.back().y);
+   EXPECT_EQ(limbPolygon.front().z, limbPolygon.back().z);
+
+   // Every vertex is on the surface, none at the nearest point of a miss
+   double a = state.m_SemiMajorAxis;
+   double b = state.m_SemiMinorAxis;
+   for (size_t i = 0; i < limbPolygon.size(); i++) {
+      const csm::EcefCoord& v = limbPolygon[i];
+      EXPECT_NEAR(1.0, (v.x * v.x + v.y * v.y) / (a * a) + v.z * v.z / (b * b),
+                  1.0e-9) << "vertex " << i;
+   }
+
+   // The polygon ends where the border rays leave the planet, so it holds
+   // the points inside the image a little away from the limb
+   int hits = 0;
+   for (double line = 50.5; line < 5000.0; line += 700.0) {
+      for (double samp = 50.5; samp < 5000.0; samp += 350.0) {
+         if (model.tryImageToGround(csm::ImageCoord(line, samp), 0.0, groundPt)
+                != UsgsAstroLsSensorModel::PROJECTION_SUCCESS ||
+             model.tryImageToGround(csm::ImageCoord(line, samp - 100.0), 0.0,
+                                    groundPt)
+                != UsgsAstroLsSensorModel::PROJECTION_SUCCESS ||
+             model.tryImageToGround(csm::ImageCoord(line, samp + 100.0), 0.0,
+                                    groundPt)
+                != UsgsAstroLsSensorModel::PROJECTION_SUCCESS) {
+            continue;
+         }
+         hits++;
+         model.tryImageToGround(csm::ImageCoord(line, samp), 0.0, groundPt);
+         EXPECT_TRUE(inside(limbPolygon, groundPt))
+            << "line " << line << ", sample " << samp;
+      }
+   }
+   EXPECT_GT(hits, 0);
+}
+
+
+TEST_F(LsSyntheticTest, TriangulateBatchMatchesSingle) {
+   UsgsAstroLsSensorModel moved;
+   moved.set(state);
+   moved.setParameterValue(1, 20000.0);
+   UsgsAstroLsSensorModel raised;
+   raised.set(state);
+   raised.setParameterValue(2, 5000.0);
+
+   // Enough matches for several threads, of two and three observations,
+   // with a match of one observation and one without a model, which are
+   // not valid
+   std::vector<int> matchStart(1, 0);
+   std::vector<UsgsAstroTriangulation::Observation> observations;
+   for (int i = 0; i < 700; i++) {
+      csm::ImageCoord imagePt(100.5 + 6.7 * i, 4800.5 - 6.1 * i);
+      csm::EcefCoord groundPt =
+         model.imageToGround(imagePt, 100.0 * (i % 7));
+      UsgsAstroTriangulation::Observation obs = { &model, imagePt, 0.5 };
+      observations.push_back(obs);
+      if (i != 100) {
+         obs.model = i == 200 ? NULL : &moved;
+         obs.imagePt = moved.groundToImage(groundPt);
+         obs.imagePt.line += 0.01 * (i % 5);
+         observations.push_back(obs);
+      }
+      if (i % 3 == 0) {
+         obs.model = &raised;
+         obs.imagePt = raised.groundToImage(groundPt);
+         obs.sigma = 1.0;
+         observations.push_back(obs);
+      }
+      matchStart.push_back(observations.size());
+   }
+   int numMatches = matchStart.size() - 1;
+   int numObservations = observations.size();
+
+   // Single matches, one at a time
+   std::vector<csm::EcefCoord> expectedPts(numMatches);
+   std::vector<double> expectedCov(9 * numMatches, 0.0);
+   std::vector<double> expectedRes(numObservations, 0.0);
+   std::vector<bool> expectedValid(numMatches);
+   int expectedNumValid = 0;
+   for (int i = 0; i < numMatches; i++) {
+      int start = matchStart[i];
+      expectedValid[i] = UsgsAstroTriangulation::triangulate(
+         matchStart[i + 1] - start, &observations[start], expectedPts[i],
+         &expectedCov[9 * i], &expectedRes[start]);
+      expectedNumValid += expectedValid[i];
+   }
+   EXPECT_EQ(numMatches - 2, expectedNumValid);
+
+   const int threadCounts[] = { 1, 3, 0 };
+   for (int numThreads : threadCounts) {
+      std::vector<csm::EcefCoord> pts(numMatches);
+      std::vector<double> cov(9 * numMatches, 0.0);
+      std::vector<double> res(numObservations, 0.0);
+      std::unique_ptr<bool[]> valid(new bool[numMatches]);
+      int numValid = UsgsAstroTriangulation::triangulate(
+         numMatches, &matchStart[0], &observations[0], &pts[0], &cov[0],
+         &res[0], valid.get(), numThreads);
+      EXPECT_EQ(expectedNumValid, numValid) << numThreads << " threads";
+      for (int i = 0; i < numMatches; i++) {
+         ASSERT_EQ(expectedValid[i], valid[i])
+            << numThreads << " threads, match " << i;
+         if (!valid[i]) {
+            continue;
+         }
+         EXPECT_EQ(expectedPts[i].x, pts[i].x);
+         EXPECT_EQ(expectedPts[i].y, pts[i].y);
+         EXPECT_EQ(expectedPts[i].z, pts[i].z);
+         for (int k = 0; k < 9; k++) {
+            EXPECT_EQ(expectedCov[9 * i + k], cov[9 * i + k]);
+         }
+         for (int k = matchStart[i]; k < matchStart[i + 1]; k++) {
+            EXPECT_EQ(expectedRes[k], res[k]);
+         }
+      }
+   }
+}
+
+
+TEST_F(LsSyntheticTest, EpipolarCurveFollowsProjections) {
+   // The same pass pitched about 0.02 radians, so that the curve runs
+   // along the lines by about 3 lines per km, and through the first line
+   // for the point near it
+   UsgsAstroLsSensorModel pitched;
+   pitched.set(state);
+   pitched.setParameterValue(7, 6000.0);
+
+   const double tolerance = 0.05;
+   const double lines[] = { 5.5, 2500.5 };
+   int invalid = 0;
+   for (int i = 0; i < 2; i++) {
+      csm::ImageCoord imagePt(lines[i], 2500.5);
+      csm::ImageCoord otherPt =
+         pitched.groundToImage(model.imageToGround(imagePt, 0.0));
+      UsgsAstroEpipolarCurve curve = model.computeEpipolarCurve(
+         pitched, otherPt, -2000.0, 10000.0, tolerance);
+      EXPECT_LE(curve.getErrorBound(), tolerance);
+
+      // The vertices, projected from the time of the one before, are the
+      // projections searched for over the whole image
+      const std::vector<UsgsAstroEpipolarCurve::Vertex> &vertices =
+         curve.getVertices();
+      ASSERT_GE(vertices.size(), 2u);
+      for (size_t j = 0; j < vertices.size(); j++) {
+         csm::EcefCoord groundPt =
+            pitched.imageToGround(otherPt, vertices[j].height);
+         csm::ImageCoord expected;
+         bool viewed = model.tryGroundToImage(groundPt, expected, 1.0e-6)
+                     == UsgsAstroLsSensorModel::PROJECTION_SUCCESS;
+         ASSERT_EQ(viewed, vertices[j].valid)
+            << "height " << vertices[j].height;
+         if (viewed) {
+            EXPECT_NEAR(expected.line, vertices[j].imagePt.line, 1.0e-3);
+            EXPECT_NEAR(expected.samp, vertices[j].imagePt.samp, 1.0e-3);
+         }
+         else {
+            invalid++;
+         }
+      }
+
+      // Wherever the curve is interpolated it is within the tolerance
+      for (double height = -2000.0; height <= 10000.0; height += 25.0) {
+         csm::ImageCoord interpolated;
+         if (curve.interpolate(height, interpolated)) {
+            csm::ImageCoord expected =
+               model.groundToImage(pitched.imageToGround(otherPt, height));
+            EXPECT_NEAR(expected.line, interpolated.line, tolerance);
+            EXPECT_NEAR(expected.samp, interpolated.samp, tolerance);
+         }
+      }
+   }
+   EXPECT_GT(invalid, 0);
+
+   // A tolerance below the noise of the projections stops the bisection
+   // at its depth limit, with the deviation left there in the bound
+   csm::ImageCoord otherPt = pitched.groundToImage(
+      model.imageToGround(csm::ImageCoord(2500.5, 2500.5), 0.0));
+   UsgsAstroEpipolarCurve curve = model.computeEpipolarCurve(
+      pitched, otherPt, -2000.0, 10000.0, 1.0e-12);
+   EXPECT_GT(curve.getErrorBound(), 1.0e-12);
+}
+
+
+TEST_F(LsSyntheticTest, GroundCovarianceWithSensorCovariance) {
+   // Sensor covariance of every parameter, with a correlation of position
+   // and attitude, over a height range the grid of partials spans
+   state.m_FlyingHeight = 300000.0;
+   state.m_HalfSwath = 20000.0;
+   state.m_HalfTime = 10.0;
+   state.m_MinElevation = -1000.0;
+   state.m_MaxElevation = 3000.0;
+   state.m_Covariance.assign(16 * 16, 0.0);
+   UsgsAstroLsSensorModel plain;
+   plain.set(state);
+   const double variances[16] = { 400.0, 400.0, 400.0, 1.0, 1.0, 1.0,
+                                  400.0, 400.0, 400.0, 100.0, 100.0, 100.0,
+                                  1.0, 1.0, 1.0, 1.0e-4 };
+   for (int p = 0; p < 16; p++) {
+      state.m_Covariance[17 * p] = variances[p];
+   }
+   state.m_Covariance[16 * 0 + 7] = 200.0;
+   state.m_Covariance[16 * 7 + 0] = 200.0;
+   model.set(state);
+
+   // Within the image and the height range the partials are interpolated,
+   // and beyond them computed exactly, so the tolerances differ
+   struct Query { double line, samp, height, tolerance; };
+   const Query queries[] = {
+      { 300.5, 200.5, 400.0, 1.0e-2 },
+      { 2500.5, 4700.5, 2500.0, 1.0e-2 },
+      { 2500.5, 2500.5, 6000.0, 1.0e-6 },
+      { 2500.5, 2500.5, -3000.0, 1.0e-6 },
+      { 0.2, 2500.5, 400.0, 1.0e-6 },
+      { 2500.5, 5400.5, 400.0, 1.0e-6 } };
+   for (size_t n = 0; n < sizeof(queries) / sizeof(queries[0]); n++) {
+      const Query &query = queries[n];
+      csm::ImageCoordCovar imagePt;
+      imagePt.line = query.line;
+      imagePt.samp = query.samp;
+      imagePt.covariance[0] = 0.5;
+      imagePt.covariance[1] = 0.1;
+      imagePt.covariance[2] = 0.1;
+      imagePt.covariance[3] = 0.3;
+      csm::EcefCoordCovar result =
+         model.imageToGround(imagePt, query.height, 100.0);
+
+      // The sensor covariance in image space from the exact partials,
+      // added to the image covariance of the model without one
+      std::vector<csm::RasterGM::SensorPartials> partials =
+         model.computeAllSensorPartials(result);
+      double sensorCov[4] = { 0.0, 0.0, 0.0, 0.0 };
+      for (int p = 0; p < 16; p++) {
+         for (int q = 0; q < 16; q++) {
+            double c = model.getParameterCovariance(p, q);
+            sensorCov[0] += partials[p].first * c * partials[q].first;
+            sensorCov[1] += partials[p].second * c * partials[q].first;
+            sensorCov[2] += partials[p].first * c * partials[q].second;
+            sensorCov[3] += partials[p].second * c * partials[q].second;
+         }
+      }
+      EXPECT_GT(sensorCov[0], 10.0 * imagePt.covariance[0]);
+      csm::ImageCoordCovar combined = imagePt;
+      for (int k = 0; k < 4; k++) {
+         combined.covariance[k] += sensorCov[k];
+      }
+      csm::EcefCoordCovar expected =
+         plain.imageToGround(combined, query.height, 100.0);
+
+      double largest = 0.0;
+      for (int k = 0; k < 9; k++) {
+         largest = std::max(largest, fabs(expected.covariance[k]));
+      }
+      for (int k = 0; k < 9; k++) {
+         EXPECT_NEAR(expected.covariance[k], result.covariance[k],
+                     query.tolerance * largest)
+            << "query " << n << ", entry " << k;
+      }
+   }
+}
+
+
 int main(int argc, char **argv) {
    ::testing::InitGoogleTest(&argc, argv);
    return RUN_ALL_TESTS();